@@ -0,0 +1,50 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "sav1.h"
+
+// cut a clip out of a .webm file without decoding it, for example
+//   sav1clip input.webm highlight.webm 61.5 75
+// copies from the last keyframe at or before 61.5 seconds up to 75 seconds
+
+int
+parse_seconds(const char *text, uint64_t *milliseconds)
+{
+    char *end;
+    double seconds = strtod(text, &end);
+    if (end == text || *end != '\0' || seconds < 0) {
+        return -1;
+    }
+    *milliseconds = (uint64_t)(seconds * 1000 + 0.5);
+    return 0;
+}
+
+int
+main(int argc, char *argv[])
+{
+    if (argc < 5) {
+        fprintf(stderr,
+                "Usage: %s <input.webm> <output.webm> <start seconds> <end seconds> "
+                "[index cache]\n",
+                argv[0]);
+        return 1;
+    }
+
+    uint64_t start_time, end_time;
+    if (parse_seconds(argv[3], &start_time) || parse_seconds(argv[4], &end_time) ||
+        start_time >= end_time) {
+        fprintf(stderr, "Error: Invalid time range\n");
+        return 1;
+    }
+
+    uint64_t clip_start_time;
+    if (sav1_extract_clip(argv[1], argv[2], start_time, end_time,
+                          argc > 5 ? argv[5] : NULL, &clip_start_time)) {
+        fprintf(stderr, "Error: Couldn't extract a clip from %s\n", argv[1]);
+        return 1;
+    }
+
+    printf("Wrote %s from %.3f to %.3f seconds\n", argv[2], clip_start_time / 1000.0,
+           end_time / 1000.0);
+    return 0;
+}
@@ -129,6 +129,9 @@ main(int argc, char *argv[])
     // Populate settings struct with default values
     sav1_default_settings(&settings, argv[1]);
 
+    // Drop to a smaller video track if the file has one and decoding falls behind
+    settings.video_track_mode = SAV1_VIDEO_TRACK_AUTO;
+
     // Setup SAV1 context
     if (sav1_create_context(&context, &settings) < 0) {
         EXIT_W_SAV1_ERROR
@@ -271,6 +274,7 @@ main(int argc, char *argv[])
                      * F = toggle fullscreen
                      * LEFT ARROW = seek back 10 seconds
                      * RIGHT ARROW = seek forward 10 seconds
+                     * A = switch to the next audio track
                      */
 
                     if (event.key.keysym.sym == SDLK_ESCAPE) {
@@ -328,6 +332,32 @@ main(int argc, char *argv[])
                             PRINT_SAV1_ERROR
                         }
                     }
+                    else if (event.key.keysym.sym == SDLK_a) {
+                        // Cycle through the audio tracks
+                        size_t num_tracks, track;
+                        if (sav1_get_audio_track_count(&context, &num_tracks) < 0 ||
+                            sav1_get_selected_audio_track(&context, &track) < 0) {
+                            EXIT_W_SAV1_ERROR
+                        }
+                        if (num_tracks > 1 &&
+                            sav1_select_audio_track(&context, (track + 1) % num_tracks) <
+                                0) {
+                            PRINT_SAV1_ERROR
+                        }
+                    }
+                    else if (event.key.keysym.sym == SDLK_v) {
+                        // Cycle through the video tracks
+                        size_t num_tracks, track;
+                        if (sav1_get_video_track_count(&context, &num_tracks) < 0 ||
+                            sav1_get_selected_video_track(&context, &track) < 0) {
+                            EXIT_W_SAV1_ERROR
+                        }
+                        if (num_tracks > 1 &&
+                            sav1_select_video_track(&context, (track + 1) % num_tracks) <
+                                0) {
+                            PRINT_SAV1_ERROR
+                        }
+                    }
                     break;
 
                 case SDL_WINDOWEVENT:
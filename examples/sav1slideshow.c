@@ -42,6 +42,30 @@ move_towards_targeted_slide(int targeted_slide, int *curr_slide, Sav1Context *co
     // printf("targeted_err=%s\n", sav1_get_error(context));
 }
 
+void
+move_to_targeted_chapter(int targeted_slide, int *curr_slide, int *needs_frame,
+                         Sav1Context *context, Sav1VideoFrame **sav1_frame)
+{
+    *sav1_frame = NULL;
+
+    // each chapter is a slide, so jump straight to its first frame
+    if (targeted_slide != *curr_slide) {
+        sav1_seek_to_chapter(context, (size_t)targeted_slide);
+        *curr_slide = targeted_slide;
+        *needs_frame = 1;
+    }
+
+    int is_ready;
+
+    if (*needs_frame) {
+        sav1_get_video_frame_ready(context, &is_ready);
+        if (is_ready) {
+            sav1_get_video_frame(context, sav1_frame);
+            *needs_frame = 0;
+        }
+    }
+}
+
 int
 main(int argc, char *argv[])
 {
@@ -57,12 +81,15 @@ main(int argc, char *argv[])
 
     int targeted_slide = 0;
     int current_slide = -1;
+    int needs_frame = 0;
+    size_t num_chapters = 0;
 
     Sav1Settings settings;
     sav1_default_settings(&settings, argv[1]);
     settings.desired_pixel_format = SAV1_PIXEL_FORMAT_BGRA;
     settings.codec_target = SAV1_CODEC_AV1;
     settings.playback_mode = SAV1_PLAYBACK_FAST;
+    settings.chapter_frame_cache_size = 16;
 
     Sav1Context context = {0};
     sav1_create_context(&context, &settings);
@@ -91,8 +118,16 @@ main(int argc, char *argv[])
         // video frame
         // printf("current=%i, targeted=%i, error=%s\n", current_slide, targeted_slide,
         // sav1_get_error(&context));
-        move_towards_targeted_slide(targeted_slide, &current_slide, &context,
-                                    &sav1_frame);
+        // chapters become available once the file's headers have been read
+        sav1_get_chapter_count(&context, &num_chapters);
+        if (num_chapters > 0) {
+            move_to_targeted_chapter(targeted_slide, &current_slide, &needs_frame,
+                                     &context, &sav1_frame);
+        }
+        else {
+            move_towards_targeted_slide(targeted_slide, &current_slide, &context,
+                                        &sav1_frame);
+        }
         // printf("sav1_frame=%p\n", sav1_frame);
         // printf("current=%i\n", current_slide);
         if (sav1_frame && current_slide == targeted_slide) {
@@ -152,6 +187,9 @@ main(int argc, char *argv[])
                     }
                     else if (event.key.keysym.sym == SDLK_RIGHT) {
                         targeted_slide++;
+                        if (num_chapters > 0 && targeted_slide >= (int)num_chapters) {
+                            targeted_slide = (int)num_chapters - 1;
+                        }
                     }
                     break;
 
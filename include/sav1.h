@@ -72,6 +72,10 @@ typedef struct Sav1Context {
 #include "sav1_settings.h"
 #include "sav1_video_frame.h"
 #include "sav1_audio_frame.h"
+#include "sav1_probe.h"
+#include "sav1_clip.h"
+#include "sav1_shared_source.h"
+#include "sav1_decode_budget.h"
 
 typedef enum {
     /** Recommended mode to seek video to approximately the specified timecode utilizing
@@ -286,6 +290,22 @@ sav1_stop_playback(Sav1Context *context);
 SAV1_API int
 sav1_is_playback_paused(Sav1Context *context, int *is_paused);
 
+/**
+ * @brief Sets whether the video is currently visible
+ *
+ * Lets a @ref Sav1DecodeBudget give more of its threads to the videos that can be seen.
+ * Contexts count as visible until this is called, and it has no effect on contexts
+ * without a budget or on contexts attached to a shared source.
+ *
+ * @param[in] context pointer to a created SAV1 context
+ * @param[in] is_visible 1 when the video can be seen, 0 when it's hidden
+ * @return 0 on success, or < 0 on error
+ *
+ * @sa Sav1Settings.decode_budget
+ */
+SAV1_API int
+sav1_set_visibility(Sav1Context *context, int is_visible);
+
 /**
  * @brief Gets whether the video has reached the end of the file
  *
@@ -375,6 +395,36 @@ sav1_set_playback_speed(Sav1Context *context, double playback_speed);
 SAV1_API int
 sav1_get_playback_speed(Sav1Context *context, double *playback_speed);
 
+/**
+ * @brief Changes the AV1 decoder's quality and speed trade-offs
+ *
+ * The new profile applies from the next keyframe on, since the decoder has to be
+ * restarted to change it. Frames that were already decoded are still returned. This
+ * can't be called on a context attached to a shared source.
+ *
+ * @param[in] context pointer to a created SAV1 context
+ * @param[in] profile pointer to the profile to decode with, which is copied
+ * @return 0 on success, or < 0 on error
+ *
+ * @sa Sav1Settings.decode_profile
+ * @sa sav1_get_decode_profile
+ */
+SAV1_API int
+sav1_set_decode_profile(Sav1Context *context, const Sav1DecodeProfile *profile);
+
+/**
+ * @brief Gets the current value of the @ref Sav1Settings.decode_profile setting
+ *
+ * @param[in] context pointer to a created SAV1 context
+ * @param[out] profile the profile that was last set, even if it hasn't applied yet
+ * @return 0 on success, or < 0 on error
+ *
+ * @sa Sav1Settings.decode_profile
+ * @sa sav1_set_decode_profile
+ */
+SAV1_API int
+sav1_get_decode_profile(Sav1Context *context, Sav1DecodeProfile *profile);
+
 /**
  * @brief Seeks playback to a different time in the file
  *
@@ -411,6 +461,226 @@ sav1_get_playback_speed(Sav1Context *context, double *playback_speed);
 SAV1_API int
 sav1_seek_playback(Sav1Context *context, uint64_t timecode_ms, int seek_mode);
 
+/**
+ * @brief Struct to describe one chapter of the file.
+ *
+ * @sa sav1_get_chapter
+ */
+typedef struct Sav1Chapter {
+    uint64_t start_time; /**< The timecode in milliseconds at which the chapter begins. */
+    uint64_t end_time;   /**< The timecode in milliseconds at which the chapter ends, or 0
+                            if it isn't known. */
+    const char *title;   /**< The chapter's title, which is an empty string if it doesn't
+                            have one. Valid until the context is destroyed. */
+} Sav1Chapter;
+
+/**
+ * @brief Gets the number of chapters in the file
+ *
+ * Chapters are read from the first edition in the file along with its headers, shortly
+ * after @ref sav1_create_context is called, so the count is 0 until then as well as for
+ * files without chapters.
+ *
+ * @param[in] context pointer to a created SAV1 context
+ * @param[out] count the number of chapters
+ * @return 0 on success, or < 0 on error
+ *
+ * @sa sav1_get_chapter
+ * @sa sav1_seek_to_chapter
+ */
+SAV1_API int
+sav1_get_chapter_count(Sav1Context *context, size_t *count);
+
+/**
+ * @brief Gets the start, end, and title of a chapter
+ *
+ * Chapters are numbered from 0 in the order they start.
+ *
+ * @param[in] context pointer to a created SAV1 context
+ * @param[in] index the number of the chapter
+ * @param[out] chapter pointer to a `Sav1Chapter` struct to fill in
+ * @return 0 on success, or < 0 on error
+ *
+ * @sa sav1_get_chapter_count
+ */
+SAV1_API int
+sav1_get_chapter(Sav1Context *context, size_t index, Sav1Chapter *chapter);
+
+/**
+ * @brief Seeks playback to the start of a chapter
+ *
+ * Seeks precisely to the chapter's start time like @ref sav1_seek_playback. When
+ * @ref Sav1Settings.chapter_frame_cache_size is set, SAV1 keeps a copy of the first
+ * video frame shown in each chapter it plays. If the chapter's frame is cached, it's
+ * returned by @ref sav1_get_video_frame right away while the new position is being
+ * decoded. Cached frames don't carry @ref Sav1VideoFrame.custom_data.
+ *
+ * @param[in] context pointer to a created SAV1 context
+ * @param[in] index the number of the chapter
+ * @return 0 on success, or < 0 on error
+ *
+ * @sa sav1_get_chapter_count
+ * @sa sav1_seek_playback
+ */
+SAV1_API int
+sav1_seek_to_chapter(Sav1Context *context, size_t index);
+
+/**
+ * @brief Struct to describe one of the file's Opus audio tracks.
+ *
+ * @sa sav1_get_audio_track
+ */
+typedef struct Sav1AudioTrack {
+    const char *language; /**< The track's language code, which is "eng" if the file
+                             doesn't say. Valid until the context is destroyed. */
+    const char *name;     /**< The track's name, which is an empty string if it doesn't
+                             have one. Valid until the context is destroyed. */
+} Sav1AudioTrack;
+
+/**
+ * @brief Gets the number of Opus audio tracks in the file
+ *
+ * Tracks are read along with the file's headers, shortly after @ref sav1_create_context
+ * is called, so the count is 0 until then.
+ *
+ * @param[in] context pointer to a created SAV1 context
+ * @param[out] count the number of audio tracks
+ * @return 0 on success, or < 0 on error
+ *
+ * @sa sav1_get_audio_track
+ * @sa sav1_select_audio_track
+ */
+SAV1_API int
+sav1_get_audio_track_count(Sav1Context *context, size_t *count);
+
+/**
+ * @brief Gets the language and name of an audio track
+ *
+ * Tracks are numbered from 0 in the order they're listed in the file.
+ *
+ * @param[in] context pointer to a created SAV1 context
+ * @param[in] index the number of the audio track
+ * @param[out] track pointer to a `Sav1AudioTrack` struct to fill in
+ * @return 0 on success, or < 0 on error
+ *
+ * @sa sav1_get_audio_track_count
+ */
+SAV1_API int
+sav1_get_audio_track(Sav1Context *context, size_t index, Sav1AudioTrack *track);
+
+/**
+ * @brief Gets the audio track that is playing
+ *
+ * The first track plays unless another is selected.
+ *
+ * @param[in] context pointer to a created SAV1 context
+ * @param[out] index the number of the audio track
+ * @return 0 on success, or < 0 on error
+ *
+ * @sa sav1_select_audio_track
+ */
+SAV1_API int
+sav1_get_selected_audio_track(Sav1Context *context, size_t *index);
+
+/**
+ * @brief Switches playback to another audio track
+ *
+ * Every audio track is read from the file as it plays, so the new track picks up from
+ * the current playback time without seeking or interrupting the video. Audio frames
+ * already decoded from the old track are dropped. The exception is the last few
+ * seconds of a file that isn't looping: once the whole file has been read, this seeks
+ * to the current playback time to read the new track again.
+ *
+ * @param[in] context pointer to a created SAV1 context
+ * @param[in] index the number of the audio track
+ * @return 0 on success, or < 0 on error
+ *
+ * @sa sav1_get_audio_track_count
+ * @sa sav1_get_selected_audio_track
+ */
+SAV1_API int
+sav1_select_audio_track(Sav1Context *context, size_t index);
+
+/**
+ * @brief Struct to describe one of the file's AV1 video tracks.
+ *
+ * @sa sav1_get_video_track
+ */
+typedef struct Sav1VideoTrack {
+    size_t width;     /**< The width in pixels of the track's video. */
+    size_t height;    /**< The height in pixels of the track's video. */
+    const char *name; /**< The track's name, which is an empty string if it doesn't
+                         have one. Valid until the context is destroyed. */
+} Sav1VideoTrack;
+
+/**
+ * @brief Gets the number of AV1 video tracks in the file
+ *
+ * Files usually have one, but a file can hold the same video at several resolutions.
+ * Tracks are read along with the file's headers, shortly after @ref sav1_create_context
+ * is called, so the count is 0 until then.
+ *
+ * @param[in] context pointer to a created SAV1 context
+ * @param[out] count the number of video tracks
+ * @return 0 on success, or < 0 on error
+ *
+ * @sa sav1_get_video_track
+ * @sa sav1_select_video_track
+ */
+SAV1_API int
+sav1_get_video_track_count(Sav1Context *context, size_t *count);
+
+/**
+ * @brief Gets the size and name of a video track
+ *
+ * Tracks are numbered from 0 in the order they're listed in the file.
+ *
+ * @param[in] context pointer to a created SAV1 context
+ * @param[in] index the number of the video track
+ * @param[out] track pointer to a `Sav1VideoTrack` struct to fill in
+ * @return 0 on success, or < 0 on error
+ *
+ * @sa sav1_get_video_track_count
+ */
+SAV1_API int
+sav1_get_video_track(Sav1Context *context, size_t index, Sav1VideoTrack *track);
+
+/**
+ * @brief Gets the video track that is selected
+ *
+ * The first track plays unless another is selected, or unless
+ * @ref Sav1Settings.video_track_mode is `SAV1_VIDEO_TRACK_AUTO`, which starts with the
+ * largest track and steps down to smaller ones while decoding falls behind.
+ *
+ * @param[in] context pointer to a created SAV1 context
+ * @param[out] index the number of the video track
+ * @return 0 on success, or < 0 on error
+ *
+ * @sa sav1_select_video_track
+ */
+SAV1_API int
+sav1_get_selected_video_track(Sav1Context *context, size_t *index);
+
+/**
+ * @brief Switches playback to another video track
+ *
+ * The new track takes over at its first keyframe after the frames that have already
+ * been read ahead, without seeking, so the old track keeps playing until then. Frames
+ * from the two tracks can have different sizes, so check the width and height of every
+ * frame. Once the whole file has been read, this seeks to the frame that's showing
+ * instead. In `SAV1_VIDEO_TRACK_AUTO` mode a later automatic switch can still replace
+ * this choice.
+ *
+ * @param[in] context pointer to a created SAV1 context
+ * @param[in] index the number of the video track
+ * @return 0 on success, or < 0 on error
+ *
+ * @sa sav1_get_video_track_count
+ * @sa sav1_get_selected_video_track
+ */
+SAV1_API int
+sav1_select_video_track(Sav1Context *context, size_t index);
+
 // 0.9.1
 /**
  * @brief Macro (compile time) for SAV1 major version
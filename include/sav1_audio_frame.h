@@ -32,7 +32,9 @@ only supports Opus audio. */
                           Sav1Settings.custom_audio_frame_processing. */
 
     int sentinel;           /**< (internal use) */
+    int track_switches;     /**< (internal use) */
     int sav1_has_ownership; /**< (internal use) */
+    void *shared_frame;     /**< (internal use) */
 } Sav1AudioFrame;
 
 /**
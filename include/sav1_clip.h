@@ -0,0 +1,38 @@
+#ifndef SAV1_CLIP_H
+#define SAV1_CLIP_H
+
+#include <stdint.h>
+
+#include "common.h"
+
+/**
+ * @brief Copy part of a .webm file into a new .webm file without decoding it.
+ *
+ * The clip starts at the last video keyframe at or before `start_time`, so that it can
+ * be decoded on its own, and ends just before `end_time`. The compressed AV1 and Opus
+ * blocks of the first AV1 track and the first Opus track are copied as they are, and
+ * every other track is left out. Timestamps in the clip start from 0, and the clip gets
+ * its own Cues so that it can be seeked.
+ *
+ * The starting keyframe is found through the seek index cached at `index_cache_path` if
+ * there is one, otherwise through the file's Cues, so only the clusters around the clip
+ * are read.
+ *
+ * @param[in] input_path path to the .webm file to copy from
+ * @param[in] output_path path of the .webm file to write, which is overwritten if it
+ * already exists
+ * @param[in] start_time the time in milliseconds that the clip should start at
+ * @param[in] end_time the time in milliseconds that the clip should end at
+ * @param[in] index_cache_path the @ref Sav1Settings.index_cache_path used when playing
+ * the file, or `NULL`
+ * @param[out] clip_start_time set to the time in milliseconds in the input file that
+ * the clip actually starts at, which is the time of its first keyframe. May be `NULL`
+ * @return 0 on success, or < 0 if the input couldn't be read, the output couldn't be
+ * written, or there's nothing to copy between the two times
+ */
+SAV1_API int
+sav1_extract_clip(const char *input_path, const char *output_path, uint64_t start_time,
+                  uint64_t end_time, const char *index_cache_path,
+                  uint64_t *clip_start_time);
+
+#endif
@@ -0,0 +1,65 @@
+#ifndef SAV1_DECODE_BUDGET_H
+#define SAV1_DECODE_BUDGET_H
+
+#include <stdint.h>
+
+#include "common.h"
+
+/**
+ * @brief Struct to represent a number of AV1 decoder threads shared by several contexts.
+ *
+ * Every @ref Sav1Context normally starts an AV1 decoder with threads of its own, so
+ * playing many videos at once can start far more threads than there are cores. Contexts
+ * created with @ref Sav1Settings.decode_budget set instead divide the threads of one
+ * budget between them, weighted by the resolution of each video. Contexts that are
+ * paused or hidden with @ref sav1_set_visibility get a smaller share.
+ *
+ * The threads are divided again whenever a context is created, destroyed, paused,
+ * resumed, shown, or hidden. Each context's decoder only changes its number of threads
+ * at the next keyframe, so it can take a few seconds for a new share to apply.
+ *
+ * @sa sav1_create_decode_budget
+ * @sa sav1_settings_use_decode_budget
+ */
+typedef struct Sav1DecodeBudget {
+    /** (internal use) Pointer to SAV1's internal state, hidden from the user. */
+    void *internal_state;
+
+    /** (internal use) */
+    uint8_t is_initialized;
+} Sav1DecodeBudget;
+
+/**
+ * @brief Create a budget of AV1 decoder threads for contexts to share.
+ *
+ * Every context attached to the budget gets at least one thread, so the budget is
+ * exceeded when more contexts are attached than it has threads. The threads of SAV1's
+ * own pipeline, such as parsing and color conversion, are not part of the budget.
+ *
+ * @param[in] budget pointer to an empty decode budget struct
+ * @param[in] num_threads the number of decoder threads to divide between the contexts,
+ * or `0` for one per core
+ * @return 0 on success, or < 0 on error
+ *
+ * @sa sav1_destroy_decode_budget
+ * @sa sav1_settings_use_decode_budget
+ */
+SAV1_API int
+sav1_create_decode_budget(Sav1DecodeBudget *budget, int num_threads);
+
+/**
+ * @brief Let go of a decode budget.
+ *
+ * The contexts attached to the budget keep sharing it until they have all been
+ * destroyed too, so this can be called as soon as the last context has been created. No
+ * more contexts can be attached to the budget afterwards.
+ *
+ * @param[in] budget pointer to a decode budget struct
+ * @return 0 on success, or < 0 on error
+ *
+ * @sa sav1_create_decode_budget
+ */
+SAV1_API int
+sav1_destroy_decode_budget(Sav1DecodeBudget *budget);
+
+#endif
@@ -0,0 +1,88 @@
+#ifndef SAV1_PROBE_H
+#define SAV1_PROBE_H
+
+#include <stdint.h>
+
+#include "common.h"
+#include "sav1_settings.h"
+
+typedef enum {
+    SAV1_CHROMA_LAYOUT_UNKNOWN,    /**< The file doesn't say how chroma is stored. */
+    SAV1_CHROMA_LAYOUT_MONOCHROME, /**< Only luma, with no chroma planes. */
+    SAV1_CHROMA_LAYOUT_420,        /**< Chroma at half the width and half the height. */
+    SAV1_CHROMA_LAYOUT_422,        /**< Chroma at half the width and full height. */
+    SAV1_CHROMA_LAYOUT_444         /**< Chroma at full resolution. */
+} Sav1ChromaLayout;
+
+/**
+ * @brief Struct to describe a .webm file without playing it.
+ *
+ * Filled in by @ref sav1_probe_file, @ref sav1_probe_buffer, and @ref sav1_probe_io.
+ * Anything that the file doesn't list is left as 0.
+ */
+typedef struct Sav1ProbeInfo {
+    uint64_t duration; /**< The duration of the file in milliseconds, or 0 if it isn't
+                          listed. */
+    int has_video;     /**< Whether the file has an AV1 video track. */
+    int has_audio;     /**< Whether the file has an Opus audio track. */
+    size_t width;      /**< The width in pixels of the video. */
+    size_t height;     /**< The height in pixels of the video. */
+    Sav1ChromaLayout chroma_layout; /**< How the video's chroma planes are stored. */
+    uint8_t bit_depth; /**< The number of bits per color in the video as stored, which
+                          is 8, 10, or 12. */
+    double frame_rate; /**< The frame rate of the video in frames per second, estimated
+                          from the first frames if the file doesn't list it. */
+    size_t audio_channels;     /**< The number of audio channels. */
+    double audio_sample_rate;  /**< The sampling frequency the audio was encoded at. */
+    size_t num_key_frames; /**< The number of video keyframes listed in the Cues, or 0 if
+                              the file has no Cues. */
+} Sav1ProbeInfo;
+
+/**
+ * @brief Read the basic properties of a .webm file without starting playback.
+ *
+ * Only the headers, the tracks, the Cues, and the start of the first cluster are read.
+ * No threads, queues, or decoders are created, so this is far cheaper than creating a
+ * @ref Sav1Context just to look at a file.
+ *
+ * @param[in] file_path path to the .webm file
+ * @param[out] info pointer to a `Sav1ProbeInfo` struct to fill in
+ * @return 0 on success, or < 0 if the file couldn't be opened or isn't a .webm file
+ *
+ * @sa sav1_probe_buffer
+ * @sa sav1_probe_io
+ */
+SAV1_API int
+sav1_probe_file(const char *file_path, Sav1ProbeInfo *info);
+
+/**
+ * @brief Read the basic properties of a .webm file that's already in memory.
+ *
+ * @param[in] buffer pointer to the file's contents
+ * @param[in] size the number of bytes in `buffer`
+ * @param[out] info pointer to a `Sav1ProbeInfo` struct to fill in
+ * @return 0 on success, or < 0 if the buffer isn't a .webm file
+ *
+ * @sa sav1_probe_file
+ */
+SAV1_API int
+sav1_probe_buffer(const uint8_t *buffer, size_t size, Sav1ProbeInfo *info);
+
+/**
+ * @brief Read the basic properties of a .webm file through custom input functions.
+ *
+ * The functions are called from the calling thread before this function returns. If
+ * `io->seek` is `NULL` then Cues that come after the clusters can't be reached, and
+ * @ref Sav1ProbeInfo.num_key_frames is left as 0.
+ *
+ * @param[in] io pointer to the input functions
+ * @param[out] info pointer to a `Sav1ProbeInfo` struct to fill in
+ * @return 0 on success, or < 0 if the input isn't a .webm file
+ *
+ * @sa sav1_probe_file
+ * @sa sav1_settings_use_io
+ */
+SAV1_API int
+sav1_probe_io(const Sav1IO *io, Sav1ProbeInfo *info);
+
+#endif
@@ -8,6 +8,8 @@
 
 typedef struct Sav1VideoFrame Sav1VideoFrame;
 typedef struct Sav1AudioFrame Sav1AudioFrame;
+typedef struct Sav1SharedSource Sav1SharedSource;
+typedef struct Sav1DecodeBudget Sav1DecodeBudget;
 
 #define SAV1_CODEC_AV1 1
 #define SAV1_CODEC_OPUS 2
@@ -45,7 +47,9 @@ typedef enum {
 
 typedef enum {
     /** Frames are synchronized to real time. Frames may be skipped if the video is
-       behind. */
+       behind. When decoding can't keep up, frames that no others depend on aren't
+       decoded at all, and if playback still falls a second behind, decoding jumps
+       ahead to the next keyframe. */
     SAV1_PLAYBACK_TIMED,
 
     /** For frame iteration: frames are not synchronized to real time, and no frames are
@@ -58,9 +62,118 @@ typedef enum {
     SAV1_FILE_END_WAIT,
 
     /** Restart the video automatically upon reaching the end. */
-    SAV1_FILE_END_LOOP
+    SAV1_FILE_END_LOOP,
+
+    /** Treat the file as still being written, such as a recording in progress, and wait
+       for more of it to appear upon reaching the end. Playback continues from where it
+       left off as soon as the file grows, and the duration grows along with it when the
+       file doesn't have one. Only useful for `file_path` and custom input, since a
+       `file_buffer` can't grow. */
+    SAV1_FILE_END_FOLLOW
 } Sav1OnFileEnd;
 
+typedef enum {
+    /** Map the file into memory and let the operating system load it as needed. */
+    SAV1_FILE_READ_MAPPED,
+
+    /** Read large chunks of the file ahead of time on a separate thread. Can hide
+       latency on slow disks and network filesystems. Not available on Windows, where
+       the file is mapped instead. */
+    SAV1_FILE_READ_PREFETCH,
+
+    /** Like `SAV1_FILE_READ_PREFETCH`, but the reads of every context using this mode
+       are batched through one I/O engine shared by the whole process instead of each
+       context blocking its own thread. The engine uses io_uring when SAV1 is built with
+       the `use_io_uring` option and the kernel supports it, and a small thread pool
+       otherwise. Useful when many contexts play at once. Not available on Windows. */
+    SAV1_FILE_READ_SHARED
+} Sav1FileReadMode;
+
+typedef enum {
+    /** Play the first AV1 track unless the user picks another with
+       @ref sav1_select_video_track. */
+    SAV1_VIDEO_TRACK_MANUAL,
+
+    /** Start with the largest AV1 track, and switch to the next smaller one at a
+       keyframe whenever decoding can't keep up with timed playback. Only useful for
+       files with several renditions of the same video. */
+    SAV1_VIDEO_TRACK_AUTO
+} Sav1VideoTrackMode;
+
+typedef enum {
+    /** Pick the number of decoder threads and the frame delay from the resolution of the
+       video and the number of cores, so that small videos leave the cores to the large
+       ones. */
+    SAV1_DECODE_PRESET_AUTO,
+
+    /** Decode every frame as soon as it arrives with a frame delay of 1, spreading the
+       work of each frame over a few threads. Best for interactive scrubbing. */
+    SAV1_DECODE_PRESET_LOW_LATENCY,
+
+    /** Use every core and let the decoder work on several frames at once. Best for
+       playing 4K video, at the cost of a few frames of latency after a seek. */
+    SAV1_DECODE_PRESET_THROUGHPUT
+} Sav1DecodePreset;
+
+typedef enum {
+    /** Decode every frame. */
+    SAV1_DECODE_FRAMES_ALL = 0,
+
+    /** Skip the frames that no other frame is predicted from, which are usually the
+       cheapest to leave out. */
+    SAV1_DECODE_FRAMES_REFERENCE = 1,
+
+    /** Only decode the frames that don't depend on any other, such as keyframes. */
+    SAV1_DECODE_FRAMES_INTRA = 2,
+
+    /** Only decode keyframes. */
+    SAV1_DECODE_FRAMES_KEY = 3
+} Sav1DecodeFrameType;
+
+/**
+ * @brief Trade-offs between video quality and decoding speed.
+ *
+ * Turning off film grain and skipping frames both save a lot of decoding time on slow
+ * machines. Frames that aren't decoded are simply never returned, so the frame before
+ * them stays on screen for longer.
+ *
+ * @sa sav1_set_decode_profile
+ */
+typedef struct Sav1DecodeProfile {
+    int apply_grain; /**< Whether to add the film grain described by the video to each
+                        frame. */
+    Sav1DecodeFrameType frame_type; /**< Which frames to decode. */
+    unsigned int frame_size_limit;  /**< The largest frame to decode, in pixels, or `0`
+                                       for no limit. Larger frames are treated as
+                                       errors. */
+    int strict_std_compliance; /**< Whether to reject videos that don't follow the AV1
+                                  specification exactly instead of working around their
+                                  mistakes. */
+} Sav1DecodeProfile;
+
+/**
+ * @brief Custom input functions for SAV1.
+ *
+ * Lets SAV1 pull the .webm file from any source, such as a pipe, a stream decompressed
+ * from an archive, or an application's own file layer. Only `read` is required. All
+ * positions are in bytes from the start of the .webm file.
+ */
+typedef struct Sav1IO {
+    int64_t (*read)(void *cookie, uint8_t *buffer,
+                    size_t size); /**< Read up to `size` bytes into `buffer`, returning
+                                     the number of bytes read, 0 at the end of the
+                                     input, or < 0 on error. */
+    int (*seek)(void *cookie,
+                uint64_t position); /**< Move to `position`, returning 0 on success or
+                                       < 0 on error. `NULL` if the input can't seek. */
+    int64_t (*tell)(void *cookie);  /**< Return the current position, or < 0 on error.
+                                       `NULL` if the input always starts at position
+                                       0. */
+    int64_t (*get_size)(void *cookie); /**< Return the total size of the input, or < 0
+                                          if it isn't known. Can be `NULL`. */
+    void *cookie; /**< Optional custom data that is passed to the functions above. */
+} Sav1IO;
+
 /**
  * @brief Settings for SAV1.
  *
@@ -68,7 +181,10 @@ typedef enum {
  * format and customize the processing behavior.
  */
 typedef struct Sav1Settings {
-    char *file_path;   /**< The path of the .webm file to be decoded. */
+    char *file_path;   /**< The path of the .webm file to be decoded. IVF files and raw
+                          AV1 OBU streams, in either the low overhead format or Annex B,
+                          are read too. They only hold video, so set `codec_target` to
+                          `SAV1_CODEC_AV1` for them. */
     int codec_target;  /**< The bitwise indication for which codecs to decode. */
     size_t queue_size; /**< The size of the internal queues used by SAV1. Larger queues
                           require more memory, but allow SAV1 to have more frames ready to
@@ -105,7 +221,45 @@ typedef struct Sav1Settings {
     Sav1PlaybackMode playback_mode; /**< Whether the file should be played back
                                        synchronously or as fast as possible. */
     Sav1OnFileEnd
-        on_file_end; /**< Whether playback should loop or wait after the file ends. */
+        on_file_end; /**< What playback should do after reaching the end of the file. */
+    char *index_cache_path; /**< The path of a file used to cache the seek index between
+                               runs so the file doesn't have to be scanned again, or
+                               `NULL` to disable caching. */
+    int use_background_indexing; /**< Whether to scan the whole file for seek points in
+                                    a low priority thread, so seeking never has to search
+                                    through the file first. */
+    const uint8_t *file_buffer;  /**< A caller-owned buffer holding the entire .webm
+                                    file to be decoded instead of reading from
+                                    `file_path`, or `NULL` to read from `file_path`. */
+    size_t file_buffer_size;     /**< The size of `file_buffer` in bytes. */
+    Sav1IO io; /**< Custom input functions to read the .webm file with instead of
+                  `file_path`. Unused when `io.read` is `NULL`. */
+    size_t read_ahead_size; /**< The number of bytes read ahead at a time from custom
+                               input so that small reads are served from memory. */
+    Sav1FileReadMode file_read_mode; /**< How the file at `file_path` is read. */
+    size_t prefetch_chunk_size; /**< The size of each chunk read ahead of time when
+                                   `file_read_mode` is `SAV1_FILE_READ_PREFETCH` or
+                                   `SAV1_FILE_READ_SHARED`. */
+    size_t chapter_frame_cache_size; /**< How many chapters to keep the first video
+                                        frame of, so that @ref sav1_seek_to_chapter can
+                                        show it right away while decoding catches up,
+                                        or `0` to disable. */
+    Sav1VideoTrackMode video_track_mode; /**< How the AV1 track to play is chosen when
+                                            the file has more than one. */
+    Sav1SharedSource *shared_source; /**< A shared source to play frames from instead of
+                                        decoding the file separately, or `NULL`. */
+    Sav1DecodePreset decode_preset; /**< How the AV1 decoder's threads are set up. */
+    int decode_threads;     /**< The number of threads the AV1 decoder uses, or `0` to
+                               take it from `decode_preset`. */
+    int decode_frame_delay; /**< The most frames the AV1 decoder works on at once, or
+                               `0` to take it from `decode_preset`. `1` turns off frame
+                               threading so each frame comes out as soon as it's done. */
+    Sav1DecodeProfile decode_profile; /**< The AV1 decoder's quality and speed
+                                         trade-offs. */
+    Sav1DecodeBudget *decode_budget; /**< A budget to share the AV1 decoder's threads
+                                        with other contexts through, or `NULL`. Takes
+                                        priority over `decode_preset` and
+                                        `decode_threads`. */
 } Sav1Settings;
 
 /**
@@ -125,6 +279,22 @@ typedef struct Sav1Settings {
  * - @ref Sav1Settings.playback_mode defaults to `SAV1_PLAYBACK_TIMED`
  * - @ref Sav1Settings.on_file_end defaults to `SAV1_FILE_END_WAIT`
  * - @ref Sav1Settings.playback_speed defaults to `1.0`
+ * - @ref Sav1Settings.index_cache_path defaults to `NULL`
+ * - @ref Sav1Settings.use_background_indexing defaults to `0`
+ * - @ref Sav1Settings.file_buffer defaults to `NULL`
+ * - @ref Sav1Settings.io defaults to all `NULL` members
+ * - @ref Sav1Settings.read_ahead_size defaults to `65536`
+ * - @ref Sav1Settings.file_read_mode defaults to `SAV1_FILE_READ_MAPPED`
+ * - @ref Sav1Settings.prefetch_chunk_size defaults to `2097152` (2 MiB)
+ * - @ref Sav1Settings.chapter_frame_cache_size defaults to `0`
+ * - @ref Sav1Settings.video_track_mode defaults to `SAV1_VIDEO_TRACK_MANUAL`
+ * - @ref Sav1Settings.shared_source defaults to `NULL`
+ * - @ref Sav1Settings.decode_preset defaults to `SAV1_DECODE_PRESET_AUTO`
+ * - @ref Sav1Settings.decode_threads defaults to `0`
+ * - @ref Sav1Settings.decode_frame_delay defaults to `0`
+ * - @ref Sav1Settings.decode_profile defaults to applying film grain, decoding
+ *   `SAV1_DECODE_FRAMES_ALL`, no frame size limit, and no strict compliance
+ * - @ref Sav1Settings.decode_budget defaults to `NULL`
  *
  * @param[in] settings pointer to a SAV1 settings struct that will be modified
  * @param[in] file_path path to the file that will be played
@@ -133,10 +303,88 @@ typedef struct Sav1Settings {
  * @sa Sav1AudioFrequency
  * @sa Sav1AudioChannel
  * @sa Sav1PlaybackMode
+ * @sa Sav1FileReadMode
+ * @sa Sav1VideoTrackMode
+ * @sa Sav1DecodePreset
+ * @sa Sav1DecodeProfile
  */
 SAV1_API void
 sav1_default_settings(Sav1Settings *settings, char *file_path);
 
+/**
+ * @brief Decode a .webm file that is already in memory.
+ *
+ * Set up SAV1 to read the file from a buffer owned by the caller instead of from
+ * @ref Sav1Settings.file_path. The buffer is read in place without being copied, so it
+ * must stay valid and unmodified until the @ref Sav1Context is destroyed. This is useful
+ * for videos packed inside an archive or otherwise loaded by the application. The
+ * seek index cache is not used when reading from a buffer.
+ *
+ * @param[in] settings pointer to a SAV1 settings struct
+ * @param[in] buffer pointer to the contents of the .webm file
+ * @param[in] size size of `buffer` in bytes
+ *
+ * @sa Sav1Settings
+ */
+SAV1_API void
+sav1_settings_use_file_buffer(Sav1Settings *settings, const uint8_t *buffer, size_t size);
+
+/**
+ * @brief Decode a .webm file through custom input functions.
+ *
+ * Set up SAV1 to read the file through the functions in `io` instead of from
+ * @ref Sav1Settings.file_path. The functions are only ever called from SAV1's parsing
+ * thread, and reads are buffered according to @ref Sav1Settings.read_ahead_size. If
+ * `io->seek` is `NULL` then the input is read once from start to finish, so seeking and
+ * looping aren't possible.
+ *
+ * @param[in] settings pointer to a SAV1 settings struct
+ * @param[in] io pointer to the input functions, which is copied into `settings`
+ *
+ * @sa Sav1IO
+ * @sa Sav1Settings
+ */
+SAV1_API void
+sav1_settings_use_io(Sav1Settings *settings, const Sav1IO *io);
+
+/**
+ * @brief Play the frames of a shared source instead of decoding the file separately.
+ *
+ * A @ref Sav1Context created with these settings attaches to `source` rather than
+ * starting a pipeline of its own. Only @ref Sav1Settings.playback_mode, @ref
+ * Sav1Settings.playback_speed, @ref Sav1Settings.queue_size, and @ref
+ * Sav1Settings.chapter_frame_cache_size are taken from these settings. Everything else,
+ * including the file, the output formats, and the custom processing, comes from the
+ * settings that the source was created with. Tracks can't be selected on an attached
+ * context, so @ref Sav1Settings.video_track_mode is always `SAV1_VIDEO_TRACK_MANUAL`.
+ *
+ * @param[in] settings pointer to a SAV1 settings struct
+ * @param[in] source pointer to a shared source created with @ref
+ * sav1_create_shared_source
+ *
+ * @sa Sav1SharedSource
+ * @sa Sav1Settings
+ */
+SAV1_API void
+sav1_settings_use_shared_source(Sav1Settings *settings, Sav1SharedSource *source);
+
+/**
+ * @brief Share the AV1 decoder's threads with other contexts through a budget.
+ *
+ * A @ref Sav1Context created with these settings takes its share of the budget's
+ * threads instead of choosing a number of threads from @ref Sav1Settings.decode_preset
+ * or @ref Sav1Settings.decode_threads. The frame delay is still chosen as usual.
+ *
+ * @param[in] settings pointer to a SAV1 settings struct
+ * @param[in] budget pointer to a decode budget created with @ref
+ * sav1_create_decode_budget
+ *
+ * @sa Sav1DecodeBudget
+ * @sa Sav1Settings
+ */
+SAV1_API void
+sav1_settings_use_decode_budget(Sav1Settings *settings, Sav1DecodeBudget *budget);
+
 /**
  * @brief Set up custom video processing for every @ref Sav1VideoFrame.
  *
@@ -0,0 +1,69 @@
+#ifndef SAV1_SHARED_SOURCE_H
+#define SAV1_SHARED_SOURCE_H
+
+#include <stdint.h>
+
+#include "common.h"
+#include "sav1_settings.h"
+
+/**
+ * @brief Struct to represent one file being decoded for several contexts at once.
+ *
+ * When the same file is played in more than one place at the same time, such as a
+ * looping background video shown in several panels, each @ref Sav1Context would
+ * normally parse, decode, and convert the same frames on its own. Contexts created with
+ * @ref Sav1Settings.shared_source set instead all play the frames of one pipeline, so the
+ * work is only done once no matter how many contexts there are.
+ *
+ * @sa sav1_create_shared_source
+ * @sa sav1_settings_use_shared_source
+ */
+typedef struct Sav1SharedSource {
+    /** (internal use) Pointer to SAV1's internal state, hidden from the user. */
+    void *internal_state;
+
+    /** (internal use) */
+    uint8_t is_initialized;
+} Sav1SharedSource;
+
+/**
+ * @brief Start decoding a file that several contexts can play.
+ *
+ * The file is opened and decoded according to `settings` just like it would be by @ref
+ * sav1_create_context. Every @ref Sav1Context attached to the source with @ref
+ * sav1_settings_use_shared_source is handed the same frames, which are only freed once
+ * every context is done with them.
+ *
+ * Contexts can be attached at any time, and a context attached after the others have
+ * started picks up from wherever they are. Seeking any attached context seeks all of
+ * them. Decoding keeps pace with the attached contexts, except that a context which
+ * stops taking frames for half a second, for example because it's paused, no longer
+ * holds the others up and has its oldest frames dropped instead. Since the frames'
+ * data is shared between the contexts, it must not be modified.
+ *
+ * @param[in] source pointer to an empty shared source struct
+ * @param[in] settings pointer to an initialized SAV1 settings struct
+ * @return 0 on success, or < 0 on error
+ *
+ * @sa sav1_destroy_shared_source
+ * @sa sav1_settings_use_shared_source
+ */
+SAV1_API int
+sav1_create_shared_source(Sav1SharedSource *source, Sav1Settings *settings);
+
+/**
+ * @brief Let go of a shared source.
+ *
+ * The decoding keeps running until every context attached to the source has been
+ * destroyed too, so this can be called as soon as the last context has been created. No
+ * more contexts can be attached to the source afterwards.
+ *
+ * @param[in] source pointer to a shared source struct
+ * @return 0 on success, or < 0 on error
+ *
+ * @sa sav1_create_shared_source
+ */
+SAV1_API int
+sav1_destroy_shared_source(Sav1SharedSource *source);
+
+#endif
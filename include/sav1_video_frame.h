@@ -36,6 +36,7 @@ typedef struct Sav1VideoFrame {
 
     int sentinel;           /**< (internal use) */
     int sav1_has_ownership; /**< (internal use) */
+    void *shared_frame;     /**< (internal use) */
 } Sav1VideoFrame;
 
 /**
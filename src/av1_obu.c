@@ -0,0 +1,552 @@
+#include "av1_obu.h"
+
+// the OBU types that come before or hold a frame header
+#define AV1_OBU_SEQUENCE_HEADER 1
+#define AV1_OBU_FRAME_HEADER 3
+#define AV1_OBU_FRAME 6
+
+#define AV1_KEY_FRAME 0
+#define AV1_INTRA_ONLY_FRAME 2
+#define AV1_SWITCH_FRAME 3
+
+// the value of the sequence header's screen content and integer motion vector flags
+// when each frame header chooses for itself
+#define AV1_SELECT 2
+
+// read an unsigned LEB128 value, returning the number of bytes it took or 0 if it
+// doesn't fit in size bytes
+static size_t
+av1_obu_read_leb128(const uint8_t *data, size_t size, uint64_t *value)
+{
+    *value = 0;
+    for (size_t i = 0; i < size && i < 8; i++) {
+        *value |= (uint64_t)(data[i] & 0x7f) << (i * 7);
+        if (!(data[i] & 0x80)) {
+            return i + 1;
+        }
+    }
+    return 0;
+}
+
+// reads a big-endian bit field at a time from the start of an OBU payload
+typedef struct Av1BitReader {
+    const uint8_t *data;
+    size_t size;
+    size_t bit_position;
+} Av1BitReader;
+
+// read num_bits bits, returning 0 if it runs past the end
+static int
+av1_obu_read_bits(Av1BitReader *bits, int num_bits, uint32_t *value)
+{
+    *value = 0;
+    for (int i = 0; i < num_bits; i++) {
+        size_t byte = bits->bit_position >> 3;
+        if (byte >= bits->size) {
+            return 0;
+        }
+        int bit = (bits->data[byte] >> (7 - (bits->bit_position & 7))) & 1;
+        *value = (*value << 1) | (uint32_t)bit;
+        bits->bit_position++;
+    }
+    return 1;
+}
+
+// read an exp-Golomb coded value, returning 0 if it runs past the end
+static int
+av1_obu_read_uvlc(Av1BitReader *bits, uint32_t *value)
+{
+    int leading_zeros = 0;
+    uint32_t bit = 0;
+    while (!bit) {
+        if (!av1_obu_read_bits(bits, 1, &bit)) {
+            return 0;
+        }
+        if (!bit) {
+            leading_zeros++;
+        }
+    }
+    if (leading_zeros >= 32) {
+        *value = UINT32_MAX;
+        return 1;
+    }
+    uint32_t rest;
+    if (!av1_obu_read_bits(bits, leading_zeros, &rest)) {
+        return 0;
+    }
+    *value = rest + (uint32_t)((1ULL << leading_zeros) - 1);
+    return 1;
+}
+
+// find the first OBU of obu_type, setting its payload. returns 0 if there isn't one in
+// the first size bytes
+static int
+av1_obu_find(const uint8_t *data, size_t size, int obu_type, const uint8_t **payload,
+             size_t *payload_size)
+{
+    while (size > 0) {
+        int has_extension = (data[0] >> 2) & 1;
+        int has_size = (data[0] >> 1) & 1;
+        size_t header_size = 1 + (size_t)has_extension;
+        if (header_size > size) {
+            return 0;
+        }
+        uint64_t obu_size = size - header_size;
+        if (has_size) {
+            size_t num_bytes =
+                av1_obu_read_leb128(data + header_size, size - header_size, &obu_size);
+            if (num_bytes == 0) {
+                return 0;
+            }
+            header_size += num_bytes;
+        }
+        if (obu_size > size - header_size) {
+            return 0;
+        }
+        if (((data[0] >> 3) & 0x0f) == obu_type) {
+            *payload = data + header_size;
+            *payload_size = (size_t)obu_size;
+            return 1;
+        }
+        data += header_size + (size_t)obu_size;
+        size -= header_size + (size_t)obu_size;
+    }
+    return 0;
+}
+
+int
+av1_obu_get_frame_rate(const uint8_t *data, size_t size, double *frame_rate)
+{
+    Av1BitReader bits;
+    if (!av1_obu_find(data, size, AV1_OBU_SEQUENCE_HEADER, &(bits.data), &(bits.size))) {
+        return -1;
+    }
+    bits.bit_position = 0;
+
+    // seq_profile (3 bits), still_picture (1), reduced_still_picture_header (1), then
+    // timing_info_present_flag (1) unless the header is reduced
+    uint32_t value;
+    if (!av1_obu_read_bits(&bits, 5, &value) || (value & 1) ||
+        !av1_obu_read_bits(&bits, 1, &value) || !value) {
+        return -1;
+    }
+
+    // timing_info(): num_units_in_display_tick (32), time_scale (32), and
+    // equal_picture_interval (1) followed by num_ticks_per_picture_minus_1
+    uint32_t num_units_in_display_tick, time_scale, equal_picture_interval;
+    uint32_t num_ticks_per_picture_minus_1 = 0;
+    if (!av1_obu_read_bits(&bits, 32, &num_units_in_display_tick) ||
+        !av1_obu_read_bits(&bits, 32, &time_scale) ||
+        !av1_obu_read_bits(&bits, 1, &equal_picture_interval) ||
+        (equal_picture_interval &&
+         !av1_obu_read_uvlc(&bits, &num_ticks_per_picture_minus_1))) {
+        return -1;
+    }
+    if (num_units_in_display_tick == 0 || time_scale == 0) {
+        return -1;
+    }
+    *frame_rate = (double)time_scale / ((double)num_units_in_display_tick *
+                                        ((double)num_ticks_per_picture_minus_1 + 1));
+    return 0;
+}
+
+int
+av1_obu_is_key_frame(const uint8_t *data, size_t size)
+{
+    // a stream made of still pictures leaves the frame type out, since every frame is
+    // a keyframe
+    int reduced_still_picture_header = 0;
+
+    while (size > 0) {
+        // obu_header(): forbidden bit, type, extension flag and size flag
+        int obu_type = (data[0] >> 3) & 0x0f;
+        int has_extension = (data[0] >> 2) & 1;
+        int has_size = (data[0] >> 1) & 1;
+        size_t header_size = 1 + (size_t)has_extension;
+        if (header_size > size) {
+            return -1;
+        }
+
+        // the last OBU in a frame is allowed to leave out its size
+        uint64_t obu_size = size - header_size;
+        if (has_size) {
+            size_t num_bytes =
+                av1_obu_read_leb128(data + header_size, size - header_size, &obu_size);
+            if (num_bytes == 0) {
+                return -1;
+            }
+            header_size += num_bytes;
+        }
+        const uint8_t *payload = data + header_size;
+        size_t payload_size = size - header_size;
+
+        if (obu_type == AV1_OBU_SEQUENCE_HEADER && payload_size > 0) {
+            // seq_profile (3 bits), still_picture (1), reduced_still_picture_header (1)
+            reduced_still_picture_header = (payload[0] >> 3) & 1;
+        }
+        else if (obu_type == AV1_OBU_FRAME_HEADER || obu_type == AV1_OBU_FRAME) {
+            if (reduced_still_picture_header) {
+                return 1;
+            }
+            if (payload_size == 0) {
+                return -1;
+            }
+
+            // show_existing_frame (1 bit), frame_type (2), show_frame (1). a frame
+            // that's shown again doesn't say what type it was, so it can't be a
+            // starting point
+            int show_existing_frame = payload[0] >> 7;
+            int frame_type = (payload[0] >> 5) & 3;
+            int show_frame = (payload[0] >> 4) & 1;
+            return !show_existing_frame && frame_type == AV1_KEY_FRAME && show_frame;
+        }
+
+        // move on to the next OBU
+        if (obu_size >= payload_size) {
+            return -1;
+        }
+        data = payload + obu_size;
+        size = payload_size - (size_t)obu_size;
+    }
+    return -1;
+}
+
+int
+av1_obu_get_sequence_info(const uint8_t *data, size_t size, Av1SequenceInfo *info)
+{
+    Av1BitReader bits;
+    if (!av1_obu_find(data, size, AV1_OBU_SEQUENCE_HEADER, &(bits.data), &(bits.size))) {
+        return -1;
+    }
+    bits.bit_position = 0;
+
+    // seq_profile (3 bits), still_picture (1), reduced_still_picture_header (1)
+    uint32_t value;
+    if (!av1_obu_read_bits(&bits, 5, &value)) {
+        return -1;
+    }
+    info->reduced_still_picture_header = value & 1;
+    info->buffer_removal_time_length = 0;
+    info->frame_presentation_time_length = 0;
+    info->decoder_model_info_present = 0;
+    info->equal_picture_interval = 0;
+    info->num_operating_points = 1;
+    info->operating_point_idc[0] = 0;
+    info->decoder_model_present_for_op[0] = 0;
+
+    uint32_t buffer_delay_length = 0;
+    if (info->reduced_still_picture_header) {
+        // seq_level_idx[0]
+        if (!av1_obu_read_bits(&bits, 5, &value)) {
+            return -1;
+        }
+    }
+    else {
+        uint32_t timing_info_present;
+        if (!av1_obu_read_bits(&bits, 1, &timing_info_present)) {
+            return -1;
+        }
+        if (timing_info_present) {
+            // num_units_in_display_tick (32), time_scale (32), equal_picture_interval (1)
+            uint32_t equal_picture_interval;
+            if (!av1_obu_read_bits(&bits, 32, &value) ||
+                !av1_obu_read_bits(&bits, 32, &value) ||
+                !av1_obu_read_bits(&bits, 1, &equal_picture_interval) ||
+                (equal_picture_interval && !av1_obu_read_uvlc(&bits, &value))) {
+                return -1;
+            }
+            info->equal_picture_interval = (int)equal_picture_interval;
+
+            uint32_t decoder_model_info_present;
+            if (!av1_obu_read_bits(&bits, 1, &decoder_model_info_present)) {
+                return -1;
+            }
+            info->decoder_model_info_present = (int)decoder_model_info_present;
+            if (decoder_model_info_present) {
+                // decoder_model_info(): buffer_delay_length_minus_1 (5),
+                // num_units_in_decoding_tick (32), buffer_removal_time_length_minus_1
+                // (5), frame_presentation_time_length_minus_1 (5)
+                uint32_t buffer_removal_time_length, frame_presentation_time_length;
+                if (!av1_obu_read_bits(&bits, 5, &buffer_delay_length) ||
+                    !av1_obu_read_bits(&bits, 32, &value) ||
+                    !av1_obu_read_bits(&bits, 5, &buffer_removal_time_length) ||
+                    !av1_obu_read_bits(&bits, 5, &frame_presentation_time_length)) {
+                    return -1;
+                }
+                buffer_delay_length++;
+                info->buffer_removal_time_length = (int)buffer_removal_time_length + 1;
+                info->frame_presentation_time_length =
+                    (int)frame_presentation_time_length + 1;
+            }
+        }
+
+        uint32_t initial_display_delay_present, num_operating_points;
+        if (!av1_obu_read_bits(&bits, 1, &initial_display_delay_present) ||
+            !av1_obu_read_bits(&bits, 5, &num_operating_points)) {
+            return -1;
+        }
+        info->num_operating_points = (int)num_operating_points + 1;
+        for (int i = 0; i < info->num_operating_points; i++) {
+            // operating_point_idc (12), seq_level_idx (5), and seq_tier (1) above level 7
+            uint32_t seq_level_idx;
+            if (!av1_obu_read_bits(&bits, 12, &(info->operating_point_idc[i])) ||
+                !av1_obu_read_bits(&bits, 5, &seq_level_idx) ||
+                (seq_level_idx > 7 && !av1_obu_read_bits(&bits, 1, &value))) {
+                return -1;
+            }
+            info->decoder_model_present_for_op[i] = 0;
+            if (info->decoder_model_info_present) {
+                uint32_t decoder_model_present;
+                if (!av1_obu_read_bits(&bits, 1, &decoder_model_present)) {
+                    return -1;
+                }
+                info->decoder_model_present_for_op[i] = (int)decoder_model_present;
+
+                // operating_parameters_info(): decoder_buffer_delay,
+                // encoder_buffer_delay, low_delay_mode_flag (1)
+                if (decoder_model_present &&
+                    (!av1_obu_read_bits(&bits, (int)buffer_delay_length, &value) ||
+                     !av1_obu_read_bits(&bits, (int)buffer_delay_length, &value) ||
+                     !av1_obu_read_bits(&bits, 1, &value))) {
+                    return -1;
+                }
+            }
+            if (initial_display_delay_present) {
+                // initial_display_delay_present_for_this_op (1), then
+                // initial_display_delay_minus_1 (4)
+                if (!av1_obu_read_bits(&bits, 1, &value) ||
+                    (value && !av1_obu_read_bits(&bits, 4, &value))) {
+                    return -1;
+                }
+            }
+        }
+    }
+
+    // frame_width_bits_minus_1 (4), frame_height_bits_minus_1 (4), then the largest
+    // frame size in that many bits each
+    uint32_t frame_width_bits, frame_height_bits;
+    if (!av1_obu_read_bits(&bits, 4, &frame_width_bits) ||
+        !av1_obu_read_bits(&bits, 4, &frame_height_bits) ||
+        !av1_obu_read_bits(&bits, (int)frame_width_bits + 1, &value) ||
+        !av1_obu_read_bits(&bits, (int)frame_height_bits + 1, &value)) {
+        return -1;
+    }
+
+    // frame_id_numbers_present_flag (1), then delta_frame_id_length_minus_2 (4) and
+    // additional_frame_id_length_minus_1 (3)
+    info->frame_id_length = 0;
+    if (!info->reduced_still_picture_header) {
+        uint32_t delta_frame_id_length, additional_frame_id_length;
+        if (!av1_obu_read_bits(&bits, 1, &value)) {
+            return -1;
+        }
+        if (value) {
+            if (!av1_obu_read_bits(&bits, 4, &delta_frame_id_length) ||
+                !av1_obu_read_bits(&bits, 3, &additional_frame_id_length)) {
+                return -1;
+            }
+            info->frame_id_length =
+                (int)additional_frame_id_length + (int)delta_frame_id_length + 3;
+        }
+    }
+
+    // use_128x128_superblock, enable_filter_intra, enable_intra_edge (1 bit each)
+    if (!av1_obu_read_bits(&bits, 3, &value)) {
+        return -1;
+    }
+    info->force_screen_content_tools = AV1_SELECT;
+    info->force_integer_mv = AV1_SELECT;
+    info->order_hint_bits = 0;
+    if (info->reduced_still_picture_header) {
+        return 0;
+    }
+
+    // enable_interintra_compound, enable_masked_compound, enable_warped_motion,
+    // enable_dual_filter, enable_order_hint (1 bit each), then enable_jnt_comp and
+    // enable_ref_frame_mvs (1 bit each) with order hints
+    uint32_t enable_order_hint;
+    if (!av1_obu_read_bits(&bits, 4, &value) ||
+        !av1_obu_read_bits(&bits, 1, &enable_order_hint) ||
+        (enable_order_hint && !av1_obu_read_bits(&bits, 2, &value))) {
+        return -1;
+    }
+
+    // seq_choose_screen_content_tools (1) or seq_force_screen_content_tools (1), then the
+    // same for integer motion vectors if screen content tools can be used
+    if (!av1_obu_read_bits(&bits, 1, &value)) {
+        return -1;
+    }
+    if (!value) {
+        if (!av1_obu_read_bits(&bits, 1, &value)) {
+            return -1;
+        }
+        info->force_screen_content_tools = (int)value;
+    }
+    if (info->force_screen_content_tools > 0) {
+        if (!av1_obu_read_bits(&bits, 1, &value)) {
+            return -1;
+        }
+        if (!value) {
+            if (!av1_obu_read_bits(&bits, 1, &value)) {
+                return -1;
+            }
+            info->force_integer_mv = (int)value;
+        }
+    }
+
+    // order_hint_bits_minus_1 (3)
+    if (enable_order_hint) {
+        if (!av1_obu_read_bits(&bits, 3, &value)) {
+            return -1;
+        }
+        info->order_hint_bits = (int)value + 1;
+    }
+    return 0;
+}
+
+// read the start of an uncompressed frame header up to refresh_frame_flags. returns 1 if
+// the frame is kept for others to be predicted from, 0 if it isn't, and -1 if the header
+// is cut short
+static int
+av1_obu_refreshes_frames(Av1BitReader *bits, const Av1SequenceInfo *info,
+                         int temporal_id, int spatial_id)
+{
+    if (info->reduced_still_picture_header) {
+        return 1;  // every frame is a keyframe
+    }
+
+    // a frame that's shown again doesn't say what type it was, and shown keyframes
+    // refresh every reference, so count it as one
+    uint32_t show_existing_frame, frame_type, show_frame, value;
+    if (!av1_obu_read_bits(bits, 1, &show_existing_frame)) {
+        return -1;
+    }
+    if (show_existing_frame) {
+        return 1;
+    }
+    if (!av1_obu_read_bits(bits, 2, &frame_type) ||
+        !av1_obu_read_bits(bits, 1, &show_frame)) {
+        return -1;
+    }
+
+    // shown keyframes and switch frames always refresh every reference
+    if (frame_type == AV1_SWITCH_FRAME || (frame_type == AV1_KEY_FRAME && show_frame)) {
+        return 1;
+    }
+
+    // temporal_point_info(), or showable_frame (1) for hidden frames
+    if (show_frame && info->decoder_model_info_present &&
+        !info->equal_picture_interval &&
+        !av1_obu_read_bits(bits, info->frame_presentation_time_length, &value)) {
+        return -1;
+    }
+    if (!show_frame && !av1_obu_read_bits(bits, 1, &value)) {
+        return -1;
+    }
+
+    // error_resilient_mode (1), disable_cdf_update (1)
+    uint32_t error_resilient_mode;
+    if (!av1_obu_read_bits(bits, 1, &error_resilient_mode) ||
+        !av1_obu_read_bits(bits, 1, &value)) {
+        return -1;
+    }
+
+    // allow_screen_content_tools, then force_integer_mv if the sequence lets frames pick
+    uint32_t allow_screen_content_tools = (uint32_t)info->force_screen_content_tools;
+    if (info->force_screen_content_tools == AV1_SELECT &&
+        !av1_obu_read_bits(bits, 1, &allow_screen_content_tools)) {
+        return -1;
+    }
+    if (allow_screen_content_tools && info->force_integer_mv == AV1_SELECT &&
+        !av1_obu_read_bits(bits, 1, &value)) {
+        return -1;
+    }
+
+    // current_frame_id, frame_size_override_flag (1), order_hint, and primary_ref_frame
+    // (3) for frames that are predicted from others
+    int is_intra = frame_type == AV1_INTRA_ONLY_FRAME || frame_type == AV1_KEY_FRAME;
+    if ((info->frame_id_length > 0 &&
+         !av1_obu_read_bits(bits, info->frame_id_length, &value)) ||
+        !av1_obu_read_bits(bits, 1, &value) ||
+        !av1_obu_read_bits(bits, info->order_hint_bits, &value) ||
+        (!is_intra && !error_resilient_mode && !av1_obu_read_bits(bits, 3, &value))) {
+        return -1;
+    }
+
+    // buffer_removal_time_present_flag (1), then a buffer_removal_time for each
+    // operating point with a decoder model that this frame's layer belongs to
+    if (info->decoder_model_info_present) {
+        uint32_t buffer_removal_time_present;
+        if (!av1_obu_read_bits(bits, 1, &buffer_removal_time_present)) {
+            return -1;
+        }
+        for (int i = 0; buffer_removal_time_present && i < info->num_operating_points;
+             i++) {
+            if (!info->decoder_model_present_for_op[i]) {
+                continue;
+            }
+            uint32_t idc = info->operating_point_idc[i];
+            int is_in_temporal_layer = (idc >> temporal_id) & 1;
+            int is_in_spatial_layer = (idc >> (spatial_id + 8)) & 1;
+            if ((idc == 0 || (is_in_temporal_layer && is_in_spatial_layer)) &&
+                !av1_obu_read_bits(bits, info->buffer_removal_time_length, &value)) {
+                return -1;
+            }
+        }
+    }
+
+    // refresh_frame_flags (8)
+    if (!av1_obu_read_bits(bits, 8, &value)) {
+        return -1;
+    }
+    return value != 0;
+}
+
+int
+av1_obu_is_reference_frame(const uint8_t *data, size_t size, const Av1SequenceInfo *info)
+{
+    int num_frames = 0;
+    while (size > 0) {
+        int obu_type = (data[0] >> 3) & 0x0f;
+        int has_extension = (data[0] >> 2) & 1;
+        int has_size = (data[0] >> 1) & 1;
+        size_t header_size = 1 + (size_t)has_extension;
+        if (header_size > size) {
+            return -1;
+        }
+
+        // obu_extension_header(): temporal_id (3 bits), spatial_id (2)
+        int temporal_id = has_extension ? data[1] >> 5 : 0;
+        int spatial_id = has_extension ? (data[1] >> 3) & 3 : 0;
+
+        uint64_t obu_size = size - header_size;
+        if (has_size) {
+            size_t num_bytes =
+                av1_obu_read_leb128(data + header_size, size - header_size, &obu_size);
+            if (num_bytes == 0) {
+                return -1;
+            }
+            header_size += num_bytes;
+        }
+        if (obu_size > size - header_size) {
+            return -1;
+        }
+
+        if (obu_type == AV1_OBU_FRAME_HEADER || obu_type == AV1_OBU_FRAME) {
+            Av1BitReader bits;
+            bits.data = data + header_size;
+            bits.size = (size_t)obu_size;
+            bits.bit_position = 0;
+            int refreshes_frames =
+                av1_obu_refreshes_frames(&bits, info, temporal_id, spatial_id);
+            if (refreshes_frames != 0) {
+                return refreshes_frames;
+            }
+            num_frames++;
+        }
+
+        data += header_size + (size_t)obu_size;
+        size -= header_size + (size_t)obu_size;
+    }
+    return num_frames > 0 ? 0 : -1;
+}
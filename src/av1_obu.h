@@ -0,0 +1,52 @@
+#ifndef AV1_OBU_H
+#define AV1_OBU_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// how many bytes from the start of a frame are enough to find its frame header
+#define AV1_OBU_PEEK_SIZE 256
+
+// the most operating points a sequence header can describe
+#define AV1_OBU_MAX_OPERATING_POINTS 32
+
+// the parts of a sequence header that are needed to read a frame header
+typedef struct Av1SequenceInfo {
+    int reduced_still_picture_header;
+    int decoder_model_info_present;
+    int equal_picture_interval;
+    int buffer_removal_time_length;
+    int frame_presentation_time_length;
+    int num_operating_points;
+    uint32_t operating_point_idc[AV1_OBU_MAX_OPERATING_POINTS];
+    int decoder_model_present_for_op[AV1_OBU_MAX_OPERATING_POINTS];
+    int frame_id_length;  // 0 when frame ids aren't present
+    int force_screen_content_tools;
+    int force_integer_mv;
+    int order_hint_bits;
+} Av1SequenceInfo;
+
+// check the frame header in the AV1 temporal unit that data starts with. returns 1 for a
+// shown keyframe, 0 for any other frame, and -1 if no frame header was found in the
+// first size bytes
+int
+av1_obu_is_key_frame(const uint8_t *data, size_t size);
+
+// read the frame rate from the timing info of the sequence header in the first size
+// bytes of data. returns 0 on success, or -1 if there's no sequence header or it
+// doesn't give a frame rate
+int
+av1_obu_get_frame_rate(const uint8_t *data, size_t size, double *frame_rate);
+
+// read the sequence header in the first size bytes of data. returns 0 on success, or -1
+// if there's no sequence header or it's cut short
+int
+av1_obu_get_sequence_info(const uint8_t *data, size_t size, Av1SequenceInfo *info);
+
+// check whether any frame in the AV1 temporal unit of size bytes is kept for other frames
+// to be predicted from. returns 1 if one is, 0 if none are, and -1 if the frame headers
+// can't be read
+int
+av1_obu_is_reference_frame(const uint8_t *data, size_t size, const Av1SequenceInfo *info);
+
+#endif
@@ -0,0 +1,126 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "chapter_cache.h"
+
+int
+chapter_cache_init(ChapterCache **cache, size_t capacity)
+{
+    if ((*cache = (ChapterCache *)malloc(sizeof(ChapterCache))) == NULL) {
+        return -1;
+    }
+    if (((*cache)->entries =
+             (ChapterCacheEntry *)malloc(capacity * sizeof(ChapterCacheEntry))) == NULL) {
+        free(*cache);
+        return -1;
+    }
+    (*cache)->capacity = capacity;
+    (*cache)->num_entries = 0;
+    (*cache)->use_count = 0;
+    return 0;
+}
+
+void
+chapter_cache_free_frame(Sav1VideoFrame *frame)
+{
+    free(frame->data);
+    free(frame);
+}
+
+void
+chapter_cache_destroy(ChapterCache *cache)
+{
+    for (size_t i = 0; i < cache->num_entries; i++) {
+        chapter_cache_free_frame(cache->entries[i].frame);
+    }
+    free(cache->entries);
+    free(cache);
+}
+
+Sav1VideoFrame *
+chapter_cache_clone_frame(const Sav1VideoFrame *src_frame)
+{
+    Sav1VideoFrame *frame;
+    if ((frame = (Sav1VideoFrame *)malloc(sizeof(Sav1VideoFrame))) == NULL) {
+        return NULL;
+    }
+    memcpy(frame, src_frame, sizeof(Sav1VideoFrame));
+    if ((frame->data = (uint8_t *)malloc(src_frame->size)) == NULL) {
+        free(frame);
+        return NULL;
+    }
+    memcpy(frame->data, src_frame->data, src_frame->size);
+
+    // the user's custom data belongs to the original frame
+    frame->custom_data = NULL;
+    frame->sentinel = 0;
+    frame->sav1_has_ownership = 1;
+    frame->shared_frame = NULL;
+    return frame;
+}
+
+ChapterCacheEntry *
+chapter_cache_find(ChapterCache *cache, size_t chapter_index)
+{
+    for (size_t i = 0; i < cache->num_entries; i++) {
+        if (cache->entries[i].chapter_index == chapter_index) {
+            return &(cache->entries[i]);
+        }
+    }
+    return NULL;
+}
+
+int
+chapter_cache_has(ChapterCache *cache, size_t chapter_index)
+{
+    return chapter_cache_find(cache, chapter_index) != NULL;
+}
+
+int
+chapter_cache_put(ChapterCache *cache, size_t chapter_index, const Sav1VideoFrame *frame)
+{
+    if (cache->capacity == 0) {
+        return 0;
+    }
+    Sav1VideoFrame *copy = chapter_cache_clone_frame(frame);
+    if (copy == NULL) {
+        return -1;
+    }
+
+    // reuse the chapter's own slot, then an empty one, then the least recently used
+    ChapterCacheEntry *entry = chapter_cache_find(cache, chapter_index);
+    if (entry == NULL && cache->num_entries < cache->capacity) {
+        entry = &(cache->entries[cache->num_entries++]);
+        entry->frame = NULL;
+    }
+    else if (entry == NULL) {
+        entry = &(cache->entries[0]);
+        for (size_t i = 1; i < cache->num_entries; i++) {
+            if (cache->entries[i].last_used < entry->last_used) {
+                entry = &(cache->entries[i]);
+            }
+        }
+    }
+    if (entry->frame != NULL) {
+        chapter_cache_free_frame(entry->frame);
+    }
+    entry->chapter_index = chapter_index;
+    entry->frame = copy;
+    entry->last_used = ++cache->use_count;
+    return 0;
+}
+
+int
+chapter_cache_copy(ChapterCache *cache, size_t chapter_index, Sav1VideoFrame **frame)
+{
+    *frame = NULL;
+    ChapterCacheEntry *entry = chapter_cache_find(cache, chapter_index);
+    if (entry == NULL) {
+        return 0;
+    }
+    entry->last_used = ++cache->use_count;
+    if ((*frame = chapter_cache_clone_frame(entry->frame)) == NULL) {
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,44 @@
+#ifndef CHAPTER_CACHE_H
+#define CHAPTER_CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "sav1_video_frame.h"
+
+// a copy of the first frame shown in a chapter
+typedef struct ChapterCacheEntry {
+    size_t chapter_index;
+    Sav1VideoFrame *frame;
+    uint64_t last_used;
+} ChapterCacheEntry;
+
+// keeps the entry frames of the most recently used chapters
+typedef struct ChapterCache {
+    ChapterCacheEntry *entries;
+    size_t capacity;
+    size_t num_entries;
+    uint64_t use_count;
+} ChapterCache;
+
+int
+chapter_cache_init(ChapterCache **cache, size_t capacity);
+
+void
+chapter_cache_destroy(ChapterCache *cache);
+
+// whether the entry frame of a chapter is cached
+int
+chapter_cache_has(ChapterCache *cache, size_t chapter_index);
+
+// store a copy of a chapter's entry frame, replacing the least recently used one if the
+// cache is full. returns < 0 if memory couldn't be allocated
+int
+chapter_cache_put(ChapterCache *cache, size_t chapter_index, const Sav1VideoFrame *frame);
+
+// make a new copy of a chapter's cached entry frame, setting frame to NULL if it isn't
+// cached. returns < 0 if memory couldn't be allocated
+int
+chapter_cache_copy(ChapterCache *cache, size_t chapter_index, Sav1VideoFrame **frame);
+
+#endif
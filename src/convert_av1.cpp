@@ -527,9 +527,11 @@ convert_av1_start(void *context)
         output_frame->pixel_format = convert_context->desired_pixel_format;
         output_frame->color_depth = 8;
         output_frame->timecode = dav1d_pic->m.timestamp;
-        output_frame->sentinel = dav1d_pic->m.user_data.data == NULL ? 0 : 1;
+        uintptr_t flags = (uintptr_t)dav1d_pic->m.user_data.data;
+        output_frame->sentinel = flags & DECODE_AV1_FLAG_SENTINEL ? 1 : 0;
         output_frame->custom_data = NULL;
         output_frame->sav1_has_ownership = 1;
+        output_frame->shared_frame = NULL;
 
         // convert the color space
         convert_dav1d_picture(convert_context->ctx, dav1d_pic, output_frame);
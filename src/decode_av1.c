@@ -1,16 +1,22 @@
 #include <stdlib.h>
 #include <stdio.h>
 
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
 #include "webm_frame.h"
 #include "decode_av1.h"
 #include "sav1_internal.h"
 
 void
-fake_dealloc(const uint8_t *data, void *cookie)
+decode_av1_release_frame(const uint8_t *data, void *cookie)
 {
-    if (data && cookie) {
-        // use the arguments to avoid compiler warning
-    }
+    // dav1d is done with the frame's data, so it can be reused
+    (void)data;
+    webm_frame_destroy((WebMFrame *)cookie);
 }
 
 void
@@ -32,24 +38,275 @@ decode_av1_init(DecodeAv1Context **context, Sav1InternalContext *ctx,
     }
     thread_mutex_init((*context)->running);
 
+    if (((*context)->profile_lock = (thread_mutex_t *)malloc(sizeof(thread_mutex_t))) ==
+        NULL) {
+        thread_mutex_term((*context)->running);
+        free((*context)->running);
+        free(*context);
+        sav1_set_error(ctx, "malloc() failed in decode_av1_init()");
+        sav1_set_critical_error_flag(ctx);
+        return;
+    }
+    thread_mutex_init((*context)->profile_lock);
+    thread_timer_init(&((*context)->idle_timer));
+    (*context)->profile = ctx->settings->decode_profile;
+    thread_atomic_int_store(&((*context)->profile_changed), 0);
+    thread_atomic_int_store(&((*context)->skip_non_reference), 0);
+    thread_atomic_int_store(&((*context)->skip_to_key_frame), 0);
+    (*context)->skip_timecode = 0;
+    (*context)->last_key_frame_timecode = 0;
+    (*context)->has_sequence_info = 0;
+
     (*context)->ctx = ctx;
     (*context)->input_queue = input_queue;
     (*context)->output_queue = output_queue;
+    (*context)->dav1d_context = NULL;
+    (*context)->num_threads = 0;
+    (*context)->budget = NULL;
 
-    Dav1dSettings settings;
-    dav1d_default_settings(&settings);
-    dav1d_open(&(*context)->dav1d_context, &settings);
+    // share the decoder threads with the other contexts on the same budget
+    Sav1DecodeBudget *budget = ctx->settings->decode_budget;
+    if (budget != NULL) {
+        (*context)->budget = (DecodeBudget *)budget->internal_state;
+        thread_atomic_int_store(&((*context)->budget_threads), 0);
+        if (decode_budget_attach((*context)->budget, *context)) {
+            sav1_set_error(ctx, "malloc() failed in decode_av1_init()");
+            sav1_set_critical_error_flag(ctx);
+        }
+    }
 }
 
 void
 decode_av1_destroy(DecodeAv1Context *context)
 {
     dav1d_close(&context->dav1d_context);
+    if (context->budget != NULL) {
+        decode_budget_detach(context->budget, context);
+        decode_budget_release(context->budget);
+    }
     thread_mutex_term(context->running);
     free(context->running);
+    thread_mutex_term(context->profile_lock);
+    free(context->profile_lock);
+    thread_timer_term(&(context->idle_timer));
     free(context);
 }
 
+int
+decode_av1_get_num_cores(void)
+{
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return (int)info.dwNumberOfProcessors;
+#else
+    long num_cores = sysconf(_SC_NPROCESSORS_ONLN);
+    return num_cores < 1 ? 1 : (int)num_cores;
+#endif
+}
+
+int
+decode_av1_open(DecodeAv1Context *context, Dav1dSequenceHeader *seq_hdr)
+{
+    Sav1Settings *settings = context->ctx->settings;
+    int num_cores = decode_av1_get_num_cores();
+    int size = seq_hdr->max_width * seq_hdr->max_height;
+
+    Dav1dSettings dav1d_settings;
+    dav1d_default_settings(&dav1d_settings);
+
+    // 0 leaves the frame delay up to dav1d, which grows it with the number of threads
+    if (settings->decode_preset == SAV1_DECODE_PRESET_LOW_LATENCY) {
+        dav1d_settings.n_threads = num_cores < DECODE_AV1_LOW_LATENCY_THREADS
+                                       ? num_cores
+                                       : DECODE_AV1_LOW_LATENCY_THREADS;
+        dav1d_settings.max_frame_delay = 1;
+    }
+    else if (settings->decode_preset == SAV1_DECODE_PRESET_THROUGHPUT ||
+             size > DECODE_AV1_MEDIUM_VIDEO_SIZE) {
+        dav1d_settings.n_threads = num_cores;
+        dav1d_settings.max_frame_delay = 0;
+    }
+    else if (size > DECODE_AV1_SMALL_VIDEO_SIZE) {
+        dav1d_settings.n_threads = num_cores < DECODE_AV1_MEDIUM_VIDEO_THREADS
+                                       ? num_cores
+                                       : DECODE_AV1_MEDIUM_VIDEO_THREADS;
+        dav1d_settings.max_frame_delay = 0;
+    }
+    else {
+        // frame threading only adds latency at sizes that decode quickly anyway
+        dav1d_settings.n_threads = num_cores < DECODE_AV1_SMALL_VIDEO_THREADS
+                                       ? num_cores
+                                       : DECODE_AV1_SMALL_VIDEO_THREADS;
+        dav1d_settings.max_frame_delay = 1;
+    }
+
+    // explicit settings take priority over the preset, and a budget over both
+    if (settings->decode_threads > 0) {
+        dav1d_settings.n_threads = settings->decode_threads;
+    }
+    if (context->budget != NULL) {
+        dav1d_settings.n_threads = decode_budget_set_size(context->budget, context, size);
+    }
+    if (settings->decode_frame_delay > 0) {
+        dav1d_settings.max_frame_delay = settings->decode_frame_delay;
+    }
+
+    thread_mutex_lock(context->profile_lock);
+    dav1d_settings.apply_grain = context->profile.apply_grain;
+    dav1d_settings.decode_frame_type =
+        (enum Dav1dDecodeFrameType)context->profile.frame_type;
+    dav1d_settings.frame_size_limit = context->profile.frame_size_limit;
+    dav1d_settings.strict_std_compliance = context->profile.strict_std_compliance;
+    thread_atomic_int_store(&(context->profile_changed), 0);
+    thread_mutex_unlock(context->profile_lock);
+
+    if (dav1d_open(&context->dav1d_context, &dav1d_settings)) {
+        context->dav1d_context = NULL;
+        sav1_set_error(context->ctx, "dav1d_open() failed in decode_av1_open()");
+        sav1_set_critical_error_flag(context->ctx);
+        return -1;
+    }
+    context->num_threads = dav1d_settings.n_threads;
+    return 0;
+}
+
+void
+decode_av1_set_profile(DecodeAv1Context *context, Sav1DecodeProfile *profile)
+{
+    thread_mutex_lock(context->profile_lock);
+    context->profile = *profile;
+    thread_atomic_int_store(&(context->profile_changed), 1);
+    thread_mutex_unlock(context->profile_lock);
+}
+
+void
+decode_av1_skip_non_reference_frames(DecodeAv1Context *context, int do_skip)
+{
+    thread_atomic_int_store(&(context->skip_non_reference), do_skip);
+}
+
+void
+decode_av1_skip_to_key_frame(DecodeAv1Context *context, int do_skip, uint64_t timecode)
+{
+    // the decode thread reads the timecode as soon as it sees skip_to_key_frame
+    context->skip_timecode = timecode;
+    thread_atomic_int_store(&(context->skip_to_key_frame), do_skip);
+}
+
+int
+decode_av1_skip_frame(DecodeAv1Context *context, WebMFrame *frame)
+{
+    // frame headers can only be read with the sequence header they belong to
+    if (frame->is_key_frame &&
+        av1_obu_get_sequence_info(frame->data, frame->size, &(context->sequence_info)) ==
+            0) {
+        context->has_sequence_info = 1;
+    }
+
+    // when playback is too far behind, nothing before the next keyframe will be on time,
+    // unless one after where playback fell behind has already been decoded
+    if (thread_atomic_int_load(&(context->skip_to_key_frame)) &&
+        context->last_key_frame_timecode <= context->skip_timecode &&
+        !frame->is_key_frame) {
+        return 1;
+    }
+    if (frame->is_key_frame) {
+        thread_atomic_int_store(&(context->skip_to_key_frame), 0);
+        context->last_key_frame_timecode = frame->timecode;
+    }
+
+    // otherwise leave out the frames that no others depend on
+    return thread_atomic_int_load(&(context->skip_non_reference)) &&
+           context->has_sequence_info &&
+           av1_obu_is_reference_frame(frame->data, frame->size,
+                                      &(context->sequence_info)) == 0;
+}
+
+int
+decode_av1_needs_reopen(DecodeAv1Context *context)
+{
+    if (thread_atomic_int_load(&(context->profile_changed))) {
+        return 1;
+    }
+    return context->budget != NULL &&
+           thread_atomic_int_load(&(context->budget_threads)) != context->num_threads;
+}
+
+void
+decode_av1_release_flags(const uint8_t *data, void *cookie)
+{
+    // the flags are stored in the pointer itself, so there's nothing to free
+    (void)data;
+    (void)cookie;
+}
+
+void
+decode_av1_output_picture(DecodeAv1Context *context, Dav1dPicture *picture)
+{
+    uintptr_t flags = (uintptr_t)picture->m.user_data.data;
+    if (flags & DECODE_AV1_FLAG_DISCARD) {
+        // throw this dav1dPicture away
+        dav1d_picture_unref(picture);
+        free(picture);
+        return;
+    }
+
+    // the first picture kept after seeking is where playback starts again
+    if (context->sentinel_pending) {
+        flags |= DECODE_AV1_FLAG_SENTINEL;
+        context->sentinel_pending = 0;
+    }
+    picture->m.user_data.data = (const uint8_t *)flags;
+
+    // push to the output queue
+    sav1_thread_queue_push(context->output_queue, picture);
+}
+
+// whether nothing more is coming in for now, which is at the end of the file or while a
+// growing file is waited on, so that dav1d has to let out what it's holding back
+int
+decode_av1_input_has_stopped(DecodeAv1Context *context)
+{
+    ParseContext *parse_context = context->ctx->thread_manager->parse_context;
+    return parse_get_status(parse_context) != PARSE_STATUS_OK ||
+           context->ctx->settings->on_file_end == SAV1_FILE_END_FOLLOW;
+}
+
+int
+decode_av1_get_pictures(DecodeAv1Context *context, Dav1dPicture **picture, int do_drain)
+{
+    while (1) {
+        // attempt to get picture from dav1d
+        int status = dav1d_get_picture(context->dav1d_context, *picture);
+
+        // dav1d only lets out the pictures that its frame threads are still working on
+        // when asked a second time without any data sent in between
+        if (status == DAV1D_ERR(EAGAIN) && do_drain) {
+            status = dav1d_get_picture(context->dav1d_context, *picture);
+        }
+        if (status) {
+            if (do_drain) {
+                context->has_held_pictures = 0;
+            }
+            return 0;
+        }
+        decode_av1_output_picture(context, *picture);
+
+        // allocate a new dav1d picture
+        if ((*picture = (Dav1dPicture *)calloc(1, sizeof(Dav1dPicture))) == NULL) {
+            sav1_set_error(context->ctx, "malloc() failed in decode_av1_start()");
+            sav1_set_critical_error_flag(context->ctx);
+            return -1;
+        }
+
+        // after sending data, only take what's ready so the frame threads keep going
+        if (!do_drain) {
+            return 0;
+        }
+    }
+}
+
 int
 decode_av1_start(void *context)
 {
@@ -66,6 +323,8 @@ decode_av1_start(void *context)
     */
     int seek_state = 0;
     int seek_feed_state = 0;
+    decode_context->sentinel_pending = 0;
+    decode_context->has_held_pictures = 0;
     Dav1dSequenceHeader seq_hdr;
     Dav1dData data;
     Dav1dPicture *picture;
@@ -76,6 +335,22 @@ decode_av1_start(void *context)
     }
 
     while (thread_atomic_int_load(&(decode_context->do_decode))) {
+        // draining waits on every frame thread, so the pictures dav1d is holding back
+        // are only let out once the input has stopped, and not just because the parser
+        // is slower than the decoder
+        if (decode_context->has_held_pictures &&
+            sav1_thread_queue_get_size(decode_context->input_queue) == 0) {
+            if (!decode_av1_input_has_stopped(decode_context)) {
+                thread_timer_wait(&(decode_context->idle_timer),
+                                  DECODE_AV1_IDLE_POLL_INTERVAL);
+                continue;
+            }
+            if (decode_av1_get_pictures(decode_context, &picture, 1)) {
+                thread_mutex_unlock(decode_context->running);
+                return -1;
+            }
+        }
+
         // pull a webm frame from the input queue
         WebMFrame *input_frame =
             (WebMFrame *)sav1_thread_queue_pop(decode_context->input_queue);
@@ -84,10 +359,27 @@ decode_av1_start(void *context)
             break;
         }
 
+        if (decode_context->dav1d_context == NULL) {
+            // the decoder is set up for the video's size, so wait for its sequence header
+            if (dav1d_parse_sequence_header(&seq_hdr, input_frame->data,
+                                            input_frame->size)) {
+                webm_frame_destroy(input_frame);
+                continue;
+            }
+            if (decode_av1_open(decode_context, &seq_hdr)) {
+                webm_frame_destroy(input_frame);
+                thread_mutex_unlock(decode_context->running);
+                free(picture);
+                return -1;
+            }
+        }
+
         if (seek_state || input_frame->do_discard || input_frame->sentinel) {
             if (seek_state == 0) {
                 // seeking has begun
                 dav1d_flush(decode_context->dav1d_context);
+                decode_context->sentinel_pending = 1;
+                decode_context->last_key_frame_timecode = 0;
                 seek_state = 1;
             }
             if (thread_atomic_int_load(&(decode_context->ctx->seek_mode)) ==
@@ -121,75 +413,87 @@ decode_av1_start(void *context)
                 webm_frame_destroy(input_frame);
                 continue;
             }
+            if (!input_frame->do_discard) {
+                // reset seeking finite state machine
+                seek_state = 0;
+                seek_feed_state = 0;
+            }
+        }
+
+        // catching up with timed playback skips frames that would only be late
+        if (!input_frame->do_discard &&
+            decode_av1_skip_frame(decode_context, input_frame)) {
+            webm_frame_destroy(input_frame);
+            continue;
+        }
+
+        // take up a new share of the budget or a new profile at a keyframe, since
+        // nothing from before it is needed to decode what follows
+        if (input_frame->is_key_frame && decode_av1_needs_reopen(decode_context) &&
+            !dav1d_parse_sequence_header(&seq_hdr, input_frame->data,
+                                         input_frame->size)) {
+            if (decode_av1_get_pictures(decode_context, &picture, 1)) {
+                webm_frame_destroy(input_frame);
+                thread_mutex_unlock(decode_context->running);
+                return -1;
+            }
+            dav1d_close(&decode_context->dav1d_context);
+            if (decode_av1_open(decode_context, &seq_hdr)) {
+                webm_frame_destroy(input_frame);
+                thread_mutex_unlock(decode_context->running);
+                free(picture);
+                return -1;
+            }
+        }
+
+        // dav1d can let go of the frame at any point once it has the data, so keep
+        // what's needed afterwards
+        uint64_t timecode = input_frame->timecode;
+        uintptr_t flags = DECODE_AV1_FLAGS_SET;
+        if (input_frame->do_discard) {
+            flags |= DECODE_AV1_FLAG_DISCARD;
         }
 
-        // wrap the OBUs in a Dav1dData struct
+        // wrap the OBUs in a Dav1dData struct that hands the frame back when released
         status = dav1d_data_wrap(&data, input_frame->data, input_frame->size,
-                                 fake_dealloc, NULL);
+                                 decode_av1_release_frame, input_frame);
         if (status) {
             sav1_set_error(decode_context->ctx,
                            "dav1d_data_wrap() failed in decode_av1_start");
+            webm_frame_destroy(input_frame);
+            continue;
+        }
+
+        // dav1d copies the timecode and flags into whichever picture the data becomes
+        data.m.timestamp = timecode;
+        status = dav1d_data_wrap_user_data(&data, (const uint8_t *)flags,
+                                           decode_av1_release_flags, NULL);
+        if (status) {
+            dav1d_data_unref(&data);
+            sav1_set_error(decode_context->ctx,
+                           "dav1d_data_wrap_user_data() failed in decode_av1_start");
+            continue;
         }
 
         do {
             // send the OBUs to dav1d
             status = dav1d_send_data(decode_context->dav1d_context, &data);
             if (status && status != DAV1D_ERR(EAGAIN)) {
-                webm_frame_destroy(input_frame);
-                sav1_set_error(
-                    decode_context->ctx,
-                    "dav1d_send_data() failed in decode_av1_start, retrying...");
-                continue;
+                // skip this frame
+                dav1d_data_unref(&data);
+                sav1_set_error(decode_context->ctx,
+                               "dav1d_send_data() failed in decode_av1_start");
+                break;
             }
 
-            do {
-                // attempt to get picture from dav1d
-                status = dav1d_get_picture(decode_context->dav1d_context, picture);
-
-                // try one more time if dav1d tells us to (we usually have to)
-                if (status == DAV1D_ERR(EAGAIN)) {
-                    status = dav1d_get_picture(decode_context->dav1d_context, picture);
-                }
-
-                // see if we have a picture to output
-                if (status == 0) {
-                    // save the timecode into the dav1dPicture
-                    picture->m.timestamp = input_frame->timecode;
-
-                    if (input_frame->do_discard) {
-                        // throw this dav1dPicture away
-                        dav1d_picture_unref(picture);
-                        free(picture);
-                    }
-                    else {
-                        if (seek_feed_state == 2) {
-                            picture->m.user_data.data = (const uint8_t *)1;
-                            // reset seeking finite state machine
-                            seek_state = 0;
-                            seek_feed_state = 0;
-                        }
-                        else {
-                            picture->m.user_data.data = NULL;
-                        }
-
-                        // push to the output queue
-                        sav1_thread_queue_push(decode_context->output_queue, picture);
-                    }
-
-                    // allocate a new dav1d picture
-                    if ((picture = (Dav1dPicture *)calloc(1, sizeof(Dav1dPicture))) ==
-                        NULL) {
-                        sav1_set_error(decode_context->ctx,
-                                       "malloc() failed in decode_av1_start()");
-                        sav1_set_critical_error_flag(decode_context->ctx);
-                        thread_mutex_unlock(decode_context->running);
-                        return -1;
-                    }
-                }
-            } while (status == 0);
+            // see if we have a picture to output
+            if (decode_av1_get_pictures(decode_context, &picture, 0)) {
+                dav1d_data_unref(&data);
+                thread_mutex_unlock(decode_context->running);
+                return -1;
+            }
         } while (data.sz > 0);
-
-        webm_frame_destroy(input_frame);
+        decode_context->has_held_pictures = 1;
     }
     thread_mutex_unlock(decode_context->running);
 
@@ -3,7 +3,30 @@
 
 #include <dav1d/dav1d.h>
 
+#include "sav1_settings.h"
 #include "thread_queue.h"
+#include "av1_obu.h"
+#include "decode_budget.h"
+
+// flags carried through dav1d with each packet in Dav1dData.m.user_data, so that every
+// picture keeps the flags of its own packet however long dav1d holds it back
+#define DECODE_AV1_FLAGS_SET 1  // keeps the user data from ever being NULL
+#define DECODE_AV1_FLAG_DISCARD 2
+#define DECODE_AV1_FLAG_SENTINEL 4
+
+// the largest videos, in pixels, that the automatic decode preset treats as small or
+// medium, with the most threads it gives each
+#define DECODE_AV1_SMALL_VIDEO_SIZE (640 * 480)
+#define DECODE_AV1_SMALL_VIDEO_THREADS 2
+#define DECODE_AV1_MEDIUM_VIDEO_SIZE (1920 * 1080)
+#define DECODE_AV1_MEDIUM_VIDEO_THREADS 8
+
+// the most threads the low latency preset spreads each frame over
+#define DECODE_AV1_LOW_LATENCY_THREADS 4
+
+// how long to wait before checking again whether the input has ended while dav1d still
+// holds back pictures, in nanoseconds
+#define DECODE_AV1_IDLE_POLL_INTERVAL (2 * 1000000ULL)
 
 typedef struct Sav1InternalContext Sav1InternalContext;
 
@@ -11,9 +34,28 @@ typedef struct DecodeAv1Context {
     Sav1ThreadQueue *input_queue;
     Sav1ThreadQueue *output_queue;
     thread_atomic_int_t do_decode;
-    Dav1dContext *dav1d_context;
+    Dav1dContext *dav1d_context;  // opened once the first sequence header arrives
     Sav1InternalContext *ctx;
     thread_mutex_t *running;
+    int sentinel_pending;  // whether the next picture let out is the first after a seek
+    int has_held_pictures;  // whether data was sent since dav1d was last drained
+    thread_timer_t idle_timer;
+    int num_threads;       // how many threads dav1d was opened with
+    DecodeBudget *budget;  // where the number of threads comes from, or NULL
+    int budget_size;       // the video's size in pixels, under the budget's lock
+    int budget_is_visible;
+    int budget_is_playing;
+    uint64_t budget_weight;
+    thread_atomic_int_t budget_threads;  // the latest share, applied at the next keyframe
+    thread_mutex_t *profile_lock;
+    Sav1DecodeProfile profile;            // under the profile lock
+    thread_atomic_int_t profile_changed;  // whether to apply the profile at a keyframe
+    thread_atomic_int_t skip_non_reference;  // whether playback is behind real time
+    thread_atomic_int_t skip_to_key_frame;   // whether it's too far behind to catch up
+    uint64_t skip_timecode;                  // where playback was when it fell behind
+    uint64_t last_key_frame_timecode;        // of the last keyframe let through
+    Av1SequenceInfo sequence_info;           // for finding non-reference frames
+    int has_sequence_info;
 } DecodeAv1Context;
 
 void
@@ -23,6 +65,21 @@ decode_av1_init(DecodeAv1Context **context, Sav1InternalContext *ctx,
 void
 decode_av1_destroy(DecodeAv1Context *context);
 
+int
+decode_av1_get_num_cores(void);
+
+int
+decode_av1_open(DecodeAv1Context *context, Dav1dSequenceHeader *seq_hdr);
+
+void
+decode_av1_set_profile(DecodeAv1Context *context, Sav1DecodeProfile *profile);
+
+void
+decode_av1_skip_non_reference_frames(DecodeAv1Context *context, int do_skip);
+
+void
+decode_av1_skip_to_key_frame(DecodeAv1Context *context, int do_skip, uint64_t timecode);
+
 int
 decode_av1_start(void *context);
 
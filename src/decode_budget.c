@@ -0,0 +1,173 @@
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "decode_budget.h"
+#include "decode_av1.h"
+
+void
+decode_budget_rebalance(DecodeBudget *budget)
+{
+    // weigh every open decoder by how many pixels it decodes, counting the ones nobody
+    // is watching for less
+    uint64_t total_weight = 0;
+    for (size_t i = 0; i < budget->num_members; i++) {
+        DecodeAv1Context *member = budget->members[i];
+        uint64_t weight = (uint64_t)member->budget_size;
+        if (!member->budget_is_playing) {
+            weight /= DECODE_BUDGET_IDLE_DIVISOR;
+        }
+        if (!member->budget_is_visible) {
+            weight /= DECODE_BUDGET_IDLE_DIVISOR;
+        }
+        member->budget_weight = weight ? weight : 1;
+        if (member->budget_size > 0) {
+            total_weight += member->budget_weight;
+        }
+    }
+
+    if (total_weight == 0) {
+        return;
+    }
+
+    // split the threads in proportion to the weights, handing the ones left over from
+    // rounding down to the decoders that were closest to getting another
+    uint64_t num_threads = (uint64_t)budget->num_threads;
+    int num_left_over = budget->num_threads;
+    for (size_t i = 0; i < budget->num_members; i++) {
+        DecodeAv1Context *member = budget->members[i];
+        if (member->budget_size > 0) {
+            num_left_over -= (int)(num_threads * member->budget_weight / total_weight);
+        }
+    }
+    for (size_t i = 0; i < budget->num_members; i++) {
+        DecodeAv1Context *member = budget->members[i];
+        if (member->budget_size == 0) {
+            // decoders that haven't opened yet have nothing to weigh
+            continue;
+        }
+        uint64_t remainder = num_threads * member->budget_weight % total_weight;
+        int rank = 0;
+        for (size_t j = 0; j < budget->num_members; j++) {
+            DecodeAv1Context *other = budget->members[j];
+            uint64_t other_remainder = num_threads * other->budget_weight % total_weight;
+            if (other->budget_size == 0) {
+                continue;
+            }
+            if (other_remainder > remainder || (other_remainder == remainder && j < i)) {
+                rank++;
+            }
+        }
+        int share = (int)(num_threads * member->budget_weight / total_weight);
+        if (rank < num_left_over) {
+            share++;
+        }
+
+        // every decoder needs at least one thread, even if that goes over the budget
+        thread_atomic_int_store(&(member->budget_threads), share ? share : 1);
+    }
+}
+
+int
+decode_budget_init(DecodeBudget **budget, int num_threads)
+{
+    DecodeBudget *decode_budget;
+    if ((decode_budget = (DecodeBudget *)malloc(sizeof(DecodeBudget))) == NULL) {
+        return -1;
+    }
+    if ((decode_budget->lock = (thread_mutex_t *)malloc(sizeof(thread_mutex_t))) ==
+        NULL) {
+        free(decode_budget);
+        return -1;
+    }
+    thread_mutex_init(decode_budget->lock);
+
+    decode_budget->num_threads = num_threads;
+    decode_budget->members = NULL;
+    decode_budget->num_members = 0;
+    decode_budget->members_capacity = 0;
+    thread_atomic_int_store(&(decode_budget->num_refs), 1);
+
+    *budget = decode_budget;
+    return 0;
+}
+
+void
+decode_budget_release(DecodeBudget *budget)
+{
+    // thread_atomic_int_dec returns the previous value
+    if (thread_atomic_int_dec(&(budget->num_refs)) != 1) {
+        return;
+    }
+
+    thread_mutex_term(budget->lock);
+    free(budget->lock);
+    free(budget->members);
+    free(budget);
+}
+
+int
+decode_budget_attach(DecodeBudget *budget, DecodeAv1Context *member)
+{
+    // the decoder holds a reference even if attaching fails, since destroying it
+    // always releases one
+    thread_atomic_int_inc(&(budget->num_refs));
+
+    thread_mutex_lock(budget->lock);
+    if (budget->num_members == budget->members_capacity) {
+        size_t capacity = budget->members_capacity ? budget->members_capacity * 2 : 4;
+        DecodeAv1Context **members = (DecodeAv1Context **)realloc(
+            budget->members, capacity * sizeof(DecodeAv1Context *));
+        if (members == NULL) {
+            thread_mutex_unlock(budget->lock);
+            return -1;
+        }
+        budget->members = members;
+        budget->members_capacity = capacity;
+    }
+    budget->members[budget->num_members++] = member;
+
+    // it only starts counting once it knows the size of its video
+    member->budget_size = 0;
+    member->budget_is_visible = 1;
+    member->budget_is_playing = 1;
+    thread_mutex_unlock(budget->lock);
+
+    return 0;
+}
+
+void
+decode_budget_detach(DecodeBudget *budget, DecodeAv1Context *member)
+{
+    thread_mutex_lock(budget->lock);
+    for (size_t i = 0; i < budget->num_members; i++) {
+        if (budget->members[i] == member) {
+            budget->members[i] = budget->members[budget->num_members - 1];
+            budget->num_members--;
+            decode_budget_rebalance(budget);
+            break;
+        }
+    }
+    thread_mutex_unlock(budget->lock);
+}
+
+int
+decode_budget_set_size(DecodeBudget *budget, DecodeAv1Context *member, int size)
+{
+    thread_mutex_lock(budget->lock);
+    member->budget_size = size > 0 ? size : 1;
+    decode_budget_rebalance(budget);
+    thread_mutex_unlock(budget->lock);
+
+    return thread_atomic_int_load(&(member->budget_threads));
+}
+
+void
+decode_budget_set_state(DecodeBudget *budget, DecodeAv1Context *member, int is_visible,
+                        int is_playing)
+{
+    thread_mutex_lock(budget->lock);
+    member->budget_is_visible = is_visible;
+    member->budget_is_playing = is_playing;
+    decode_budget_rebalance(budget);
+    thread_mutex_unlock(budget->lock);
+}
@@ -0,0 +1,41 @@
+#ifndef DECODE_BUDGET_H
+#define DECODE_BUDGET_H
+
+#include <stddef.h>
+
+#include "thread.h"
+
+// how much less a decoder weighs while its context is paused, and again while hidden
+#define DECODE_BUDGET_IDLE_DIVISOR 4
+
+typedef struct DecodeAv1Context DecodeAv1Context;
+
+typedef struct DecodeBudget {
+    int num_threads;
+    DecodeAv1Context **members;
+    size_t num_members;
+    size_t members_capacity;
+    thread_mutex_t *lock;          // guards the members and their sizes and states
+    thread_atomic_int_t num_refs;  // the user's handle plus every attached decoder
+} DecodeBudget;
+
+int
+decode_budget_init(DecodeBudget **budget, int num_threads);
+
+void
+decode_budget_release(DecodeBudget *budget);
+
+int
+decode_budget_attach(DecodeBudget *budget, DecodeAv1Context *member);
+
+void
+decode_budget_detach(DecodeBudget *budget, DecodeAv1Context *member);
+
+int
+decode_budget_set_size(DecodeBudget *budget, DecodeAv1Context *member, int size);
+
+void
+decode_budget_set_state(DecodeBudget *budget, DecodeAv1Context *member, int is_visible,
+                        int is_playing);
+
+#endif
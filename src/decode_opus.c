@@ -42,6 +42,7 @@ decode_opus_init(DecodeOpusContext **context, Sav1InternalContext *ctx,
     (*context)->output_queue = output_queue;
     (*context)->frequency = ctx->settings->frequency;
     (*context)->channels = ctx->settings->channels;
+    (*context)->track_switches = 0;
     (*context)->ctx = ctx;
 
     int error;
@@ -81,6 +82,12 @@ decode_opus_start(void *context)
             break;
         }
 
+        // a different audio track doesn't carry on from the last one's state
+        if (input_frame->track_switches != decode_context->track_switches) {
+            opus_decoder_ctl(decode_context->decoder, OPUS_RESET_STATE);
+            decode_context->track_switches = input_frame->track_switches;
+        }
+
         int num_samples =
             opus_decode(decode_context->decoder, input_frame->data, input_frame->size,
                         decode_context->decode_buffer, MAX_DECODE_LEN, 0);
@@ -96,11 +103,13 @@ decode_opus_start(void *context)
         output_frame->codec = SAV1_CODEC_OPUS;
         output_frame->timecode = input_frame->timecode;
         output_frame->sentinel = input_frame->sentinel;
+        output_frame->track_switches = input_frame->track_switches;
         output_frame->duration = (num_samples * 1000) / (decode_context->frequency);
         output_frame->channels = decode_context->channels;
         output_frame->frequency = decode_context->frequency;
         output_frame->custom_data = NULL;
         output_frame->sav1_has_ownership = 1;
+        output_frame->shared_frame = NULL;
         webm_frame_destroy(input_frame);
 
         // copy the decoded audio data
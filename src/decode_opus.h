@@ -17,6 +17,7 @@ typedef struct DecodeOpusContext {
     opus_int16 *decode_buffer;
     Sav1AudioFrequency frequency;
     Sav1AudioChannel channels;
+    int track_switches;
     Sav1InternalContext *ctx;
     thread_mutex_t *running;
 } DecodeOpusContext;
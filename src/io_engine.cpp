@@ -0,0 +1,357 @@
+#ifndef _WIN32
+
+#include <cerrno>
+#include <deque>
+#include <unistd.h>
+#include <vector>
+
+#ifdef SAV1_USE_IO_URING
+#include <liburing.h>
+#endif
+
+extern "C" {
+#include "thread.h"
+}
+
+#include "io_engine.h"
+
+// how many threads the shared engine reads with when io_uring isn't available
+#define IO_ENGINE_NUM_SHARED_THREADS 4
+
+// how many reads the io_uring engine keeps in flight at once
+#define IO_ENGINE_QUEUE_DEPTH 64
+
+void
+io_engine_read(Sav1IORequest *request)
+{
+    while (request->num_done < request->length) {
+        ssize_t num_read =
+            pread(request->fd, request->buffer + request->num_done,
+                  request->length - request->num_done,
+                  (off_t)(request->offset + request->num_done));
+        if (num_read < 0 && errno == EINTR) {
+            continue;
+        }
+        if (num_read <= 0) {
+            break;
+        }
+        request->num_done += (std::size_t)num_read;
+    }
+}
+
+// reads with blocking calls spread over a fixed number of threads
+class Sav1ThreadPoolIOEngine : public Sav1IOEngine {
+   public:
+    explicit Sav1ThreadPoolIOEngine(int num_threads);
+    ~Sav1ThreadPoolIOEngine() override;
+
+    void
+    submit(Sav1IORequest **requests, int num_requests) override;
+
+    // entry point of each worker thread
+    static int
+    worker_thread_start(void *engine);
+
+   private:
+    void
+    run_worker_thread();
+
+    std::deque<Sav1IORequest *> queue;
+    thread_mutex_t lock;
+    thread_signal_t request_signal;
+    thread_atomic_int_t do_run;
+    std::vector<thread_ptr_t> threads;
+};
+
+Sav1ThreadPoolIOEngine::Sav1ThreadPoolIOEngine(int num_threads)
+{
+    thread_mutex_init(&(this->lock));
+    thread_signal_init(&(this->request_signal));
+    thread_atomic_int_store(&(this->do_run), 1);
+    for (int i = 0; i < num_threads; i++) {
+        this->threads.push_back(thread_create(Sav1ThreadPoolIOEngine::worker_thread_start,
+                                              this, THREAD_STACK_SIZE_DEFAULT));
+    }
+}
+
+Sav1ThreadPoolIOEngine::~Sav1ThreadPoolIOEngine()
+{
+    // each worker passes the signal on to the next one as it exits
+    thread_atomic_int_store(&(this->do_run), 0);
+    thread_signal_raise(&(this->request_signal));
+    for (thread_ptr_t thread : this->threads) {
+        thread_join(thread);
+        thread_destroy(thread);
+    }
+    thread_signal_term(&(this->request_signal));
+    thread_mutex_term(&(this->lock));
+}
+
+void
+Sav1ThreadPoolIOEngine::submit(Sav1IORequest **requests, int num_requests)
+{
+    thread_mutex_lock(&(this->lock));
+    for (int i = 0; i < num_requests; i++) {
+        requests[i]->num_done = 0;
+        this->queue.push_back(requests[i]);
+    }
+    thread_mutex_unlock(&(this->lock));
+    thread_signal_raise(&(this->request_signal));
+}
+
+int
+Sav1ThreadPoolIOEngine::worker_thread_start(void *engine)
+{
+    ((Sav1ThreadPoolIOEngine *)engine)->run_worker_thread();
+    return 0;
+}
+
+void
+Sav1ThreadPoolIOEngine::run_worker_thread()
+{
+    while (thread_atomic_int_load(&(this->do_run))) {
+        thread_mutex_lock(&(this->lock));
+        if (this->queue.empty()) {
+            thread_mutex_unlock(&(this->lock));
+            thread_signal_wait(&(this->request_signal), THREAD_SIGNAL_WAIT_INFINITE);
+            continue;
+        }
+        Sav1IORequest *request = this->queue.front();
+        this->queue.pop_front();
+        bool has_more = !this->queue.empty();
+        thread_mutex_unlock(&(this->lock));
+
+        // wake another worker for the rest of the batch
+        if (has_more) {
+            thread_signal_raise(&(this->request_signal));
+        }
+
+        io_engine_read(request);
+        request->on_complete(request, request->num_done);
+    }
+    thread_signal_raise(&(this->request_signal));
+}
+
+#ifdef SAV1_USE_IO_URING
+// submits reads to the kernel in batches and completes them on a single thread
+class Sav1UringIOEngine : public Sav1IOEngine {
+   public:
+    Sav1UringIOEngine();
+    ~Sav1UringIOEngine() override;
+
+    // set up the ring, returning false if the kernel doesn't support io_uring
+    bool
+    start();
+
+    void
+    submit(Sav1IORequest **requests, int num_requests) override;
+
+    // entry point of the completion thread
+    static int
+    completion_thread_start(void *engine);
+
+   private:
+    void
+    run_completion_thread();
+
+    // move as many waiting requests into the ring as fit, with the lock held
+    void
+    fill_ring();
+
+    struct io_uring ring;
+    bool is_ring_open;
+    std::deque<Sav1IORequest *> waiting;
+    int num_in_ring;
+    thread_mutex_t lock;
+    thread_ptr_t completion_thread;
+};
+
+Sav1UringIOEngine::Sav1UringIOEngine()
+    : is_ring_open(false), num_in_ring(0), completion_thread(NULL)
+{
+    thread_mutex_init(&(this->lock));
+}
+
+Sav1UringIOEngine::~Sav1UringIOEngine()
+{
+    if (this->completion_thread != NULL) {
+        // a read with no request tells the completion thread to exit
+        thread_mutex_lock(&(this->lock));
+        struct io_uring_sqe *sqe = io_uring_get_sqe(&(this->ring));
+        io_uring_prep_nop(sqe);
+        io_uring_sqe_set_data(sqe, NULL);
+        io_uring_submit(&(this->ring));
+        thread_mutex_unlock(&(this->lock));
+
+        thread_join(this->completion_thread);
+        thread_destroy(this->completion_thread);
+    }
+    if (this->is_ring_open) {
+        io_uring_queue_exit(&(this->ring));
+    }
+    thread_mutex_term(&(this->lock));
+}
+
+bool
+Sav1UringIOEngine::start()
+{
+    if (io_uring_queue_init(IO_ENGINE_QUEUE_DEPTH, &(this->ring), 0) < 0) {
+        return false;
+    }
+    this->is_ring_open = true;
+    this->completion_thread = thread_create(Sav1UringIOEngine::completion_thread_start,
+                                            this, THREAD_STACK_SIZE_DEFAULT);
+    return true;
+}
+
+void
+Sav1UringIOEngine::submit(Sav1IORequest **requests, int num_requests)
+{
+    thread_mutex_lock(&(this->lock));
+    for (int i = 0; i < num_requests; i++) {
+        requests[i]->num_done = 0;
+        this->waiting.push_back(requests[i]);
+    }
+    this->fill_ring();
+    thread_mutex_unlock(&(this->lock));
+}
+
+void
+Sav1UringIOEngine::fill_ring()
+{
+    // keep one slot free for the exit message, and stay under the queue depth so the
+    // completion queue can't overflow
+    int num_added = 0;
+    while (!this->waiting.empty() && this->num_in_ring < IO_ENGINE_QUEUE_DEPTH - 1) {
+        struct io_uring_sqe *sqe = io_uring_get_sqe(&(this->ring));
+        if (sqe == NULL) {
+            break;
+        }
+        Sav1IORequest *request = this->waiting.front();
+        this->waiting.pop_front();
+        io_uring_prep_read(sqe, request->fd, request->buffer + request->num_done,
+                           (unsigned)(request->length - request->num_done),
+                           request->offset + request->num_done);
+        io_uring_sqe_set_data(sqe, request);
+        this->num_in_ring++;
+        num_added++;
+    }
+
+    // everything added since the last call goes to the kernel in one system call
+    if (num_added > 0) {
+        io_uring_submit(&(this->ring));
+    }
+}
+
+int
+Sav1UringIOEngine::completion_thread_start(void *engine)
+{
+    ((Sav1UringIOEngine *)engine)->run_completion_thread();
+    return 0;
+}
+
+void
+Sav1UringIOEngine::run_completion_thread()
+{
+    while (1) {
+        struct io_uring_cqe *cqe;
+        int status = io_uring_wait_cqe(&(this->ring), &cqe);
+        if (status == -EINTR) {
+            continue;
+        }
+        if (status < 0) {
+            break;
+        }
+        Sav1IORequest *request = (Sav1IORequest *)io_uring_cqe_get_data(cqe);
+        int result = cqe->res;
+        io_uring_cqe_seen(&(this->ring), cqe);
+        if (request == NULL) {
+            break;
+        }
+
+        // short reads are resubmitted for the rest, as pread would be called again
+        thread_mutex_lock(&(this->lock));
+        this->num_in_ring--;
+        bool is_done = true;
+        if (result == -EINTR || result == -EAGAIN) {
+            this->waiting.push_front(request);
+            is_done = false;
+        }
+        else if (result > 0) {
+            request->num_done += (std::size_t)result;
+            if (request->num_done < request->length) {
+                this->waiting.push_front(request);
+                is_done = false;
+            }
+        }
+        this->fill_ring();
+        thread_mutex_unlock(&(this->lock));
+
+        if (is_done) {
+            request->on_complete(request, request->num_done);
+        }
+    }
+}
+#endif
+
+Sav1IOEngine *
+io_engine_create()
+{
+    return new Sav1ThreadPoolIOEngine(1);
+}
+
+thread_mutex_t *
+io_engine_get_shared_lock()
+{
+    // function statics are initialized exactly once, even when called from many threads
+    static struct SharedLock {
+        SharedLock()
+        {
+            thread_mutex_init(&(this->mutex));
+        }
+        thread_mutex_t mutex;
+    } shared_lock;
+    return &(shared_lock.mutex);
+}
+
+static Sav1IOEngine *shared_engine = nullptr;
+static int shared_engine_num_users = 0;
+
+Sav1IOEngine *
+io_engine_acquire_shared()
+{
+    thread_mutex_t *lock = io_engine_get_shared_lock();
+    thread_mutex_lock(lock);
+    if (shared_engine == nullptr) {
+#ifdef SAV1_USE_IO_URING
+        // io_uring can still be disabled or blocked at runtime
+        Sav1UringIOEngine *uring_engine = new Sav1UringIOEngine();
+        if (uring_engine->start()) {
+            shared_engine = uring_engine;
+        }
+        else {
+            delete uring_engine;
+        }
+#endif
+        if (shared_engine == nullptr) {
+            shared_engine = new Sav1ThreadPoolIOEngine(IO_ENGINE_NUM_SHARED_THREADS);
+        }
+    }
+    shared_engine_num_users++;
+    thread_mutex_unlock(lock);
+    return shared_engine;
+}
+
+void
+io_engine_release_shared(Sav1IOEngine *engine)
+{
+    thread_mutex_t *lock = io_engine_get_shared_lock();
+    thread_mutex_lock(lock);
+    if (engine == shared_engine && --shared_engine_num_users == 0) {
+        delete shared_engine;
+        shared_engine = nullptr;
+    }
+    thread_mutex_unlock(lock);
+}
+
+#endif
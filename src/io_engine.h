@@ -0,0 +1,44 @@
+#ifndef IO_ENGINE_H
+#define IO_ENGINE_H
+
+#include <cstddef>
+#include <cstdint>
+
+// one read of `length` bytes at `offset` in the open file `fd`, completed asynchronously
+typedef struct Sav1IORequest {
+    int fd;
+    std::uint64_t offset;
+    std::uint8_t *buffer;
+    std::size_t length;
+    std::size_t num_done;  // bytes read so far, used by the engine
+    // called from an engine thread with the number of bytes read, which is only less
+    // than length at the end of the file or on an error
+    void (*on_complete)(struct Sav1IORequest *request, std::size_t num_read);
+    void *cookie;
+} Sav1IORequest;
+
+// runs reads for any number of readers on a small set of threads
+class Sav1IOEngine {
+   public:
+    virtual ~Sav1IOEngine()
+    {
+    }
+
+    // queue num_requests reads at once, which must stay valid until they complete
+    virtual void
+    submit(Sav1IORequest **requests, int num_requests) = 0;
+};
+
+// create an engine used by a single reader
+Sav1IOEngine *
+io_engine_create();
+
+// get the engine shared by every context in the process, creating it if needed. each
+// call must be matched by io_engine_release_shared once its reads have completed
+Sav1IOEngine *
+io_engine_acquire_shared();
+
+void
+io_engine_release_shared(Sav1IOEngine *engine);
+
+#endif
@@ -1,11 +1,25 @@
+#include <algorithm>
 #include <cassert>
+#include <cstring>
+#include <deque>
+#include <string>
 #include <vector>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#endif
 #include <webm/callback.h>
 #include <webm/status.h>
 #include <webm/webm_parser.h>
-#include <webm/file_reader.h>
+
+#include "parse_demux.h"
+#include "parse_index.h"
+#include "parse_reader.h"
 
 extern "C" {
+#include "av1_obu.h"
 #include "parse.h"
 #include "sav1_settings.h"
 #include "sav1_internal.h"
@@ -13,36 +27,181 @@ extern "C" {
 }
 
 #define PARSE_TRACK_NUMBER_NOT_SPECIFIED 99999
+#define PARSE_NO_AUDIO_TRACK ((std::size_t)-1)
+#define PARSE_NO_VIDEO_TRACK ((std::size_t)-1)
 #define PARSE_SEEK_STATUS 5
+#define PARSE_CUES_DONE_STATUS 6
+#define PARSE_INDEX_STOP_STATUS 7
+
+// size of the shared buffers that frames copied out of the input are carved from
+#define PARSE_FRAME_BUFFER_SIZE (1024 * 1024)
+
+// how long to wait before checking a growing file for more data, in nanoseconds
+#define PARSE_FOLLOW_POLL_INTERVAL (50 * 1000000ULL)
+
+// the longest an Opus packet can last, in milliseconds
+#define PARSE_OPUS_MAX_PACKET_DURATION 120
+
+// how many milliseconds of each audio track that isn't playing to hold on to beyond how
+// far parsing can run ahead of playback, which is the audio queue plus as many frames
+// again held back for it. a switch is only seamless if all of that is covered
+#define PARSE_AUDIO_TRACK_BUFFER_MARGIN 1000
 
 using namespace webm;
 
-typedef struct Sav1CuePoint {
-    std::uint64_t timecode;
-    std::uint64_t cluster_location;
-} Sav1CuePoint;
+// frames parsed for one track that are waiting for room in its queue
+typedef struct Sav1PendingFrames {
+    Sav1ThreadQueue *queue;
+    std::deque<WebMFrame *> frames;
+} Sav1PendingFrames;
+
+// a chapter from the file's first edition, with times in milliseconds
+typedef struct Sav1ParseChapter {
+    std::uint64_t start_time;
+    std::uint64_t end_time;  // 0 if neither listed nor followed by another chapter
+    std::string title;
+} Sav1ParseChapter;
+
+// chapters are found on the parse thread and looked up from the user's thread. once set
+// they never change, so their titles stay valid
+typedef struct Sav1ChapterList {
+    thread_mutex_t lock;
+    bool is_set;
+    std::vector<Sav1ParseChapter> chapters;
+} Sav1ChapterList;
+
+// an Opus track as listed for the user. tracks are only ever added to the end of the
+// deque, so their strings stay valid
+typedef struct Sav1ParseAudioTrack {
+    std::uint64_t track_number;
+    std::string language;
+    std::string name;
+} Sav1ParseAudioTrack;
+
+// audio tracks are found on the parse thread and picked from the user's thread
+typedef struct Sav1AudioTrackList {
+    thread_mutex_t lock;
+    std::deque<Sav1ParseAudioTrack> tracks;
+    std::size_t selected;
+    int track_switches;             // how many times the selected track has changed
+    std::uint64_t switch_timecode;  // how far playback had got at the last switch
+} Sav1AudioTrackList;
+
+// an AV1 track as listed for the user, which like audio tracks are only ever added
+typedef struct Sav1ParseVideoTrack {
+    std::uint64_t track_number;
+    std::uint64_t width;
+    std::uint64_t height;
+    std::string name;
+} Sav1ParseVideoTrack;
+
+typedef struct Sav1VideoTrackList {
+    thread_mutex_t lock;
+    std::deque<Sav1ParseVideoTrack> tracks;
+    std::size_t selected;  // the track the user or the automatic mode asked for
+    std::size_t active;    // the track being parsed, which changes at a keyframe
+    int track_switches;
+} Sav1VideoTrackList;
+
+// what's needed to start decoding an AV1 track partway through
+typedef struct Sav1VideoTrackConfig {
+    std::uint64_t track_number;
+    std::uint64_t codec_delay;
+    std::vector<std::uint8_t> config_obus;  // from the AV1CodecConfigurationRecord
+} Sav1VideoTrackConfig;
+
+// the recent frames of an audio track that isn't playing, so that it can take over
+// without waiting for parsing to catch up
+typedef struct Sav1AudioTrackBuffer {
+    std::uint64_t track_number;
+    std::uint64_t codec_delay;
+    std::deque<WebMFrame *> frames;
+} Sav1AudioTrackBuffer;
+
+void
+parse_store_chapters(Sav1ChapterList *list, const EditionEntry &edition_entry)
+{
+    // only the top level chapters of the first edition with any are used
+    if (list->is_set || edition_entry.atoms.empty()) {
+        return;
+    }
+    std::vector<Sav1ParseChapter> chapters;
+    for (const Element<ChapterAtom> &element : edition_entry.atoms) {
+        const ChapterAtom &atom = element.value();
+        Sav1ParseChapter chapter;
+        chapter.start_time = atom.time_start.value() / 1000000;
+        chapter.end_time = 0;
+        if (atom.time_end.is_present()) {
+            chapter.end_time = atom.time_end.value() / 1000000;
+        }
+        if (!atom.displays.empty()) {
+            chapter.title = atom.displays.front().value().string.value();
+        }
+        chapters.push_back(chapter);
+    }
+    std::stable_sort(chapters.begin(), chapters.end(),
+                     [](const Sav1ParseChapter &a, const Sav1ParseChapter &b) {
+                         return a.start_time < b.start_time;
+                     });
+
+    // a chapter without an end runs until the next one starts
+    for (std::size_t i = 0; i + 1 < chapters.size(); i++) {
+        if (chapters[i].end_time == 0) {
+            chapters[i].end_time = chapters[i + 1].start_time;
+        }
+    }
+
+    thread_mutex_lock(&(list->lock));
+    list->chapters.swap(chapters);
+    list->is_set = true;
+    thread_mutex_unlock(&(list->lock));
+}
 
 class Sav1Callback : public Callback {
    public:
     void
-    init(ParseContext *context, FileReader *reader)
+    init(ParseContext *context, Sav1Reader *reader, WebMFramePool *frame_pool,
+         Sav1ChapterList *chapter_list, Sav1AudioTrackList *audio_track_list,
+         Sav1VideoTrackList *video_track_list)
     {
         this->context = context;
         this->reader = reader;
+        this->frame_pool = frame_pool;
+        this->chapter_list = chapter_list;
+        this->audio_track_list = audio_track_list;
+        this->video_track_list = video_track_list;
         this->av1_track_number = PARSE_TRACK_NUMBER_NOT_SPECIFIED;
+        this->indexed_track_number = PARSE_TRACK_NUMBER_NOT_SPECIFIED;
+        this->switch_track_number = PARSE_TRACK_NUMBER_NOT_SPECIFIED;
+        this->video_track_switches = 0;
+        this->send_config_obus = false;
+        this->last_video_timecode = 0;
+        this->last_key_frame_timecode = 0;
         this->opus_track_number = PARSE_TRACK_NUMBER_NOT_SPECIFIED;
         this->current_track_number = 0;
         this->timecode_scale = 1;
         this->cluster_timecode = 0;
         this->timecode = 0;
         this->av1_codec_delay = 0;
-        this->opus_codec_delay = 0;
-        this->last_cluster_location = 0;
+        this->current_audio_track = PARSE_NO_AUDIO_TRACK;
+        this->active_audio_track = PARSE_NO_AUDIO_TRACK;
+        this->track_switches = 0;
+        this->cluster_location = 0;
         Sav1CuePoint cue = {0, 0};
         this->cue_points.push_back(cue);
         this->all_cue_points = false;
         this->skip_clusters = false;
         this->is_key_frame = false;
+        this->is_key_frame_unknown = false;
+        this->block_location = 0;
+        this->indexing = true;
+        this->indexed_timecode = 0;
+        this->seek_block_location = 0;
+        this->seek_found_key_frame = false;
+        this->pending_video.queue = context->video_output_queue;
+        this->pending_audio.queue = context->audio_output_queue;
+        this->partial_frame = nullptr;
+        this->live_duration = 0;
     }
 
     bool
@@ -81,29 +240,157 @@ class Sav1Callback : public Callback {
         return this->cue_points;
     }
 
+    void
+    set_cue_points(const std::vector<Sav1CuePoint> &file_cue_points)
+    {
+        // the Cues element indexes the whole file so there's nothing left to discover
+        this->cue_points.resize(1);
+        for (const Sav1CuePoint &cue : file_cue_points) {
+            if (cue.timecode > this->cue_points.back().timecode) {
+                this->cue_points.push_back(cue);
+            }
+        }
+        this->all_cue_points = true;
+    }
+
+    // returns the last keyframe at or before timecode if every keyframe up to that point
+    // has been indexed, otherwise nullptr
+    const Sav1KeyFrame *
+    find_key_frame(std::uint64_t timecode) const
+    {
+        if (timecode > this->indexed_timecode) {
+            return nullptr;
+        }
+        auto key_frame = std::upper_bound(
+            this->key_frames.begin(), this->key_frames.end(), timecode,
+            [](std::uint64_t timecode, const Sav1KeyFrame &key_frame) {
+                return timecode < key_frame.timecode;
+            });
+        if (key_frame == this->key_frames.begin()) {
+            return nullptr;
+        }
+        return &*(key_frame - 1);
+    }
+
+    bool
+    is_indexed(std::uint64_t timecode) const
+    {
+        return timecode <= this->indexed_timecode;
+    }
+
+    void
+    begin_seek(std::uint64_t block_location, bool continue_indexing)
+    {
+        // a switch of AV1 track can happen right away, since decoding starts over
+        if (this->switch_track_number != PARSE_TRACK_NUMBER_NOT_SPECIFIED) {
+            this->set_active_video_track(this->switch_track_number);
+        }
+        this->last_video_timecode = 0;
+        this->last_key_frame_timecode = 0;
+
+        // keyframes are only indexed for the first AV1 track, and the blocks of another
+        // track sit elsewhere in the cluster
+        this->seek_block_location =
+            this->av1_track_number == this->indexed_track_number ? block_location : 0;
+        this->seek_found_key_frame = false;
+        this->indexing = continue_indexing;
+
+        // audio held for a switch is only any use around where it was parsed
+        this->clear_audio_track_buffers();
+    }
+
+    void
+    get_index(Sav1ParseIndex *index) const
+    {
+        index->timecode_scale = this->timecode_scale;
+        thread_mutex_lock(this->context->duration_lock);
+        index->duration = this->context->duration;
+        thread_mutex_unlock(this->context->duration_lock);
+        index->av1_track_number = this->av1_track_number;
+        index->opus_track_number = this->opus_track_number;
+        index->av1_codec_delay = this->av1_codec_delay;
+        index->opus_codec_delay = 0;
+        if (this->active_audio_track != PARSE_NO_AUDIO_TRACK) {
+            index->opus_codec_delay =
+                this->audio_tracks[this->active_audio_track].codec_delay;
+        }
+        index->cue_points = this->cue_points;
+        index->all_cue_points = this->all_cue_points;
+        index->key_frames = this->key_frames;
+        index->indexed_timecode = this->indexed_timecode;
+    }
+
+    void
+    set_index(const Sav1ParseIndex &index)
+    {
+        // the headers will be read again anyway, but this makes them available right away
+        this->timecode_scale = index.timecode_scale;
+        thread_mutex_lock(this->context->duration_lock);
+        this->context->duration = index.duration;
+        thread_mutex_unlock(this->context->duration_lock);
+        // the index always describes the first tracks, so it mustn't undo a track that
+        // was already picked, such as by sav1_select_video_track or the automatic mode
+        if (this->av1_track_number == PARSE_TRACK_NUMBER_NOT_SPECIFIED) {
+            this->av1_track_number = index.av1_track_number;
+            this->av1_codec_delay = index.av1_codec_delay;
+        }
+        if (this->opus_track_number == PARSE_TRACK_NUMBER_NOT_SPECIFIED) {
+            this->opus_track_number = index.opus_track_number;
+        }
+        this->cue_points = index.cue_points;
+        if (this->cue_points.empty() || this->cue_points.front().timecode != 0) {
+            Sav1CuePoint cue = {0, 0};
+            this->cue_points.insert(this->cue_points.begin(), cue);
+        }
+        this->all_cue_points = index.all_cue_points;
+        this->key_frames = index.key_frames;
+        this->indexed_timecode = index.indexed_timecode;
+    }
+
     void
     calculate_timecode(std::int16_t relative_time)
     {
         std::uint64_t total_time = this->cluster_timecode + relative_time;
-        if (this->current_track_number == this->av1_track_number) {
-            if (this->av1_codec_delay >= total_time) {
+        std::size_t video_track = this->find_video_track(this->current_track_number);
+        if (video_track != PARSE_NO_VIDEO_TRACK) {
+            std::uint64_t codec_delay = this->video_tracks[video_track].codec_delay;
+            if (codec_delay >= total_time) {
                 total_time = 0;
             }
             else {
-                total_time -= this->av1_codec_delay;
+                total_time -= codec_delay;
             }
         }
-        else if (this->current_track_number == this->opus_track_number) {
-            if (this->opus_codec_delay >= total_time) {
+        else if (this->current_audio_track != PARSE_NO_AUDIO_TRACK) {
+            std::uint64_t codec_delay =
+                this->audio_tracks[this->current_audio_track].codec_delay;
+            if (codec_delay >= total_time) {
                 total_time = 0;
             }
             else {
-                total_time -= this->opus_codec_delay;
+                total_time -= codec_delay;
             }
         }
         this->timecode = (total_time * this->timecode_scale) / 1000000;
     }
 
+    void
+    extend_live_duration()
+    {
+        // a file that's still being written has no duration yet, so it grows with the
+        // latest block
+        if (this->context->on_file_end != SAV1_FILE_END_FOLLOW ||
+            this->timecode <= this->live_duration) {
+            return;
+        }
+        this->live_duration = this->timecode;
+        thread_mutex_lock(this->context->duration_lock);
+        if (this->live_duration > this->context->duration) {
+            this->context->duration = this->live_duration;
+        }
+        thread_mutex_unlock(this->context->duration_lock);
+    }
+
     Status
     OnInfo(const ElementMetadata &, const Info &info) override
     {
@@ -121,9 +408,17 @@ class Sav1Callback : public Callback {
     }
 
     Status
-    OnClusterBegin(const ElementMetadata &, const Cluster &cluster,
+    OnEditionEntry(const ElementMetadata &, const EditionEntry &edition_entry) override
+    {
+        parse_store_chapters(this->chapter_list, edition_entry);
+        return Status(Status::kOkCompleted);
+    }
+
+    Status
+    OnClusterBegin(const ElementMetadata &metadata, const Cluster &cluster,
                    Action *action) override
     {
+        this->cluster_location = metadata.position;
         if (cluster.timecode.is_present()) {
             this->cluster_timecode = cluster.timecode.value();
         }
@@ -132,7 +427,9 @@ class Sav1Callback : public Callback {
         if (!this->all_cue_points && timecode_ms > this->cue_points.back().timecode) {
             Sav1CuePoint cue;
             cue.timecode = timecode_ms;
-            cue.cluster_location = this->last_cluster_location;
+            // the cluster's own position works even when its size isn't known, as in
+            // files written by live recorders
+            cue.cluster_location = metadata.position;
             this->cue_points.push_back(cue);
         }
 
@@ -141,6 +438,8 @@ class Sav1Callback : public Callback {
                 this->skip_clusters = false;
                 return Status(PARSE_SEEK_STATUS);
             }
+            // the blocks in skipped clusters never get indexed
+            this->indexing = false;
             *action = Action::kSkip;
         }
         else {
@@ -149,57 +448,101 @@ class Sav1Callback : public Callback {
         return Status(Status::kOkCompleted);
     }
 
-    Status
-    OnClusterEnd(const ElementMetadata &, const Cluster &)
-    {
-        this->last_cluster_location = this->reader->Position();
-        return Status(Status::kOkCompleted);
-    }
-
     Status
     OnTrackEntry(const ElementMetadata &, const TrackEntry &track_entry) override
     {
         if (track_entry.codec_id.is_present()) {
-            if (track_entry.codec_id.value() == "V_AV1") {
-                if (track_entry.track_number.is_present()) {
-                    this->av1_track_number = track_entry.track_number.value();
-                }
-                if (track_entry.codec_delay.is_present()) {
-                    this->av1_codec_delay =
-                        (track_entry.codec_delay.value() * 1) / 1000000;
-                }
+            if (track_entry.codec_id.value() == "V_AV1" &&
+                track_entry.track_number.is_present()) {
+                this->add_video_track(track_entry);
             }
-            else if (track_entry.codec_id.value() == "A_OPUS") {
-                if (track_entry.track_number.is_present()) {
-                    this->opus_track_number = track_entry.track_number.value();
-                }
-                if (track_entry.codec_delay.is_present()) {
-                    this->opus_codec_delay =
-                        (track_entry.codec_delay.value() * 1) / 1000000;
-                }
+            else if (track_entry.codec_id.value() == "A_OPUS" &&
+                     track_entry.track_number.is_present()) {
+                this->add_audio_track(track_entry);
             }
         }
         return Status(Status::kOkCompleted);
     }
 
     Status
-    OnSimpleBlockBegin(const ElementMetadata &, const SimpleBlock &simple_block,
+    OnSimpleBlockBegin(const ElementMetadata &metadata, const SimpleBlock &simple_block,
                        Action *action) override
     {
-        if ((simple_block.track_number == this->av1_track_number &&
+        std::size_t audio_track = this->find_audio_track(simple_block.track_number);
+        if ((this->is_wanted_video_track(simple_block.track_number) &&
              this->context->codec_target & SAV1_CODEC_AV1) ||
-            (simple_block.track_number == this->opus_track_number &&
+            (audio_track != PARSE_NO_AUDIO_TRACK &&
              this->context->codec_target & SAV1_CODEC_OPUS)) {
             this->current_track_number = simple_block.track_number;
+            this->current_audio_track = audio_track;
+            this->calculate_timecode(simple_block.timecode);
+            this->extend_live_duration();
+            this->is_key_frame = simple_block.is_key_frame;
+            this->is_key_frame_unknown = false;
+            this->block_location = metadata.position;
+            this->index_block(metadata.position);
+
+            // skip opus frames before seek point
+            if (this->current_audio_track != PARSE_NO_AUDIO_TRACK &&
+                thread_atomic_int_load(&(this->context->do_seek)) & SAV1_CODEC_OPUS &&
+                this->timecode < this->context->seek_timecode) {
+                *action = Action::kSkip;
+            }
+            else if (this->skip_av1_block(metadata.position)) {
+                *action = Action::kSkip;
+            }
+            else {
+                *action = Action::kRead;
+            }
+        }
+        else if (simple_block.track_number == this->indexed_track_number &&
+                 this->context->codec_target & SAV1_CODEC_AV1) {
+            // keep indexing the first AV1 track while another one plays
+            this->current_track_number = simple_block.track_number;
+            this->current_audio_track = PARSE_NO_AUDIO_TRACK;
             this->calculate_timecode(simple_block.timecode);
             this->is_key_frame = simple_block.is_key_frame;
+            this->index_block(metadata.position);
+            *action = Action::kSkip;
+        }
+        else {
+            *action = Action::kSkip;
+        }
+        return Status(Status::kOkCompleted);
+    }
+
+    Status
+    OnBlockBegin(const ElementMetadata &metadata, const Block &block,
+                 Action *action) override
+    {
+        std::size_t audio_track = this->find_audio_track(block.track_number);
+        if ((this->is_wanted_video_track(block.track_number) &&
+             this->context->codec_target & SAV1_CODEC_AV1) ||
+            (audio_track != PARSE_NO_AUDIO_TRACK &&
+             this->context->codec_target & SAV1_CODEC_OPUS)) {
+            this->current_track_number = block.track_number;
+            this->current_audio_track = audio_track;
+            this->calculate_timecode(block.timecode);
+            this->extend_live_duration();
+
+            // only SimpleBlocks have a keyframe flag, so a Block has to be read to find
+            // out from its frame header
+            this->is_key_frame = false;
+            this->is_key_frame_unknown = this->is_wanted_video_track(block.track_number);
+            this->block_location = metadata.position;
+            if (!this->is_key_frame_unknown) {
+                this->index_block(metadata.position);
+            }
 
             // skip opus frames before seek point
-            if (this->current_track_number == this->opus_track_number &&
+            if (this->current_audio_track != PARSE_NO_AUDIO_TRACK &&
                 thread_atomic_int_load(&(this->context->do_seek)) & SAV1_CODEC_OPUS &&
                 this->timecode < this->context->seek_timecode) {
                 *action = Action::kSkip;
             }
+            else if (this->skip_av1_block(metadata.position)) {
+                *action = Action::kSkip;
+            }
             else {
                 *action = Action::kRead;
             }
@@ -210,131 +553,1257 @@ class Sav1Callback : public Callback {
         return Status(Status::kOkCompleted);
     }
 
-    Status
-    OnBlockBegin(const ElementMetadata &, const Block &block, Action *action) override
+    // wait until every frame held back for a full queue has been pushed, returning false
+    // if parsing was stopped first
+    bool
+    flush_pending_frames()
+    {
+        while (1) {
+            // the user can still switch audio tracks while nothing new is being read
+            if (!this->switch_audio_track()) {
+                return false;
+            }
+            if (this->pending_video.frames.empty() &&
+                this->pending_audio.frames.empty()) {
+                return true;
+            }
+            if (thread_atomic_int_load(&(this->context->do_parse)) == 0) {
+                return false;
+            }
+            this->wait_for_pending_frame(&(this->pending_video));
+            this->wait_for_pending_frame(&(this->pending_audio));
+        }
+    }
+
+    // push everything held back before reporting the end of the file. nothing is parsed
+    // while waiting at the end, so the status only changes under the audio track list's
+    // lock once no switch is pending, and a switch asked for after that sees the end of
+    // the file and seeks instead
+    void
+    report_end_of_file()
+    {
+        while (this->flush_pending_frames()) {
+            thread_mutex_lock(&(this->audio_track_list->lock));
+            bool is_switch_pending =
+                this->audio_track_list->track_switches != this->track_switches &&
+                this->audio_track_list->selected < this->audio_tracks.size();
+            if (!is_switch_pending) {
+                thread_atomic_int_store(&(this->context->status),
+                                        PARSE_STATUS_END_OF_FILE);
+            }
+            thread_mutex_unlock(&(this->audio_track_list->lock));
+            if (!is_switch_pending) {
+                return;
+            }
+        }
+        thread_atomic_int_store(&(this->context->status), PARSE_STATUS_END_OF_FILE);
+    }
+
+    // throw away the frames held back for full queues, along with any frame that was
+    // only partly read
+    void
+    clear_pending_frames()
+    {
+        if (this->partial_frame != nullptr) {
+            webm_frame_destroy(this->partial_frame);
+            this->partial_frame = nullptr;
+        }
+        for (WebMFrame *frame : this->pending_video.frames) {
+            webm_frame_destroy(frame);
+        }
+        this->pending_video.frames.clear();
+        for (WebMFrame *frame : this->pending_audio.frames) {
+            webm_frame_destroy(frame);
+        }
+        this->pending_audio.frames.clear();
+        this->clear_audio_track_buffers();
+    }
+
+    Status
+    OnFrame(const FrameMetadata &, Reader *reader,
+            std::uint64_t *bytes_remaining) override
+    {
+        // check if we should stop parsing
+        if (thread_atomic_int_load(&(this->context->do_parse)) == 0) {
+            return Status(PARSE_SEEK_STATUS);
+        }
+
+        // the user may have picked other tracks since the last frame
+        if (!this->switch_audio_track()) {
+            return Status(PARSE_SEEK_STATUS);
+        }
+        this->request_video_track_switch();
+
+        // sanity checks
+        if (reader == nullptr || bytes_remaining == nullptr || *bytes_remaining == 0) {
+            return Status(Status::kOkCompleted);
+        }
+
+        // pick up a frame that ran past the end of a file that's still being written,
+        // otherwise create the WebMFrame, pointing straight into the input if it's in
+        // memory
+        WebMFrame *frame = this->partial_frame;
+        this->partial_frame = nullptr;
+        if (frame == nullptr) {
+            const std::uint8_t *input_data =
+                this->reader->get_data(reader->Position(), *bytes_remaining);
+            if (input_data != nullptr) {
+                if (webm_frame_pool_get_borrowed(this->frame_pool, &frame, input_data,
+                                                 *bytes_remaining)) {
+                    sav1_set_error(this->context->ctx,
+                                   "malloc() failed in webm_frame_pool_get_borrowed()");
+                    sav1_set_critical_error_flag(this->context->ctx);
+                    return Status(Status::kNotEnoughMemory);
+                }
+            }
+            else if (webm_frame_pool_get(this->frame_pool, &frame, *bytes_remaining)) {
+                sav1_set_error(this->context->ctx,
+                               "malloc() failed in webm_frame_pool_get()");
+                sav1_set_critical_error_flag(this->context->ctx);
+                return Status(Status::kNotEnoughMemory);
+            }
+            frame->timecode = this->timecode;
+        }
+
+        // consume the frame data, copying it only when it isn't already in memory
+        std::uint8_t *buffer_location = frame->data + (frame->size - *bytes_remaining);
+        std::uint64_t num_read;
+        Status status;
+        do {
+            if (frame->is_borrowed) {
+                status = reader->Skip(*bytes_remaining, &num_read);
+            }
+            else {
+                status = reader->Read(*bytes_remaining, buffer_location, &num_read);
+                buffer_location += num_read;
+            }
+            *bytes_remaining -= num_read;
+        } while (status.code == Status::kOkPartial);
+
+        // the rest of the frame hasn't been written yet, so finish it off later
+        if (status.code == Status::kWouldBlock && *bytes_remaining > 0) {
+            this->partial_frame = frame;
+            return status;
+        }
+
+        // now that the frame header is here, finish what OnBlockBegin couldn't decide
+        if (this->is_key_frame_unknown) {
+            this->is_key_frame_unknown = false;
+            this->is_key_frame = av1_obu_is_key_frame(frame->data, frame->size) == 1;
+            this->index_block(this->block_location);
+            if (this->skip_av1_block(this->block_location)) {
+                webm_frame_destroy(frame);
+                return Status(Status::kOkCompleted);
+            }
+        }
+
+        // the AV1 track being switched to takes over at its first keyframe that isn't
+        // behind the last frame sent, with its sequence header in front. renditions
+        // usually share keyframe times, so that keyframe may replace a frame just sent
+        if (this->current_track_number == this->switch_track_number) {
+            if (!this->is_key_frame || this->timecode < this->last_video_timecode) {
+                webm_frame_destroy(frame);
+                return Status(Status::kOkCompleted);
+            }
+            this->set_active_video_track(this->switch_track_number);
+        }
+        if (this->current_track_number == this->av1_track_number &&
+            this->send_config_obus && this->is_key_frame) {
+            this->send_config_obus = false;
+            if (!this->add_config_obus(&frame)) {
+                return Status(Status::kNotEnoughMemory);
+            }
+        }
+
+        // fill in type-specific information
+        int do_seek = thread_atomic_int_load(&(this->context->do_seek));
+        if (this->current_track_number == this->av1_track_number) {
+            if (do_seek & SAV1_CODEC_AV1) {
+                // dav1d starts decoding again from the first frame sent after seeking
+                if (!this->seek_found_key_frame) {
+                    this->seek_found_key_frame = true;
+                    frame->sentinel = 1;
+                }
+                // discard any frames before the seek point
+                if (this->timecode < this->context->seek_timecode) {
+                    frame->do_discard = 1;
+                }
+                else {
+                    // we've found what we're looking for
+                    thread_atomic_int_store(&(this->context->do_seek),
+                                            do_seek ^ SAV1_CODEC_AV1);
+                }
+            }
+            if (this->is_key_frame) {
+                thread_atomic_int_store(&(this->context->skip_to_key_frame), 0);
+                this->last_key_frame_timecode = this->timecode;
+            }
+            frame->is_key_frame = this->is_key_frame;
+            frame->codec = SAV1_CODEC_AV1;
+            this->last_video_timecode = this->timecode;
+            if (!this->send_frame(&(this->pending_video), frame)) {
+                return Status(PARSE_SEEK_STATUS);
+            }
+        }
+        else if (this->current_audio_track == this->active_audio_track &&
+                 this->current_audio_track != PARSE_NO_AUDIO_TRACK) {
+            if (!this->send_audio_frame(frame)) {
+                return Status(PARSE_SEEK_STATUS);
+            }
+        }
+        else if (this->current_audio_track != PARSE_NO_AUDIO_TRACK) {
+            this->buffer_audio_frame(frame);
+        }
+        else {
+            // this is actually not a frame we want
+            webm_frame_destroy(frame);
+        }
+
+        return Status(Status::kOkCompleted);
+    }
+
+   private:
+    std::size_t
+    find_video_track(std::uint64_t track_number) const
+    {
+        for (std::size_t i = 0; i < this->video_tracks.size(); i++) {
+            if (this->video_tracks[i].track_number == track_number) {
+                return i;
+            }
+        }
+        return PARSE_NO_VIDEO_TRACK;
+    }
+
+    // the AV1 track that's playing, along with the one being switched to
+    bool
+    is_wanted_video_track(std::uint64_t track_number) const
+    {
+        return track_number == this->av1_track_number ||
+               (track_number == this->switch_track_number &&
+                track_number != PARSE_TRACK_NUMBER_NOT_SPECIFIED);
+    }
+
+    void
+    add_video_track(const TrackEntry &track_entry)
+    {
+        std::uint64_t track_number = track_entry.track_number.value();
+        if (this->find_video_track(track_number) != PARSE_NO_VIDEO_TRACK) {
+            return;
+        }
+        Sav1VideoTrackConfig config;
+        config.track_number = track_number;
+        config.codec_delay = 0;
+        if (track_entry.codec_delay.is_present()) {
+            config.codec_delay = (track_entry.codec_delay.value() * 1) / 1000000;
+        }
+
+        // the configOBUs follow the 4 byte header of the AV1CodecConfigurationRecord
+        const std::vector<std::uint8_t> &codec_private =
+            track_entry.codec_private.value();
+        if (codec_private.size() > 4 && codec_private[0] == 0x81) {
+            config.config_obus.assign(codec_private.begin() + 4, codec_private.end());
+        }
+        this->video_tracks.push_back(config);
+
+        // the first track is the one that's indexed, and plays unless the automatic
+        // mode finds a bigger one
+        bool is_first_track = this->video_tracks.size() == 1;
+        if (is_first_track) {
+            this->indexed_track_number = track_number;
+            this->av1_track_number = track_number;
+            this->av1_codec_delay = config.codec_delay;
+        }
+
+        Sav1ParseVideoTrack track;
+        track.track_number = track_number;
+        track.width = track_entry.video.value().pixel_width.value();
+        track.height = track_entry.video.value().pixel_height.value();
+        track.name = track_entry.name.value();
+        Sav1VideoTrackList *list = this->video_track_list;
+        thread_mutex_lock(&(list->lock));
+        list->tracks.push_back(track);
+        const Sav1ParseVideoTrack &active = list->tracks[list->active];
+        if (!is_first_track && this->context->video_track_mode == SAV1_VIDEO_TRACK_AUTO &&
+            track.width * track.height > active.width * active.height) {
+            list->selected = list->active = list->tracks.size() - 1;
+            this->av1_track_number = track_number;
+        }
+        thread_mutex_unlock(&(list->lock));
+    }
+
+    // note which AV1 track the user or the automatic mode wants, which is switched to
+    // at its next keyframe
+    void
+    request_video_track_switch()
+    {
+        Sav1VideoTrackList *list = this->video_track_list;
+        thread_mutex_lock(&(list->lock));
+        int track_switches = list->track_switches;
+        std::size_t selected = list->selected;
+        thread_mutex_unlock(&(list->lock));
+        if (track_switches == this->video_track_switches ||
+            selected >= this->video_tracks.size()) {
+            return;
+        }
+        this->video_track_switches = track_switches;
+        std::uint64_t track_number = this->video_tracks[selected].track_number;
+        this->switch_track_number = track_number == this->av1_track_number
+                                        ? PARSE_TRACK_NUMBER_NOT_SPECIFIED
+                                        : track_number;
+    }
+
+    void
+    set_active_video_track(std::uint64_t track_number)
+    {
+        this->av1_track_number = track_number;
+        this->switch_track_number = PARSE_TRACK_NUMBER_NOT_SPECIFIED;
+        this->send_config_obus = true;
+        thread_mutex_lock(&(this->video_track_list->lock));
+        this->video_track_list->active = this->find_video_track(track_number);
+        thread_mutex_unlock(&(this->video_track_list->lock));
+    }
+
+    // put the track's sequence header in front of its first frame, since dav1d may only
+    // have seen the last track's. returns false if memory ran out
+    bool
+    add_config_obus(WebMFrame **frame)
+    {
+        const std::vector<std::uint8_t> &config_obus =
+            this->video_tracks[this->find_video_track(this->av1_track_number)]
+                .config_obus;
+        if (config_obus.empty()) {
+            return true;
+        }
+        WebMFrame *config_frame;
+        if (webm_frame_pool_get(this->frame_pool, &config_frame,
+                                config_obus.size() + (*frame)->size)) {
+            webm_frame_destroy(*frame);
+            sav1_set_error(this->context->ctx,
+                           "malloc() failed in webm_frame_pool_get()");
+            sav1_set_critical_error_flag(this->context->ctx);
+            return false;
+        }
+        std::memcpy(config_frame->data, config_obus.data(), config_obus.size());
+        std::memcpy(config_frame->data + config_obus.size(), (*frame)->data,
+                    (*frame)->size);
+        config_frame->timecode = (*frame)->timecode;
+        webm_frame_destroy(*frame);
+        *frame = config_frame;
+        return true;
+    }
+
+    std::size_t
+    find_audio_track(std::uint64_t track_number) const
+    {
+        for (std::size_t i = 0; i < this->audio_tracks.size(); i++) {
+            if (this->audio_tracks[i].track_number == track_number) {
+                return i;
+            }
+        }
+        return PARSE_NO_AUDIO_TRACK;
+    }
+
+    void
+    add_audio_track(const TrackEntry &track_entry)
+    {
+        // the headers are read again when looping, so a track may already be known
+        std::uint64_t track_number = track_entry.track_number.value();
+        if (this->find_audio_track(track_number) != PARSE_NO_AUDIO_TRACK) {
+            return;
+        }
+        Sav1AudioTrackBuffer buffer;
+        buffer.track_number = track_number;
+        buffer.codec_delay = 0;
+        if (track_entry.codec_delay.is_present()) {
+            buffer.codec_delay = (track_entry.codec_delay.value() * 1) / 1000000;
+        }
+        this->audio_tracks.push_back(buffer);
+
+        // the first track plays until the user picks another
+        if (this->active_audio_track == PARSE_NO_AUDIO_TRACK) {
+            this->active_audio_track = 0;
+            this->opus_track_number = track_number;
+        }
+
+        Sav1ParseAudioTrack track;
+        track.track_number = track_number;
+        track.language = track_entry.language.value();
+        track.name = track_entry.name.value();
+        thread_mutex_lock(&(this->audio_track_list->lock));
+        this->audio_track_list->tracks.push_back(track);
+        thread_mutex_unlock(&(this->audio_track_list->lock));
+    }
+
+    // hold on to a frame from a track that isn't playing, dropping the ones that have
+    // got too old to be needed
+    void
+    buffer_audio_frame(WebMFrame *frame)
+    {
+        std::deque<WebMFrame *> &frames =
+            this->audio_tracks[this->current_audio_track].frames;
+        frame->codec = SAV1_CODEC_OPUS;
+        frames.push_back(frame);
+        std::uint64_t buffer_time =
+            2 * this->pending_audio.queue->capacity * PARSE_OPUS_MAX_PACKET_DURATION +
+            PARSE_AUDIO_TRACK_BUFFER_MARGIN;
+        while (frames.front()->timecode + buffer_time < frame->timecode) {
+            webm_frame_destroy(frames.front());
+            frames.pop_front();
+        }
+    }
+
+    void
+    clear_audio_track_buffers()
+    {
+        for (Sav1AudioTrackBuffer &buffer : this->audio_tracks) {
+            for (WebMFrame *frame : buffer.frames) {
+                webm_frame_destroy(frame);
+            }
+            buffer.frames.clear();
+        }
+    }
+
+    // start sending the track the user picked, beginning with the frames held for it
+    // from where playback is. returns false if parsing was stopped while sending them
+    bool
+    switch_audio_track()
+    {
+        thread_mutex_lock(&(this->audio_track_list->lock));
+        int track_switches = this->audio_track_list->track_switches;
+        std::size_t selected = this->audio_track_list->selected;
+        std::uint64_t switch_timecode = this->audio_track_list->switch_timecode;
+        thread_mutex_unlock(&(this->audio_track_list->lock));
+        if (track_switches == this->track_switches ||
+            selected >= this->audio_tracks.size()) {
+            return true;
+        }
+        this->track_switches = track_switches;
+
+        // the old track's frames would only be thrown away after decoding
+        for (WebMFrame *frame : this->pending_audio.frames) {
+            webm_frame_destroy(frame);
+        }
+        this->pending_audio.frames.clear();
+
+        this->active_audio_track = selected;
+        this->opus_track_number = this->audio_tracks[selected].track_number;
+        std::deque<WebMFrame *> &frames = this->audio_tracks[selected].frames;
+        while (!frames.empty() && frames.front()->timecode < switch_timecode) {
+            webm_frame_destroy(frames.front());
+            frames.pop_front();
+        }
+        while (!frames.empty()) {
+            WebMFrame *frame = frames.front();
+            frames.pop_front();
+            if (!this->send_audio_frame(frame)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool
+    send_audio_frame(WebMFrame *frame)
+    {
+        int do_seek = thread_atomic_int_load(&(this->context->do_seek));
+        if (do_seek & SAV1_CODEC_OPUS) {
+            // we've found what we're looking for
+            thread_atomic_int_store(&(this->context->do_seek), do_seek ^ SAV1_CODEC_OPUS);
+            frame->sentinel = 1;
+        }
+        frame->codec = SAV1_CODEC_OPUS;
+        frame->track_switches = this->track_switches;
+        return this->send_frame(&(this->pending_audio), frame);
+    }
+
+    // push the frames held back for a track until its queue is full
+    void
+    push_pending_frames(Sav1PendingFrames *pending)
+    {
+        while (!pending->frames.empty() &&
+               sav1_thread_queue_try_push(pending->queue, pending->frames.front())) {
+            pending->frames.pop_front();
+        }
+    }
+
+    // wait briefly for room to push the next frame held back for a track
+    void
+    wait_for_pending_frame(Sav1PendingFrames *pending)
+    {
+        if (!pending->frames.empty() &&
+            sav1_thread_queue_push_timeout(pending->queue, pending->frames.front())) {
+            pending->frames.pop_front();
+            this->push_pending_frames(pending);
+        }
+    }
+
+    // hand a frame to its track without blocking the other track behind it, only
+    // waiting once this track has held back as many frames as its queue holds, so that
+    // queue_size still bounds how much is parsed ahead. returns false if parsing was
+    // stopped while waiting
+    bool
+    send_frame(Sav1PendingFrames *pending, WebMFrame *frame)
+    {
+        pending->frames.push_back(frame);
+        this->push_pending_frames(&(this->pending_video));
+        this->push_pending_frames(&(this->pending_audio));
+        while (pending->frames.size() > pending->queue->capacity) {
+            if (thread_atomic_int_load(&(this->context->do_parse)) == 0) {
+                return false;
+            }
+            this->wait_for_pending_frame(pending);
+
+            // keep the other track flowing while this one is stuck
+            this->push_pending_frames(&(this->pending_video));
+            this->push_pending_frames(&(this->pending_audio));
+        }
+        return true;
+    }
+
+    void
+    index_block(std::uint64_t block_location)
+    {
+        if (!this->indexing || this->current_track_number != this->indexed_track_number) {
+            return;
+        }
+        if (this->is_key_frame &&
+            (this->key_frames.empty() ||
+             this->timecode > this->key_frames.back().timecode)) {
+            Sav1KeyFrame key_frame;
+            key_frame.timecode = this->timecode;
+            key_frame.cluster_location = this->cluster_location;
+            key_frame.block_location = block_location;
+            this->key_frames.push_back(key_frame);
+        }
+        if (this->timecode > this->indexed_timecode) {
+            this->indexed_timecode = this->timecode;
+        }
+    }
+
+    // a keyframe sent after the time playback fell behind at gets the decoder there
+    // without leaving out anything more
+    bool
+    is_skipping_to_key_frame()
+    {
+        if (!thread_atomic_int_load(&(this->context->skip_to_key_frame))) {
+            return false;
+        }
+        if (this->last_key_frame_timecode > this->context->skip_timecode) {
+            thread_atomic_int_store(&(this->context->skip_to_key_frame), 0);
+            return false;
+        }
+        return true;
+    }
+
+    bool
+    skip_av1_block(std::uint64_t block_location)
+    {
+        // the track being switched to can only start at a keyframe
+        if (this->current_track_number == this->switch_track_number) {
+            return !this->is_key_frame_unknown && !this->is_key_frame;
+        }
+        if (this->current_track_number != this->av1_track_number) {
+            return false;
+        }
+        if (!(thread_atomic_int_load(&(this->context->do_seek)) & SAV1_CODEC_AV1)) {
+            // catching up jumps straight to the next keyframe
+            return !this->is_key_frame_unknown && !this->is_key_frame &&
+                   this->is_skipping_to_key_frame();
+        }
+
+        // jump straight to the keyframe that the seek starts from
+        if (block_location < this->seek_block_location) {
+            return true;
+        }
+
+        // frames ahead of the first keyframe can't be decoded, though a Block has to be
+        // read before we know whether it's a keyframe
+        return !this->seek_found_key_frame && !this->is_key_frame &&
+               !this->is_key_frame_unknown &&
+               this->timecode < this->context->seek_timecode;
+    }
+
+    ParseContext *context;
+    Sav1Reader *reader;
+    WebMFramePool *frame_pool;
+    Sav1ChapterList *chapter_list;
+    Sav1AudioTrackList *audio_track_list;
+    Sav1VideoTrackList *video_track_list;
+    std::uint64_t current_track_number;
+    std::uint64_t av1_track_number;
+    std::uint64_t indexed_track_number;
+    std::uint64_t switch_track_number;
+    std::vector<Sav1VideoTrackConfig> video_tracks;
+    int video_track_switches;
+    bool send_config_obus;
+    std::uint64_t last_video_timecode;
+    std::uint64_t last_key_frame_timecode;
+    std::uint64_t opus_track_number;
+    std::uint64_t timecode_scale;
+    std::uint64_t cluster_timecode;
+    std::uint64_t timecode;
+    std::uint64_t live_duration;
+    WebMFrame *partial_frame;
+    std::uint64_t av1_codec_delay;
+    std::vector<Sav1AudioTrackBuffer> audio_tracks;
+    std::size_t current_audio_track;
+    std::size_t active_audio_track;
+    int track_switches;
+    std::vector<Sav1CuePoint> cue_points;
+    std::uint64_t cluster_location;
+    bool all_cue_points;
+    bool skip_clusters;
+    bool is_key_frame;
+    bool is_key_frame_unknown;
+    std::uint64_t block_location;
+    std::vector<Sav1KeyFrame> key_frames;
+    std::uint64_t indexed_timecode;
+    bool indexing;
+    std::uint64_t seek_block_location;
+    bool seek_found_key_frame;
+    Sav1PendingFrames pending_video;
+    Sav1PendingFrames pending_audio;
+};
+
+class Sav1CueCallback : public Callback {
+   public:
+    Sav1CueCallback(int codec_target, Sav1ChapterList *chapter_list)
+        : codec_target(codec_target),
+          chapter_list(chapter_list),
+          segment_data_start(0),
+          cues_position(0),
+          found_cues_position(false),
+          chapters_position(0),
+          found_chapters_position(false),
+          timecode_scale(1000000),
+          av1_track_number(PARSE_TRACK_NUMBER_NOT_SPECIFIED)
+    {
+    }
+
+    bool
+    should_seek_to_cues() const
+    {
+        return this->found_cues_position && this->cues.empty();
+    }
+
+    std::uint64_t
+    get_cues_location() const
+    {
+        return this->segment_data_start + this->cues_position;
+    }
+
+    bool
+    should_seek_to_chapters() const
+    {
+        return this->found_chapters_position && !this->chapter_list->is_set;
+    }
+
+    std::uint64_t
+    get_chapters_location() const
+    {
+        return this->segment_data_start + this->chapters_position;
+    }
+
+    void
+    get_cue_points(std::vector<Sav1CuePoint> *cue_points) const
+    {
+        // when decoding video only the video cues are guaranteed to point at keyframes
+        bool use_av1_cues = this->codec_target & SAV1_CODEC_AV1 &&
+                            this->av1_track_number != PARSE_TRACK_NUMBER_NOT_SPECIFIED;
+
+        cue_points->clear();
+        for (const RawCue &raw_cue : this->cues) {
+            if (use_av1_cues && raw_cue.track != this->av1_track_number) {
+                continue;
+            }
+            Sav1CuePoint cue;
+            cue.timecode = (raw_cue.time * this->timecode_scale) / 1000000;
+            cue.cluster_location = this->segment_data_start + raw_cue.cluster_position;
+            cue_points->push_back(cue);
+        }
+        std::sort(cue_points->begin(), cue_points->end(),
+                  [](const Sav1CuePoint &a, const Sav1CuePoint &b) {
+                      return a.timecode < b.timecode;
+                  });
+    }
+
+    Status
+    OnSegmentBegin(const ElementMetadata &metadata, Action *action) override
+    {
+        this->segment_data_start = metadata.position + metadata.header_size;
+        *action = Action::kRead;
+        return Status(Status::kOkCompleted);
+    }
+
+    Status
+    OnSeek(const ElementMetadata &, const Seek &seek) override
+    {
+        if (!seek.id.is_present() || !seek.position.is_present()) {
+            return Status(Status::kOkCompleted);
+        }
+        if (seek.id.value() == Id::kCues) {
+            this->cues_position = seek.position.value();
+            this->found_cues_position = true;
+        }
+        else if (seek.id.value() == Id::kChapters) {
+            this->chapters_position = seek.position.value();
+            this->found_chapters_position = true;
+        }
+        return Status(Status::kOkCompleted);
+    }
+
+    Status
+    OnInfo(const ElementMetadata &, const Info &info) override
+    {
+        if (info.timecode_scale.is_present()) {
+            this->timecode_scale = info.timecode_scale.value();
+        }
+        return Status(Status::kOkCompleted);
+    }
+
+    Status
+    OnEditionEntry(const ElementMetadata &, const EditionEntry &edition_entry) override
+    {
+        parse_store_chapters(this->chapter_list, edition_entry);
+        return Status(Status::kOkCompleted);
+    }
+
+    Status
+    OnTrackEntry(const ElementMetadata &, const TrackEntry &track_entry) override
+    {
+        // the cues for the first AV1 track are the ones that match the index
+        if (track_entry.codec_id.is_present() &&
+            track_entry.codec_id.value() == "V_AV1" &&
+            track_entry.track_number.is_present() &&
+            this->av1_track_number == PARSE_TRACK_NUMBER_NOT_SPECIFIED) {
+            this->av1_track_number = track_entry.track_number.value();
+        }
+        return Status(Status::kOkCompleted);
+    }
+
+    Status
+    OnCuePoint(const ElementMetadata &, const CuePoint &cue_point) override
+    {
+        if (!cue_point.time.is_present()) {
+            return Status(Status::kOkCompleted);
+        }
+        for (const Element<CueTrackPositions> &positions :
+             cue_point.cue_track_positions) {
+            if (positions.value().cluster_position.is_present()) {
+                RawCue raw_cue;
+                raw_cue.time = cue_point.time.value();
+                raw_cue.track = positions.value().track.value();
+                raw_cue.cluster_position = positions.value().cluster_position.value();
+                this->cues.push_back(raw_cue);
+            }
+        }
+        return Status(Status::kOkCompleted);
+    }
+
+    Status
+    OnClusterBegin(const ElementMetadata &, const Cluster &, Action *action) override
+    {
+        // everything we need comes before the first cluster (or is found via SeekHead)
+        *action = Action::kSkip;
+        return Status(PARSE_CUES_DONE_STATUS);
+    }
+
+   private:
+    typedef struct RawCue {
+        std::uint64_t time;
+        std::uint64_t track;
+        std::uint64_t cluster_position;
+    } RawCue;
+
+    int codec_target;
+    Sav1ChapterList *chapter_list;
+    std::uint64_t segment_data_start;
+    std::uint64_t cues_position;
+    bool found_cues_position;
+    std::uint64_t chapters_position;
+    bool found_chapters_position;
+    std::uint64_t timecode_scale;
+    std::uint64_t av1_track_number;
+    std::vector<RawCue> cues;
+};
+
+// scans the whole file in the background, reading block headers but never their data
+class Sav1IndexCallback : public Callback {
+   public:
+    Sav1IndexCallback(int codec_target, thread_atomic_int_t *do_index)
+        : codec_target(codec_target),
+          do_index(do_index),
+          cluster_location(0),
+          cluster_timecode(0),
+          duration(0),
+          block_track_number(0),
+          block_timecode(0),
+          block_location(0),
+          num_peeked(0)
+    {
+        this->index.timecode_scale = 1000000;
+        this->index.duration = 0;
+        this->index.av1_track_number = PARSE_TRACK_NUMBER_NOT_SPECIFIED;
+        this->index.opus_track_number = PARSE_TRACK_NUMBER_NOT_SPECIFIED;
+        this->index.av1_codec_delay = 0;
+        this->index.opus_codec_delay = 0;
+        Sav1CuePoint cue = {0, 0};
+        this->index.cue_points.push_back(cue);
+        this->index.all_cue_points = true;
+        this->index.indexed_timecode = 0;
+    }
+
+    Sav1ParseIndex *
+    get_index()
+    {
+        // fall back to the last timecode seen when the file doesn't say how long it is
+        if (this->index.duration == 0) {
+            this->index.duration = this->duration;
+        }
+        return &(this->index);
+    }
+
+    Status
+    OnInfo(const ElementMetadata &, const Info &info) override
+    {
+        if (info.timecode_scale.is_present()) {
+            this->index.timecode_scale = info.timecode_scale.value();
+        }
+        if (info.duration.is_present()) {
+            this->index.duration = (std::uint64_t)(
+                (info.duration.value() * this->index.timecode_scale) / 1000000.0);
+        }
+        return Status(Status::kOkCompleted);
+    }
+
+    Status
+    OnTrackEntry(const ElementMetadata &, const TrackEntry &track_entry) override
+    {
+        if (!track_entry.codec_id.is_present() ||
+            !track_entry.track_number.is_present()) {
+            return Status(Status::kOkCompleted);
+        }
+        std::uint64_t codec_delay =
+            track_entry.codec_delay.is_present() ? track_entry.codec_delay.value() : 0;
+        if (track_entry.codec_id.value() == "V_AV1" &&
+            this->index.av1_track_number == PARSE_TRACK_NUMBER_NOT_SPECIFIED) {
+            this->index.av1_track_number = track_entry.track_number.value();
+            this->index.av1_codec_delay = (codec_delay * 1) / 1000000;
+        }
+        else if (track_entry.codec_id.value() == "A_OPUS") {
+            this->index.opus_track_number = track_entry.track_number.value();
+            this->index.opus_codec_delay = (codec_delay * 1) / 1000000;
+        }
+        return Status(Status::kOkCompleted);
+    }
+
+    Status
+    OnClusterBegin(const ElementMetadata &metadata, const Cluster &cluster,
+                   Action *action) override
+    {
+        if (!thread_atomic_int_load(this->do_index)) {
+            return Status(PARSE_INDEX_STOP_STATUS);
+        }
+
+        // give the playback threads a chance to run between clusters
+        thread_yield();
+
+        this->cluster_location = metadata.position;
+        if (cluster.timecode.is_present()) {
+            this->cluster_timecode = cluster.timecode.value();
+        }
+        std::uint64_t timecode_ms =
+            (this->cluster_timecode * this->index.timecode_scale) / 1000000;
+        if (timecode_ms > this->index.cue_points.back().timecode) {
+            Sav1CuePoint cue;
+            cue.timecode = timecode_ms;
+            cue.cluster_location = metadata.position;
+            this->index.cue_points.push_back(cue);
+        }
+
+        *action = Action::kRead;
+        return Status(Status::kOkCompleted);
+    }
+
+    Status
+    OnSimpleBlockBegin(const ElementMetadata &metadata, const SimpleBlock &simple_block,
+                       Action *action) override
+    {
+        this->index_block(simple_block.track_number, simple_block.timecode,
+                          simple_block.is_key_frame, metadata.position);
+        *action = Action::kSkip;
+        return Status(Status::kOkCompleted);
+    }
+
+    Status
+    OnBlockBegin(const ElementMetadata &metadata, const Block &block,
+                 Action *action) override
+    {
+        // a Block's keyframe status comes from its frame header, so read the start of it
+        if (block.track_number == this->index.av1_track_number &&
+            this->codec_target & SAV1_CODEC_AV1) {
+            this->block_track_number = block.track_number;
+            this->block_timecode = block.timecode;
+            this->block_location = metadata.position;
+            this->num_peeked = 0;
+            *action = Action::kRead;
+            return Status(Status::kOkCompleted);
+        }
+        this->index_block(block.track_number, block.timecode, false, metadata.position);
+        *action = Action::kSkip;
+        return Status(Status::kOkCompleted);
+    }
+
+    Status
+    OnFrame(const FrameMetadata &, Reader *reader,
+            std::uint64_t *bytes_remaining) override
+    {
+        // read just enough to find the frame header, then skip the rest
+        std::uint64_t num_read;
+        Status status(Status::kOkCompleted);
+        while (this->num_peeked < AV1_OBU_PEEK_SIZE && *bytes_remaining > 0) {
+            std::size_t num_wanted = AV1_OBU_PEEK_SIZE - this->num_peeked;
+            if (num_wanted > *bytes_remaining) {
+                num_wanted = (std::size_t)*bytes_remaining;
+            }
+            status = reader->Read(num_wanted, this->peek_buffer + this->num_peeked,
+                                  &num_read);
+            this->num_peeked += (std::size_t)num_read;
+            *bytes_remaining -= num_read;
+            if (status.code != Status::kOkPartial && !status.completed_ok()) {
+                return status;
+            }
+        }
+        while (*bytes_remaining > 0) {
+            status = reader->Skip(*bytes_remaining, &num_read);
+            *bytes_remaining -= num_read;
+            if (status.code != Status::kOkPartial && !status.completed_ok()) {
+                return status;
+            }
+        }
+
+        bool is_key_frame =
+            av1_obu_is_key_frame(this->peek_buffer, this->num_peeked) == 1;
+        this->index_block(this->block_track_number, this->block_timecode, is_key_frame,
+                          this->block_location);
+        return Status(Status::kOkCompleted);
+    }
+
+   private:
+    void
+    index_block(std::uint64_t track_number, std::int16_t relative_time, bool is_key_frame,
+                std::uint64_t block_location)
+    {
+        std::uint64_t total_time = this->cluster_timecode + relative_time;
+        std::uint64_t timecode = (total_time * this->index.timecode_scale) / 1000000;
+        if (timecode > this->duration) {
+            this->duration = timecode;
+        }
+
+        if (track_number != this->index.av1_track_number ||
+            !(this->codec_target & SAV1_CODEC_AV1)) {
+            return;
+        }
+
+        // match the timecodes that Sav1Callback gives its frames
+        total_time = total_time > this->index.av1_codec_delay
+                         ? total_time - this->index.av1_codec_delay
+                         : 0;
+        timecode = (total_time * this->index.timecode_scale) / 1000000;
+        if (is_key_frame && (this->index.key_frames.empty() ||
+                             timecode > this->index.key_frames.back().timecode)) {
+            Sav1KeyFrame key_frame;
+            key_frame.timecode = timecode;
+            key_frame.cluster_location = this->cluster_location;
+            key_frame.block_location = block_location;
+            this->index.key_frames.push_back(key_frame);
+        }
+        if (timecode > this->index.indexed_timecode) {
+            this->index.indexed_timecode = timecode;
+        }
+    }
+
+    int codec_target;
+    thread_atomic_int_t *do_index;
+    Sav1ParseIndex index;
+    std::uint64_t cluster_location;
+    std::uint64_t cluster_timecode;
+    std::uint64_t duration;
+    std::uint64_t block_track_number;
+    std::int16_t block_timecode;
+    std::uint64_t block_location;
+    std::uint8_t peek_buffer[AV1_OBU_PEEK_SIZE];
+    std::size_t num_peeked;
+};
+
+// drives one of the demuxers in parse_demux.h in place of libwebm, following the same
+// rules as Sav1Callback for sending frames after a seek
+class Sav1DemuxFeeder {
+   public:
+    Sav1DemuxFeeder(ParseContext *context, Sav1Demuxer *demuxer,
+                    WebMFramePool *frame_pool)
+        : context(context),
+          demuxer(demuxer),
+          frame_pool(frame_pool),
+          first_frame_location(demuxer->get_position()),
+          seek_found_key_frame(false),
+          last_timecode(0),
+          last_key_frame_timecode(0),
+          frame_duration(0)
+    {
+    }
+
+    ~Sav1DemuxFeeder()
+    {
+        delete this->demuxer;
+    }
+
+    Sav1DemuxFeeder(const Sav1DemuxFeeder &) = delete;
+    Sav1DemuxFeeder &
+    operator=(const Sav1DemuxFeeder &) = delete;
+
+    // read and send frames until the end of the input, returning PARSE_SEEK_STATUS if
+    // parsing is stopped first
+    Status
+    feed()
+    {
+        // these inputs have nothing but video
+        if (!(this->context->codec_target & SAV1_CODEC_AV1)) {
+            return Status(Status::kOkCompleted);
+        }
+        while (1) {
+            if (thread_atomic_int_load(&(this->context->do_parse)) == 0) {
+                return Status(PARSE_SEEK_STATUS);
+            }
+            std::uint64_t location = this->demuxer->get_position();
+            WebMFrame *frame;
+            Status status = this->demuxer->read_frame(this->frame_pool, &frame);
+            if (status.code == Status::kEndOfFile) {
+                return Status(Status::kOkCompleted);
+            }
+            if (status.code == Status::kNotEnoughMemory) {
+                sav1_set_error(this->context->ctx, "malloc() failed in Sav1DemuxFeeder");
+                sav1_set_critical_error_flag(this->context->ctx);
+            }
+            if (!status.completed_ok()) {
+                return status;
+            }
+
+            frame->codec = SAV1_CODEC_AV1;
+            frame->is_key_frame = av1_obu_is_key_frame(frame->data, frame->size) == 1;
+            this->index_frame(frame, location);
+            if (!this->send_frame(frame)) {
+                return Status(PARSE_SEEK_STATUS);
+            }
+        }
+    }
+
+    // carry on from the last keyframe at or before timecode, or from the start
+    void
+    seek(std::uint64_t timecode)
     {
-        if ((block.track_number == this->av1_track_number &&
-             this->context->codec_target & SAV1_CODEC_AV1) ||
-            (block.track_number == this->opus_track_number &&
-             this->context->codec_target & SAV1_CODEC_OPUS)) {
-            this->current_track_number = block.track_number;
-            this->calculate_timecode(block.timecode);
-            this->is_key_frame = false;
-
-            // skip opus frames before seek point
-            if (this->current_track_number == this->opus_track_number &&
-                thread_atomic_int_load(&(this->context->do_seek)) & SAV1_CODEC_OPUS &&
-                this->timecode < this->context->seek_timecode) {
-                *action = Action::kSkip;
-            }
-            else {
-                *action = Action::kRead;
-            }
+        auto key_frame = std::upper_bound(
+            this->key_frames.begin(), this->key_frames.end(), timecode,
+            [](std::uint64_t timecode, const Sav1KeyFrame &key_frame) {
+                return timecode < key_frame.timecode;
+            });
+        if (key_frame == this->key_frames.begin()) {
+            this->demuxer->seek(this->first_frame_location, 0);
         }
         else {
-            *action = Action::kSkip;
+            --key_frame;
+            this->demuxer->seek(key_frame->block_location, key_frame->timecode);
         }
-        return Status(Status::kOkCompleted);
+        this->seek_found_key_frame = false;
+        this->last_timecode = 0;
+        this->last_key_frame_timecode = 0;
     }
 
-    Status
-    OnFrame(const FrameMetadata &, Reader *reader,
-            std::uint64_t *bytes_remaining) override
+   private:
+    // remember where the keyframes are for seeking, and stretch the duration to cover
+    // the frame, since these inputs don't list it
+    void
+    index_frame(const WebMFrame *frame, std::uint64_t location)
     {
-        // check if we should stop parsing
-        if (thread_atomic_int_load(&(this->context->do_parse)) == 0) {
-            return Status(PARSE_SEEK_STATUS);
+        if (frame->is_key_frame && (this->key_frames.empty() ||
+                                    frame->timecode > this->key_frames.back().timecode)) {
+            Sav1KeyFrame key_frame;
+            key_frame.timecode = frame->timecode;
+            key_frame.cluster_location = location;
+            key_frame.block_location = location;
+            this->key_frames.push_back(key_frame);
         }
 
-        // sanity checks
-        if (reader == nullptr || bytes_remaining == nullptr || *bytes_remaining == 0) {
-            return Status(Status::kOkCompleted);
+        if (frame->timecode > this->last_timecode) {
+            this->frame_duration = frame->timecode - this->last_timecode;
         }
-
-        // create the WebMFrame
-        WebMFrame *frame;
-        if (webm_frame_init(&frame, *bytes_remaining)) {
-            sav1_set_error(this->context->ctx, "malloc() failed in webm_frame_init()");
-            sav1_set_critical_error_flag(this->context->ctx);
-            return Status(Status::kNotEnoughMemory);
+        this->last_timecode = frame->timecode;
+        thread_mutex_lock(this->context->duration_lock);
+        if (frame->timecode + this->frame_duration > this->context->duration) {
+            this->context->duration = frame->timecode + this->frame_duration;
         }
-        frame->timecode = this->timecode;
-
-        // read frame data until there's no more to read
-        std::uint8_t *buffer_location = frame->data;
-        std::uint64_t num_read;
-        Status status;
-        do {
-            status = reader->Read(*bytes_remaining, buffer_location, &num_read);
-            buffer_location += num_read;
-            *bytes_remaining -= num_read;
-        } while (status.code == Status::kOkPartial);
+        thread_mutex_unlock(this->context->duration_lock);
+    }
 
-        // fill in type-specific information
+    // returns false if parsing was stopped while waiting for room in the queue
+    bool
+    send_frame(WebMFrame *frame)
+    {
         int do_seek = thread_atomic_int_load(&(this->context->do_seek));
-        if (this->current_track_number == this->av1_track_number) {
-            if (do_seek & SAV1_CODEC_AV1) {
-                // give dav1d a five second head start when seeking
-                if (this->timecode + 5000 >= this->context->seek_timecode) {
-                    frame->sentinel = 1;
-                }
-                // discard any frames before the seek point
-                if (this->timecode < this->context->seek_timecode) {
-                    frame->do_discard = 1;
-                }
-                else {
-                    // we've found what we're looking for
-                    thread_atomic_int_store(&(this->context->do_seek),
-                                            do_seek ^ SAV1_CODEC_AV1);
+        if (do_seek & SAV1_CODEC_AV1) {
+            // dav1d starts decoding again from the first keyframe sent after seeking
+            if (!this->seek_found_key_frame) {
+                if (!frame->is_key_frame) {
+                    webm_frame_destroy(frame);
+                    return true;
                 }
+                this->seek_found_key_frame = true;
+                frame->sentinel = 1;
+            }
+            if (frame->timecode < this->context->seek_timecode) {
+                frame->do_discard = 1;
+            }
+            else {
+                // there's no audio to wait for
+                thread_atomic_int_store(&(this->context->do_seek), 0);
             }
-            frame->is_key_frame = this->is_key_frame;
-            frame->codec = SAV1_CODEC_AV1;
-            sav1_thread_queue_push(this->context->video_output_queue, frame);
         }
-        else if (this->current_track_number == this->opus_track_number) {
-            if (do_seek & SAV1_CODEC_OPUS) {
-                // we've found what we're looking for
-                thread_atomic_int_store(&(this->context->do_seek),
-                                        do_seek ^ SAV1_CODEC_OPUS);
-                frame->sentinel = 1;
+        else if (thread_atomic_int_load(&(this->context->skip_to_key_frame)) &&
+                 this->last_key_frame_timecode <= this->context->skip_timecode) {
+            // catching up jumps straight to the next keyframe, unless one was already
+            // sent after the time playback fell behind at
+            if (!frame->is_key_frame) {
+                webm_frame_destroy(frame);
+                return true;
             }
-            frame->codec = SAV1_CODEC_OPUS;
-            sav1_thread_queue_push(this->context->audio_output_queue, frame);
         }
-        else {
-            // this is actually not a frame we want
-            webm_frame_destroy(frame);
+        if (frame->is_key_frame) {
+            thread_atomic_int_store(&(this->context->skip_to_key_frame), 0);
+            this->last_key_frame_timecode = frame->timecode;
         }
 
-        return Status(Status::kOkCompleted);
+        Sav1ThreadQueue *queue = this->context->video_output_queue;
+        while (!sav1_thread_queue_push_timeout(queue, frame)) {
+            if (thread_atomic_int_load(&(this->context->do_parse)) == 0) {
+                webm_frame_destroy(frame);
+                return false;
+            }
+        }
+        return true;
     }
 
-   private:
     ParseContext *context;
-    FileReader *reader;
-    std::uint64_t current_track_number;
-    std::uint64_t av1_track_number;
-    std::uint64_t opus_track_number;
-    std::uint64_t timecode_scale;
-    std::uint64_t cluster_timecode;
-    std::uint64_t timecode;
-    std::uint64_t opus_codec_delay;
-    std::uint64_t av1_codec_delay;
-    std::vector<Sav1CuePoint> cue_points;
-    std::uint64_t last_cluster_location;
-    bool all_cue_points;
-    bool skip_clusters;
-    bool is_key_frame;
+    Sav1Demuxer *demuxer;
+    WebMFramePool *frame_pool;
+    std::uint64_t first_frame_location;
+    std::vector<Sav1KeyFrame> key_frames;
+    bool seek_found_key_frame;
+    std::uint64_t last_timecode;
+    std::uint64_t last_key_frame_timecode;
+    std::uint64_t frame_duration;
 };
 
 typedef struct ParseInternalState {
-    FileReader *reader;
+    Sav1Reader *reader;
     WebmParser *parser;
     Sav1Callback *callback;
-    FILE *file;
+    Sav1DemuxFeeder *demux_feeder;  // set instead of using the parser for IVF and OBUs
+    WebMFramePool *frame_pool;
+    Sav1FileStamp file_stamp;
+    bool use_index_cache;
+    std::uint64_t cached_indexed_timecode;
+    std::size_t num_cached_cue_points;
+    bool can_reopen;
+    thread_timer_t follow_timer;
+    Sav1ChapterList chapter_list;
+    Sav1AudioTrackList audio_track_list;
+    Sav1VideoTrackList video_track_list;
+    thread_atomic_int_t do_index;
+    thread_atomic_int_t finished_indexing;
+    thread_atomic_int_t has_background_index;
+    thread_mutex_t background_index_lock;
+    Sav1ParseIndex *background_index;
 } ParseInternalState;
 
+void
+parse_adopt_background_index(ParseInternalState *state)
+{
+    // take over the index once the background thread has finished building it
+    if (!thread_atomic_int_load(&(state->has_background_index))) {
+        return;
+    }
+    thread_mutex_lock(&(state->background_index_lock));
+    Sav1ParseIndex *index = state->background_index;
+    state->background_index = nullptr;
+    thread_atomic_int_store(&(state->has_background_index), 0);
+    thread_mutex_unlock(&(state->background_index_lock));
+
+    if (index != nullptr) {
+        state->callback->set_index(*index);
+        delete index;
+    }
+}
+
+Sav1Reader *
+parse_open_reader(Sav1Settings *settings)
+{
+    if (settings->file_buffer != NULL) {
+        return parse_reader_open_buffer(settings->file_buffer,
+                                        settings->file_buffer_size);
+    }
+
+    // running out of a file that's still being written means waiting for more of it
+    bool do_follow = settings->on_file_end == SAV1_FILE_END_FOLLOW;
+    Sav1Reader *reader;
+    if (settings->io.read != NULL) {
+        reader = parse_reader_open_io(settings->io, settings->read_ahead_size);
+    }
+    else {
+        reader = parse_reader_open_file(settings->file_path, settings->file_read_mode,
+                                        settings->prefetch_chunk_size, do_follow);
+    }
+    if (reader != nullptr && do_follow) {
+        reader->set_follow(true);
+    }
+    return reader;
+}
+
+void
+parse_read_cues_and_chapters(ParseContext *context)
+{
+    ParseInternalState *state = (ParseInternalState *)context->internal_state;
+
+    // the index can only be read ahead of time if we can come back to the start
+    if (!state->reader->Seek(0).completed_ok()) {
+        return;
+    }
+
+    // read the headers, then jump to the Cues and Chapters if they're listed in the
+    // SeekHead but come after the clusters
+    bool want_cues = !state->callback->has_all_cue_points();
+    Sav1CueCallback callback(context->codec_target, &(state->chapter_list));
+    WebmParser parser;
+    parser.Feed(&callback, state->reader);
+    if (want_cues && callback.should_seek_to_cues() &&
+        state->reader->Seek(callback.get_cues_location()).completed_ok()) {
+        parser.DidSeek();
+        parser.Feed(&callback, state->reader);
+    }
+    if (callback.should_seek_to_chapters() &&
+        state->reader->Seek(callback.get_chapters_location()).completed_ok()) {
+        parser.DidSeek();
+        parser.Feed(&callback, state->reader);
+    }
+
+    std::vector<Sav1CuePoint> cue_points;
+    callback.get_cue_points(&cue_points);
+    if (want_cues && !cue_points.empty()) {
+        state->callback->set_cue_points(cue_points);
+    }
+
+    state->reader->Seek(0);
+}
+
 void
 parse_init(ParseContext **context, Sav1InternalContext *ctx,
            Sav1ThreadQueue *video_output_queue, Sav1ThreadQueue *audio_output_queue)
@@ -343,14 +1812,17 @@ parse_init(ParseContext **context, Sav1InternalContext *ctx,
     ParseInternalState *state = new ParseInternalState;
 
     // open the input file
-    state->file = std::fopen(ctx->settings->file_path, "rb");
-    if (state->file == NULL) {
+    state->reader = parse_open_reader(ctx->settings);
+    if (state->reader == nullptr) {
         sav1_set_error(ctx, "parse_init failed: input file does not exist");
         sav1_set_critical_error_flag(ctx);
-        state->reader = nullptr;
     }
-    else {
-        state->reader = new FileReader(state->file);
+
+    // frames are recycled through a pool so that parsing doesn't allocate for each one
+    if (webm_frame_pool_init(&(state->frame_pool), PARSE_FRAME_BUFFER_SIZE)) {
+        state->frame_pool = NULL;
+        sav1_set_error(ctx, "malloc() failed in parse_init()");
+        sav1_set_critical_error_flag(ctx);
     }
 
     // create the webmparser objects
@@ -361,11 +1833,21 @@ parse_init(ParseContext **context, Sav1InternalContext *ctx,
     ParseContext *parse_context = new ParseContext;
     *context = parse_context;
 
+    // IVF files and raw OBU streams are read by a demuxer instead
+    Sav1Demuxer *demuxer =
+        state->reader != nullptr ? parse_demux_open(state->reader) : nullptr;
+    state->demux_feeder = nullptr;
+    if (demuxer != nullptr) {
+        state->demux_feeder =
+            new Sav1DemuxFeeder(parse_context, demuxer, state->frame_pool);
+    }
+
     // populate the ParseContext
     parse_context->internal_state = (void *)state;
     parse_context->ctx = ctx;
     parse_context->codec_target = ctx->settings->codec_target;
     parse_context->on_file_end = ctx->settings->on_file_end;
+    parse_context->video_track_mode = ctx->settings->video_track_mode;
     parse_context->video_output_queue = video_output_queue;
     parse_context->audio_output_queue = audio_output_queue;
     parse_context->duration_lock = new thread_mutex_t;
@@ -376,6 +1858,8 @@ parse_init(ParseContext **context, Sav1InternalContext *ctx,
     parse_context->duration = 0;
     parse_context->seek_timecode = 0;
     thread_atomic_int_store(&(parse_context->status), PARSE_STATUS_OK);
+    thread_atomic_int_store(&(parse_context->skip_to_key_frame), 0);
+    parse_context->skip_timecode = 0;
     thread_mutex_init(parse_context->duration_lock);
     thread_mutex_init(parse_context->wait_before_seek);
     thread_mutex_init(parse_context->wait_after_parse);
@@ -383,7 +1867,58 @@ parse_init(ParseContext **context, Sav1InternalContext *ctx,
     thread_mutex_init(parse_context->running);
 
     // initialize the callback class
-    state->callback->init(parse_context, state->reader);
+    thread_mutex_init(&(state->chapter_list.lock));
+    state->chapter_list.is_set = false;
+    thread_mutex_init(&(state->audio_track_list.lock));
+    state->audio_track_list.selected = 0;
+    state->audio_track_list.track_switches = 0;
+    state->audio_track_list.switch_timecode = 0;
+    thread_mutex_init(&(state->video_track_list.lock));
+    state->video_track_list.selected = 0;
+    state->video_track_list.active = 0;
+    state->video_track_list.track_switches = 0;
+    state->callback->init(parse_context, state->reader, state->frame_pool,
+                          &(state->chapter_list), &(state->audio_track_list),
+                          &(state->video_track_list));
+
+    // pick up where the last run left off if the file hasn't changed since
+    state->use_index_cache =
+        ctx->settings->index_cache_path != NULL && ctx->settings->file_buffer == NULL &&
+        ctx->settings->io.read == NULL && state->demux_feeder == nullptr &&
+        ctx->settings->on_file_end != SAV1_FILE_END_FOLLOW &&
+        parse_index_get_file_stamp(ctx->settings->file_path, parse_context->codec_target,
+                                   &(state->file_stamp));
+    state->cached_indexed_timecode = 0;
+    state->num_cached_cue_points = 0;
+    Sav1ParseIndex index;
+    if (state->use_index_cache &&
+        parse_index_load(ctx->settings->index_cache_path, state->file_stamp, &index)) {
+        state->callback->set_index(index);
+        state->cached_indexed_timecode = index.indexed_timecode;
+        state->num_cached_cue_points = index.cue_points.size();
+    }
+    bool index_is_cached = state->num_cached_cue_points > 0 && index.all_cue_points;
+
+    // read the Cues and Chapters now so that a background indexer is only started if
+    // the file's own Cues don't already cover it, but a file that's still being written
+    // doesn't have its Cues yet
+    if (state->reader != nullptr && state->demux_feeder == nullptr &&
+        ctx->settings->on_file_end != SAV1_FILE_END_FOLLOW) {
+        parse_read_cues_and_chapters(parse_context);
+    }
+
+    // the background indexer opens the input again, which doesn't work for pipes or
+    // custom input functions, and a file that's still growing can't be indexed ahead
+    state->can_reopen = state->reader != nullptr && state->demux_feeder == nullptr &&
+                        ctx->settings->io.read == NULL &&
+                        ctx->settings->on_file_end != SAV1_FILE_END_FOLLOW &&
+                        state->reader->Seek(0).completed_ok();
+    thread_atomic_int_store(&(state->do_index), 0);
+    thread_atomic_int_store(&(state->finished_indexing), index_is_cached ? 1 : 0);
+    thread_atomic_int_store(&(state->has_background_index), 0);
+    thread_mutex_init(&(state->background_index_lock));
+    state->background_index = nullptr;
+    thread_timer_init(&(state->follow_timer));
 }
 
 void
@@ -392,11 +1927,32 @@ parse_destroy(ParseContext *context)
     // clean up internal state
     ParseInternalState *state = (ParseInternalState *)context->internal_state;
 
+    // save the index if this run learned anything new about the file
+    parse_adopt_background_index(state);
+    if (state->use_index_cache) {
+        Sav1ParseIndex index;
+        state->callback->get_index(&index);
+        if (index.indexed_timecode > state->cached_indexed_timecode ||
+            index.cue_points.size() > state->num_cached_cue_points) {
+            parse_index_save(context->ctx->settings->index_cache_path,
+                             state->file_stamp, index);
+        }
+    }
+
     delete state->callback;
+    delete state->demux_feeder;
+    if (state->frame_pool != NULL) {
+        webm_frame_pool_destroy(state->frame_pool);
+    }
     if (state->reader != nullptr) {
         delete state->reader;
     }
     delete state->parser;
+    thread_mutex_term(&(state->background_index_lock));
+    thread_timer_term(&(state->follow_timer));
+    thread_mutex_term(&(state->chapter_list.lock));
+    thread_mutex_term(&(state->audio_track_list.lock));
+    thread_mutex_term(&(state->video_track_list.lock));
     delete state;
 
     thread_mutex_term(context->duration_lock);
@@ -414,28 +1970,53 @@ parse_destroy(ParseContext *context)
     delete context;
 }
 
+// read from wherever parsing last stopped, through the demuxer if there is one
+Status
+parse_feed(ParseInternalState *state)
+{
+    if (state->demux_feeder != nullptr) {
+        return state->demux_feeder->feed();
+    }
+    return state->parser->Feed(state->callback, state->reader);
+}
+
 int
 parse_start(void *context)
 {
     ParseContext *parse_context = (ParseContext *)context;
     ParseInternalState *state = (ParseInternalState *)parse_context->internal_state;
 
-    if (state->reader == nullptr) {
+    if (state->reader == nullptr || state->frame_pool == NULL) {
         return -1;
     }
 
     thread_atomic_int_store(&(parse_context->do_seek), 0);
     thread_mutex_lock(parse_context->running);
 
+    bool do_follow = parse_context->on_file_end == SAV1_FILE_END_FOLLOW;
+
     Status status;
     while (1) {
         thread_atomic_int_store(&(parse_context->do_parse), 1);
         thread_atomic_int_store(&(parse_context->status), PARSE_STATUS_OK);
-        status = state->parser->Feed(state->callback, state->reader);
+        status = parse_feed(state);
+
+        // poll for more of a growing file, letting out everything read so far first
+        while (do_follow && status.code == Status::kWouldBlock &&
+               thread_atomic_int_load(&(parse_context->do_parse))) {
+            if (!state->callback->flush_pending_frames()) {
+                break;
+            }
+            thread_timer_wait(&(state->follow_timer), PARSE_FOLLOW_POLL_INTERVAL);
+            if (!thread_atomic_int_load(&(parse_context->do_parse))) {
+                break;
+            }
+            status = parse_feed(state);
+        }
 
         // see if we should end the loop
         if (status.completed_ok()) {
-            thread_atomic_int_store(&(parse_context->status), PARSE_STATUS_END_OF_FILE);
+            state->callback->report_end_of_file();
 
             // it's possible that we didn't find what we were looking for when seeking
             if (thread_atomic_int_load(&(parse_context->do_parse)) &&
@@ -454,23 +2035,28 @@ parse_start(void *context)
 
             state->callback->mark_has_all_cue_points();
 
-            if (parse_context->on_file_end == SAV1_FILE_END_WAIT) {
+            if (parse_context->on_file_end != SAV1_FILE_END_LOOP) {
                 // wait until ThreadManager tells us to resume
                 thread_mutex_lock(parse_context->wait_to_acquire);
                 thread_mutex_lock(parse_context->wait_after_parse);
                 thread_mutex_unlock(parse_context->wait_after_parse);
                 thread_mutex_unlock(parse_context->wait_to_acquire);
             }
+            else if (state->demux_feeder != nullptr) {
+                state->demux_feeder->seek(0);
+                continue;
+            }
             else {
                 // seek back to the start
                 state->reader->Seek(0);
                 state->parser->DidSeek();
                 state->callback->set_skip_clusters(false);
+                state->callback->begin_seek(0, true);
                 continue;
             }
         }
 
-        if (status.code < 0) {
+        if (status.code < 0 && !(do_follow && status.code == Status::kWouldBlock)) {
             thread_atomic_int_store(&(parse_context->status), PARSE_STATUS_ERROR);
             break;
         }
@@ -478,24 +2064,58 @@ parse_start(void *context)
             break;
         }
 
+        // frames from before the seek are no longer wanted
+        state->callback->clear_pending_frames();
+
+        if (state->demux_feeder != nullptr) {
+            thread_mutex_lock(parse_context->wait_before_seek);
+            thread_mutex_unlock(parse_context->wait_before_seek);
+            state->demux_feeder->seek(parse_context->seek_timecode);
+            continue;
+        }
+
+        // start right at the nearest keyframe if we know where it is
+        parse_adopt_background_index(state);
+        std::uint64_t seek_location;
+        std::uint64_t block_location = 0;
+        bool skip_clusters = false;
+        bool continue_indexing = true;
+        const Sav1KeyFrame *key_frame =
+            state->callback->find_key_frame(parse_context->seek_timecode);
+        if (key_frame != nullptr) {
+            seek_location = key_frame->cluster_location;
+            block_location = key_frame->block_location;
+        }
+        else {
+            // otherwise find the last cue point at or before the seek point
+            const std::vector<Sav1CuePoint> &cue_points =
+                state->callback->get_cue_points();
+            auto cue = std::upper_bound(
+                cue_points.begin(), cue_points.end(), parse_context->seek_timecode,
+                [](std::uint64_t timecode, const Sav1CuePoint &cue) {
+                    return timecode < cue.timecode;
+                });
+            --cue;  // the first cue point is always at the start of the file
+            seek_location = cue->cluster_location;
+            skip_clusters =
+                !state->callback->has_all_cue_points() && cue + 1 == cue_points.end();
+            continue_indexing = state->callback->is_indexed(cue->timecode);
+        }
+
+        // start loading the new location while the rest of the pipeline drains
+        state->reader->prefetch(seek_location);
+
         // wait here until this mutex is unlocked
         thread_mutex_lock(parse_context->wait_before_seek);
         thread_mutex_unlock(parse_context->wait_before_seek);
 
-        // find the cue point to seek to
-        std::vector<Sav1CuePoint> cue_points = state->callback->get_cue_points();
-        for (auto cue = cue_points.rbegin(); cue != cue_points.rend(); ++cue) {
-            if (cue->timecode <= parse_context->seek_timecode) {
-                state->reader->Seek(cue->cluster_location);
-                state->parser->DidSeek();
-                bool skip_clusters =
-                    !state->callback->has_all_cue_points() && cue == cue_points.rbegin();
-                state->callback->set_skip_clusters(skip_clusters);
-                break;
-            }
-        }
+        state->reader->Seek(seek_location);
+        state->parser->DidSeek();
+        state->callback->set_skip_clusters(skip_clusters);
+        state->callback->begin_seek(block_location, continue_indexing);
     }
 
+    state->callback->clear_pending_frames();
     thread_mutex_unlock(parse_context->running);
     parse_stop(parse_context);
 
@@ -566,7 +2186,7 @@ int
 parse_found_av1_track(ParseContext *context)
 {
     ParseInternalState *state = (ParseInternalState *)context->internal_state;
-    return state->callback->found_av1_track() ? 1 : 0;
+    return state->demux_feeder != nullptr || state->callback->found_av1_track() ? 1 : 0;
 }
 
 int
@@ -576,10 +2196,256 @@ parse_found_opus_track(ParseContext *context)
     return state->callback->found_opus_track() ? 1 : 0;
 }
 
+size_t
+parse_get_num_chapters(ParseContext *context)
+{
+    ParseInternalState *state = (ParseInternalState *)context->internal_state;
+    thread_mutex_lock(&(state->chapter_list.lock));
+    size_t num_chapters = state->chapter_list.chapters.size();
+    thread_mutex_unlock(&(state->chapter_list.lock));
+    return num_chapters;
+}
+
+int
+parse_get_chapter(ParseContext *context, size_t index, uint64_t *start_time,
+                  uint64_t *end_time, const char **title)
+{
+    ParseInternalState *state = (ParseInternalState *)context->internal_state;
+    thread_mutex_lock(&(state->chapter_list.lock));
+    if (index >= state->chapter_list.chapters.size()) {
+        thread_mutex_unlock(&(state->chapter_list.lock));
+        return -1;
+    }
+    const Sav1ParseChapter &chapter = state->chapter_list.chapters[index];
+    *start_time = chapter.start_time;
+    *end_time = chapter.end_time;
+    *title = chapter.title.c_str();
+    thread_mutex_unlock(&(state->chapter_list.lock));
+    return 0;
+}
+
+int
+parse_find_chapter(ParseContext *context, uint64_t timecode, size_t *index)
+{
+    // find the last chapter that starts at or before the timecode
+    ParseInternalState *state = (ParseInternalState *)context->internal_state;
+    thread_mutex_lock(&(state->chapter_list.lock));
+    const std::vector<Sav1ParseChapter> &chapters = state->chapter_list.chapters;
+    auto chapter =
+        std::upper_bound(chapters.begin(), chapters.end(), timecode,
+                         [](std::uint64_t timecode, const Sav1ParseChapter &chapter) {
+                             return timecode < chapter.start_time;
+                         });
+    bool found = chapter != chapters.begin();
+    if (found) {
+        *index = (size_t)(chapter - chapters.begin()) - 1;
+    }
+    thread_mutex_unlock(&(state->chapter_list.lock));
+    return found ? 0 : -1;
+}
+
+size_t
+parse_get_num_audio_tracks(ParseContext *context)
+{
+    ParseInternalState *state = (ParseInternalState *)context->internal_state;
+    thread_mutex_lock(&(state->audio_track_list.lock));
+    size_t num_audio_tracks = state->audio_track_list.tracks.size();
+    thread_mutex_unlock(&(state->audio_track_list.lock));
+    return num_audio_tracks;
+}
+
+int
+parse_get_audio_track(ParseContext *context, size_t index, const char **language,
+                      const char **name)
+{
+    ParseInternalState *state = (ParseInternalState *)context->internal_state;
+    thread_mutex_lock(&(state->audio_track_list.lock));
+    if (index >= state->audio_track_list.tracks.size()) {
+        thread_mutex_unlock(&(state->audio_track_list.lock));
+        return -1;
+    }
+    const Sav1ParseAudioTrack &track = state->audio_track_list.tracks[index];
+    *language = track.language.c_str();
+    *name = track.name.c_str();
+    thread_mutex_unlock(&(state->audio_track_list.lock));
+    return 0;
+}
+
+size_t
+parse_get_selected_audio_track(ParseContext *context)
+{
+    ParseInternalState *state = (ParseInternalState *)context->internal_state;
+    thread_mutex_lock(&(state->audio_track_list.lock));
+    size_t selected = state->audio_track_list.selected;
+    thread_mutex_unlock(&(state->audio_track_list.lock));
+    return selected;
+}
+
+int
+parse_select_audio_track(ParseContext *context, size_t index, uint64_t timecode,
+                         int *track_switches)
+{
+    ParseInternalState *state = (ParseInternalState *)context->internal_state;
+    Sav1AudioTrackList *list = &(state->audio_track_list);
+    thread_mutex_lock(&(list->lock));
+    if (index >= list->tracks.size()) {
+        thread_mutex_unlock(&(list->lock));
+        return -1;
+    }
+    if (index != list->selected) {
+        list->selected = index;
+        list->track_switches++;
+        list->switch_timecode = timecode;
+    }
+    *track_switches = list->track_switches;
+    thread_mutex_unlock(&(list->lock));
+    return 0;
+}
+
+size_t
+parse_get_num_video_tracks(ParseContext *context)
+{
+    ParseInternalState *state = (ParseInternalState *)context->internal_state;
+    thread_mutex_lock(&(state->video_track_list.lock));
+    size_t num_video_tracks = state->video_track_list.tracks.size();
+    thread_mutex_unlock(&(state->video_track_list.lock));
+    return num_video_tracks;
+}
+
+int
+parse_get_video_track(ParseContext *context, size_t index, size_t *width, size_t *height,
+                      const char **name)
+{
+    ParseInternalState *state = (ParseInternalState *)context->internal_state;
+    thread_mutex_lock(&(state->video_track_list.lock));
+    if (index >= state->video_track_list.tracks.size()) {
+        thread_mutex_unlock(&(state->video_track_list.lock));
+        return -1;
+    }
+    const Sav1ParseVideoTrack &track = state->video_track_list.tracks[index];
+    *width = (size_t)track.width;
+    *height = (size_t)track.height;
+    *name = track.name.c_str();
+    thread_mutex_unlock(&(state->video_track_list.lock));
+    return 0;
+}
+
+size_t
+parse_get_selected_video_track(ParseContext *context)
+{
+    ParseInternalState *state = (ParseInternalState *)context->internal_state;
+    thread_mutex_lock(&(state->video_track_list.lock));
+    size_t selected = state->video_track_list.selected;
+    thread_mutex_unlock(&(state->video_track_list.lock));
+    return selected;
+}
+
+size_t
+parse_get_active_video_track(ParseContext *context)
+{
+    ParseInternalState *state = (ParseInternalState *)context->internal_state;
+    thread_mutex_lock(&(state->video_track_list.lock));
+    size_t active = state->video_track_list.active;
+    thread_mutex_unlock(&(state->video_track_list.lock));
+    return active;
+}
+
+int
+parse_select_video_track(ParseContext *context, size_t index)
+{
+    ParseInternalState *state = (ParseInternalState *)context->internal_state;
+    Sav1VideoTrackList *list = &(state->video_track_list);
+    thread_mutex_lock(&(list->lock));
+    if (index >= list->tracks.size()) {
+        thread_mutex_unlock(&(list->lock));
+        return -1;
+    }
+    if (index != list->selected) {
+        list->selected = index;
+        list->track_switches++;
+    }
+    thread_mutex_unlock(&(list->lock));
+    return 0;
+}
+
 void
 parse_seek_to_time(ParseContext *context, uint64_t timecode)
 {
-    thread_atomic_int_store(&(context->do_seek), context->codec_target);
+    // the parse thread reads the timecode as soon as it sees do_seek
     context->seek_timecode = timecode;
+    thread_atomic_int_store(&(context->skip_to_key_frame), 0);
+    thread_atomic_int_store(&(context->do_seek), context->codec_target);
     parse_stop(context);
 }
+
+void
+parse_skip_to_key_frame(ParseContext *context, uint64_t timecode)
+{
+    // the parse thread reads the timecode as soon as it sees skip_to_key_frame
+    context->skip_timecode = timecode;
+    thread_atomic_int_store(&(context->skip_to_key_frame), 1);
+}
+
+void
+parse_set_low_priority()
+{
+#ifdef _WIN32
+    SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_LOWEST);
+#elif defined(SCHED_IDLE)
+    struct sched_param param = {};
+    pthread_setschedparam(pthread_self(), SCHED_IDLE, &param);
+#endif
+}
+
+int
+parse_prepare_indexing(ParseContext *context)
+{
+    ParseInternalState *state = (ParseInternalState *)context->internal_state;
+
+    // there's nothing to do if the index is already complete or can't be built
+    if (!state->can_reopen || thread_atomic_int_load(&(state->finished_indexing)) ||
+        state->callback->has_all_cue_points()) {
+        return 0;
+    }
+    thread_atomic_int_store(&(state->do_index), 1);
+    return 1;
+}
+
+int
+parse_start_indexing(void *context)
+{
+    ParseContext *parse_context = (ParseContext *)context;
+    ParseInternalState *state = (ParseInternalState *)parse_context->internal_state;
+
+    parse_set_low_priority();
+
+    // use a separate reader so the playback parser's position is never disturbed
+    Sav1Reader *reader = parse_open_reader(parse_context->ctx->settings);
+    if (reader == nullptr) {
+        return 0;
+    }
+    Sav1IndexCallback callback(parse_context->codec_target, &(state->do_index));
+    WebmParser parser;
+    Status status = parser.Feed(&callback, reader);
+    delete reader;
+
+    // hand the finished index over to the playback parser
+    if (status.completed_ok()) {
+        thread_atomic_int_store(&(state->finished_indexing), 1);
+        Sav1ParseIndex *index = new Sav1ParseIndex(*callback.get_index());
+        thread_mutex_lock(&(state->background_index_lock));
+        delete state->background_index;
+        state->background_index = index;
+        thread_atomic_int_store(&(state->has_background_index), 1);
+        thread_mutex_unlock(&(state->background_index_lock));
+    }
+
+    return 0;
+}
+
+void
+parse_stop_indexing(ParseContext *context)
+{
+    ParseInternalState *state = (ParseInternalState *)context->internal_state;
+    thread_atomic_int_store(&(state->do_index), 0);
+}
@@ -18,15 +18,18 @@ typedef struct ParseContext {
     Sav1ThreadQueue *audio_output_queue;
     int codec_target;
     Sav1OnFileEnd on_file_end;
+    Sav1VideoTrackMode video_track_mode;
     thread_atomic_int_t status;
     thread_atomic_int_t do_parse;
     thread_atomic_int_t do_seek;
+    thread_atomic_int_t skip_to_key_frame;  // drop AV1 frames until the next keyframe
     thread_mutex_t *duration_lock;
     thread_mutex_t *wait_before_seek;
     thread_mutex_t *wait_after_parse;
     thread_mutex_t *wait_to_acquire;
     thread_mutex_t *running;
     uint64_t seek_timecode;
+    uint64_t skip_timecode;  // where playback was when it asked to skip to a keyframe
     uint64_t duration;
     void *internal_state;  // internal webm_parser variables
     Sav1InternalContext *ctx;
@@ -54,7 +57,74 @@ parse_found_av1_track(ParseContext *context);
 int
 parse_found_opus_track(ParseContext *context);
 
+size_t
+parse_get_num_chapters(ParseContext *context);
+
+// look up a chapter, returning < 0 if there's no chapter at index. the title stays
+// valid until the context is destroyed
+int
+parse_get_chapter(ParseContext *context, size_t index, uint64_t *start_time,
+                  uint64_t *end_time, const char **title);
+
+// find the chapter playing at timecode, returning < 0 if it comes before all of them
+int
+parse_find_chapter(ParseContext *context, uint64_t timecode, size_t *index);
+
+size_t
+parse_get_num_audio_tracks(ParseContext *context);
+
+// look up an Opus track, returning < 0 if there's no track at index. the strings stay
+// valid until the context is destroyed
+int
+parse_get_audio_track(ParseContext *context, size_t index, const char **language,
+                      const char **name);
+
+size_t
+parse_get_selected_audio_track(ParseContext *context);
+
+// switch to another Opus track, picking it up from timecode. track_switches is set to
+// the number of switches so far, which every audio frame parsed afterwards carries
+int
+parse_select_audio_track(ParseContext *context, size_t index, uint64_t timecode,
+                         int *track_switches);
+
+size_t
+parse_get_num_video_tracks(ParseContext *context);
+
+// look up an AV1 track, returning < 0 if there's no track at index. the name stays valid
+// until the context is destroyed
+int
+parse_get_video_track(ParseContext *context, size_t index, size_t *width, size_t *height,
+                      const char **name);
+
+size_t
+parse_get_selected_video_track(ParseContext *context);
+
+// the AV1 track being parsed, which only becomes the selected one at its next keyframe
+size_t
+parse_get_active_video_track(ParseContext *context);
+
+int
+parse_select_video_track(ParseContext *context, size_t index);
+
 void
 parse_seek_to_time(ParseContext *context, uint64_t timecode);
 
+// leave out every AV1 frame up to the next keyframe, for when playback is too far
+// behind real time to catch up otherwise. nothing is left out if a keyframe after
+// the given timecode has already been sent on
+void
+parse_skip_to_key_frame(ParseContext *context, uint64_t timecode);
+
+// returns 1 if a background indexer would learn something new about the file, and arms
+// it so that it can be stopped at any point after this returns
+int
+parse_prepare_indexing(ParseContext *context);
+
+int
+parse_start_indexing(void *context);
+
+void
+parse_stop_indexing(ParseContext *context);
+
 #endif
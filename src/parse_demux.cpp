@@ -0,0 +1,477 @@
+#include <cstring>
+
+#include "parse_demux.h"
+
+extern "C" {
+#include "av1_obu.h"
+}
+
+using namespace webm;
+
+#define IVF_FILE_HEADER_SIZE 32
+#define IVF_FRAME_HEADER_SIZE 12
+
+#define OBU_TEMPORAL_DELIMITER 2
+
+// how many bytes it takes to recognize each format
+#define PARSE_DEMUX_PEEK_SIZE 16
+
+static std::uint32_t
+read_le32(const std::uint8_t *data)
+{
+    return (std::uint32_t)data[0] | ((std::uint32_t)data[1] << 8) |
+           ((std::uint32_t)data[2] << 16) | ((std::uint32_t)data[3] << 24);
+}
+
+static std::uint64_t
+read_le64(const std::uint8_t *data)
+{
+    return (std::uint64_t)read_le32(data) | ((std::uint64_t)read_le32(data + 4) << 32);
+}
+
+// read a leb128 value from memory, returning the number of bytes it took or 0 if it
+// doesn't fit in size bytes
+static std::size_t
+decode_leb128(const std::uint8_t *data, std::size_t size, std::uint64_t *value)
+{
+    *value = 0;
+    for (std::size_t i = 0; i < size && i < 8; i++) {
+        *value |= (std::uint64_t)(data[i] & 0x7f) << (i * 7);
+        if (!(data[i] & 0x80)) {
+            return i + 1;
+        }
+    }
+    return 0;
+}
+
+static void
+encode_leb128(std::vector<std::uint8_t> *data, std::uint64_t value)
+{
+    do {
+        std::uint8_t byte = value & 0x7f;
+        value >>= 7;
+        data->push_back(value != 0 ? (byte | 0x80) : byte);
+    } while (value != 0);
+}
+
+Status
+Sav1Demuxer::read_fully(std::uint8_t *buffer, std::size_t size)
+{
+    std::size_t total_read = 0;
+    while (total_read < size) {
+        std::uint64_t num_read;
+        Status status = this->reader->Read(size - total_read, buffer + total_read,
+                                           &num_read);
+        total_read += (std::size_t)num_read;
+        if (status.code == Status::kWouldBlock) {
+            return status;
+        }
+        if (status.code == Status::kEndOfFile) {
+            return Status(Status::kEndOfFile);
+        }
+        if (status.code != Status::kOkCompleted && status.code != Status::kOkPartial) {
+            return status;
+        }
+    }
+    return Status(Status::kOkCompleted);
+}
+
+Status
+Sav1Demuxer::read_frame_data(WebMFramePool *pool, std::uint64_t position,
+                             std::size_t size, WebMFrame **frame)
+{
+    // frames of an input in memory point straight into it
+    const std::uint8_t *data = this->reader->get_data(position, size);
+    if (data != nullptr) {
+        if (webm_frame_pool_get_borrowed(pool, frame, data, size)) {
+            return Status(Status::kNotEnoughMemory);
+        }
+        if (this->reader->Seek(position + size).completed_ok()) {
+            return Status(Status::kOkCompleted);
+        }
+        webm_frame_destroy(*frame);
+        return Status(Status::kEndOfFile);
+    }
+
+    if (webm_frame_pool_get(pool, frame, size)) {
+        return Status(Status::kNotEnoughMemory);
+    }
+    Status status = this->read_fully((*frame)->data, size);
+    if (!status.completed_ok()) {
+        webm_frame_destroy(*frame);
+    }
+    return status;
+}
+
+Sav1IvfDemuxer::Sav1IvfDemuxer(Sav1Reader *reader)
+    : Sav1Demuxer(reader), timebase_numerator(1), timebase_denominator(1000)
+{
+}
+
+bool
+Sav1IvfDemuxer::open()
+{
+    std::uint8_t header[IVF_FILE_HEADER_SIZE];
+    if (!this->reader->Seek(0).completed_ok() ||
+        !this->read_fully(header, IVF_FILE_HEADER_SIZE).completed_ok() ||
+        std::memcmp(header, "DKIF", 4) != 0 || std::memcmp(header + 8, "AV01", 4) != 0) {
+        return false;
+    }
+
+    // the timebase is stored as frame rate and scale, so it's scale / rate seconds
+    std::uint32_t rate = read_le32(header + 16);
+    std::uint32_t scale = read_le32(header + 20);
+    if (rate != 0 && scale != 0) {
+        this->timebase_numerator = scale;
+        this->timebase_denominator = rate;
+    }
+
+    // the frames start after however long the header says it is
+    std::uint16_t header_size = (std::uint16_t)(header[6] | (header[7] << 8));
+    if (header_size < IVF_FILE_HEADER_SIZE) {
+        header_size = IVF_FILE_HEADER_SIZE;
+    }
+    return this->reader->Seek(header_size).completed_ok();
+}
+
+Status
+Sav1IvfDemuxer::read_frame(WebMFramePool *pool, WebMFrame **frame)
+{
+    // each frame has a 4 byte size and an 8 byte timestamp in front of it
+    std::uint64_t frame_start = this->reader->Position();
+    std::uint8_t header[IVF_FRAME_HEADER_SIZE];
+    Status status = this->read_fully(header, IVF_FRAME_HEADER_SIZE);
+    if (status.completed_ok()) {
+        status = this->read_frame_data(pool, frame_start + IVF_FRAME_HEADER_SIZE,
+                                       read_le32(header), frame);
+    }
+    if (!status.completed_ok()) {
+        // start the frame over once more of a growing file has been written
+        if (status.code == Status::kWouldBlock) {
+            this->reader->Seek(frame_start);
+        }
+        return status;
+    }
+
+    std::uint64_t timestamp = read_le64(header + 4);
+    (*frame)->timecode = (std::uint64_t)((double)timestamp * this->timebase_numerator *
+                                         1000.0 / this->timebase_denominator);
+    return status;
+}
+
+Status
+Sav1IvfDemuxer::seek(std::uint64_t position, std::uint64_t)
+{
+    return this->reader->Seek(position);
+}
+
+Sav1ObuDemuxer::Sav1ObuDemuxer(Sav1Reader *reader)
+    : Sav1Demuxer(reader), is_annexb(false), frame_number(0), frame_rate(0)
+{
+}
+
+bool
+Sav1ObuDemuxer::open()
+{
+    std::uint8_t header[PARSE_DEMUX_PEEK_SIZE];
+    if (!this->reader->Seek(0).completed_ok() ||
+        !this->read_fully(header, PARSE_DEMUX_PEEK_SIZE).completed_ok() ||
+        !this->reader->Seek(0).completed_ok()) {
+        return false;
+    }
+
+    // a low overhead stream starts with a temporal delimiter that has a size field
+    if ((header[0] & 0xfa) == (OBU_TEMPORAL_DELIMITER << 3 | 0x02) &&
+        header[(header[0] >> 2) & 1 ? 2 : 1] == 0) {
+        this->is_annexb = false;
+        return true;
+    }
+
+    // an Annex B stream starts with the sizes of the temporal unit, the frame unit and
+    // the OBU, followed by a temporal delimiter with nothing in it
+    std::uint64_t unit_size, frame_unit_size, obu_length;
+    std::size_t position = decode_leb128(header, PARSE_DEMUX_PEEK_SIZE, &unit_size);
+    std::size_t num_bytes;
+    if (position == 0 ||
+        (num_bytes = decode_leb128(header + position, PARSE_DEMUX_PEEK_SIZE - position,
+                                 &frame_unit_size)) == 0) {
+        return false;
+    }
+    position += num_bytes;
+    if ((num_bytes = decode_leb128(header + position, PARSE_DEMUX_PEEK_SIZE - position,
+                                 &obu_length)) == 0) {
+        return false;
+    }
+    position += num_bytes;
+    this->is_annexb = frame_unit_size <= unit_size && obu_length <= frame_unit_size &&
+                      position < PARSE_DEMUX_PEEK_SIZE &&
+                      ((header[position] >> 3) & 0x0f) == OBU_TEMPORAL_DELIMITER &&
+                      obu_length == 1 + (std::uint64_t)((header[position] >> 2) & 1) +
+                                        (std::uint64_t)((header[position] >> 1) & 1);
+    return this->is_annexb;
+}
+
+Status
+Sav1ObuDemuxer::read_frame(WebMFramePool *pool, WebMFrame **frame)
+{
+    std::uint64_t unit_start = this->get_position();
+    Status status = this->is_annexb ? this->read_annexb_unit(pool, frame)
+                                    : this->read_section5_unit(pool, frame);
+    if (!status.completed_ok()) {
+        // start the unit over once more of a growing file has been written
+        if (status.code == Status::kWouldBlock) {
+            this->next_delimiter.clear();
+            this->reader->Seek(unit_start);
+        }
+        return status;
+    }
+
+    // time frames by the sequence header, which comes with the first keyframe
+    if (this->frame_rate == 0 &&
+        av1_obu_get_frame_rate((*frame)->data, (*frame)->size, &(this->frame_rate))) {
+        this->frame_rate = PARSE_DEMUX_DEFAULT_FRAME_RATE;
+    }
+    (*frame)->timecode =
+        (std::uint64_t)((double)this->frame_number * 1000.0 / this->frame_rate);
+    this->frame_number++;
+    return status;
+}
+
+std::uint64_t
+Sav1ObuDemuxer::get_position() const
+{
+    // the temporal delimiter that ended the last unit has already been read
+    return this->reader->Position() - this->next_delimiter.size();
+}
+
+Status
+Sav1ObuDemuxer::seek(std::uint64_t position, std::uint64_t timecode)
+{
+    this->next_delimiter.clear();
+    if (this->frame_rate > 0) {
+        this->frame_number =
+            (std::uint64_t)((double)timecode * this->frame_rate / 1000.0 + 0.5);
+    }
+    return this->reader->Seek(position);
+}
+
+Status
+Sav1ObuDemuxer::read_obu_header(int *obu_type, std::uint64_t *obu_size,
+                                std::vector<std::uint8_t> *header)
+{
+    // obu_header(), then the extension byte and the leb128 size if there are any
+    std::uint8_t byte;
+    Status status = this->read_fully(&byte, 1);
+    if (!status.completed_ok()) {
+        return status;
+    }
+    header->push_back(byte);
+    *obu_type = (byte >> 3) & 0x0f;
+    if ((byte >> 2) & 1) {
+        if (!(status = this->read_fully(&byte, 1)).completed_ok()) {
+            return status.code == Status::kEndOfFile ? Status(Status::kInvalidElementSize)
+                                                     : status;
+        }
+        header->push_back(byte);
+    }
+    if (!((header->front() >> 1) & 1)) {
+        // every OBU in a low overhead stream has to say how big it is
+        return Status(Status::kInvalidElementValue);
+    }
+    *obu_size = 0;
+    for (int i = 0; i < 8; i++) {
+        if (!(status = this->read_fully(&byte, 1)).completed_ok()) {
+            return status.code == Status::kEndOfFile ? Status(Status::kInvalidElementSize)
+                                                     : status;
+        }
+        header->push_back(byte);
+        *obu_size |= (std::uint64_t)(byte & 0x7f) << (i * 7);
+        if (!(byte & 0x80)) {
+            return Status(Status::kOkCompleted);
+        }
+    }
+    return Status(Status::kInvalidElementSize);
+}
+
+Status
+Sav1ObuDemuxer::read_section5_unit(WebMFramePool *pool, WebMFrame **frame)
+{
+    // the unit starts with the temporal delimiter that ended the last one
+    std::uint64_t unit_start = this->get_position();
+    this->unit.assign(this->next_delimiter.begin(), this->next_delimiter.end());
+    this->next_delimiter.clear();
+
+    // an input in memory only has to be scanned for where the unit ends, otherwise the
+    // unit is copied out as it's read
+    bool is_in_memory = this->reader->get_data(unit_start, 0) != nullptr;
+    std::uint64_t unit_size = this->unit.size();
+    while (1) {
+        int obu_type;
+        std::uint64_t obu_size;
+        std::vector<std::uint8_t> header;
+        Status status = this->read_obu_header(&obu_type, &obu_size, &header);
+        if (status.code == Status::kEndOfFile && header.empty() && unit_size > 0) {
+            break;
+        }
+        if (!status.completed_ok()) {
+            return status;
+        }
+
+        // the next temporal delimiter belongs to the next unit
+        if (obu_type == OBU_TEMPORAL_DELIMITER && unit_size > 0) {
+            if (obu_size > 0) {
+                return Status(Status::kInvalidElementValue);
+            }
+            this->next_delimiter = header;
+            break;
+        }
+
+        unit_size += header.size() + obu_size;
+        if (is_in_memory) {
+            if (obu_size > 0) {
+                std::uint64_t num_skipped;
+                status = this->reader->Skip(obu_size, &num_skipped);
+                if (status.code != Status::kOkCompleted) {
+                    return Status(Status::kEndOfFile);
+                }
+            }
+        }
+        else {
+            std::size_t header_end = this->unit.size();
+            this->unit.insert(this->unit.end(), header.begin(), header.end());
+            this->unit.resize(header_end + header.size() + (std::size_t)obu_size);
+            status = this->read_fully(this->unit.data() + header_end + header.size(),
+                                      (std::size_t)obu_size);
+            if (!status.completed_ok()) {
+                return status;
+            }
+        }
+    }
+
+    if (is_in_memory) {
+        // read_frame_data leaves the reader after the unit, so step past the delimiter
+        // again afterwards
+        std::uint64_t next_position = this->reader->Position();
+        Status status =
+            this->read_frame_data(pool, unit_start, (std::size_t)unit_size, frame);
+        this->reader->Seek(next_position);
+        return status;
+    }
+    if (webm_frame_pool_get(pool, frame, this->unit.size())) {
+        return Status(Status::kNotEnoughMemory);
+    }
+    std::memcpy((*frame)->data, this->unit.data(), this->unit.size());
+    return Status(Status::kOkCompleted);
+}
+
+Status
+Sav1ObuDemuxer::read_leb128(std::uint64_t *value)
+{
+    *value = 0;
+    for (int i = 0; i < 8; i++) {
+        std::uint8_t byte;
+        Status status = this->read_fully(&byte, 1);
+        if (!status.completed_ok()) {
+            return status.code == Status::kEndOfFile && i > 0
+                       ? Status(Status::kInvalidElementSize)
+                       : status;
+        }
+        *value |= (std::uint64_t)(byte & 0x7f) << (i * 7);
+        if (!(byte & 0x80)) {
+            return Status(Status::kOkCompleted);
+        }
+    }
+    return Status(Status::kInvalidElementSize);
+}
+
+Status
+Sav1ObuDemuxer::read_annexb_unit(WebMFramePool *pool, WebMFrame **frame)
+{
+    std::uint64_t unit_size;
+    Status status = this->read_leb128(&unit_size);
+    if (!status.completed_ok()) {
+        return status;
+    }
+    std::vector<std::uint8_t> input((std::size_t)unit_size);
+    if (unit_size > 0 && !(status = this->read_fully(input.data(), input.size()))
+                              .completed_ok()) {
+        return status.code == Status::kEndOfFile ? Status(Status::kInvalidElementSize)
+                                                 : status;
+    }
+
+    // every frame unit is a list of OBUs with their lengths in front, which become
+    // size fields in the OBU headers instead
+    this->unit.clear();
+    std::size_t position = 0;
+    while (position < input.size()) {
+        std::uint64_t frame_unit_size;
+        std::size_t num_bytes = decode_leb128(input.data() + position,
+                                              input.size() - position, &frame_unit_size);
+        if (num_bytes == 0 || frame_unit_size > input.size() - position - num_bytes) {
+            return Status(Status::kInvalidElementSize);
+        }
+        position += num_bytes;
+        std::size_t frame_unit_end = position + (std::size_t)frame_unit_size;
+        while (position < frame_unit_end) {
+            std::uint64_t obu_length;
+            num_bytes = decode_leb128(input.data() + position, frame_unit_end - position,
+                                      &obu_length);
+            if (num_bytes == 0 || obu_length == 0 ||
+                obu_length > frame_unit_end - position - num_bytes) {
+                return Status(Status::kInvalidElementSize);
+            }
+            position += num_bytes;
+            const std::uint8_t *obu = input.data() + position;
+            std::size_t header_size = 1 + ((obu[0] >> 2) & 1);
+            if (header_size > obu_length) {
+                return Status(Status::kInvalidElementSize);
+            }
+            if ((obu[0] >> 1) & 1) {
+                // the OBU already has a size field
+                this->unit.insert(this->unit.end(), obu, obu + obu_length);
+            }
+            else {
+                this->unit.push_back(obu[0] | 0x02);
+                this->unit.insert(this->unit.end(), obu + 1, obu + header_size);
+                encode_leb128(&(this->unit), obu_length - header_size);
+                this->unit.insert(this->unit.end(), obu + header_size, obu + obu_length);
+            }
+            position += (std::size_t)obu_length;
+        }
+    }
+
+    if (webm_frame_pool_get(pool, frame, this->unit.size())) {
+        return Status(Status::kNotEnoughMemory);
+    }
+    std::memcpy((*frame)->data, this->unit.data(), this->unit.size());
+    return Status(Status::kOkCompleted);
+}
+
+Sav1Demuxer *
+parse_demux_open(Sav1Reader *reader)
+{
+    // WebM files start with the EBML magic number, so leave those to libwebm without
+    // reading any further
+    std::uint8_t magic[4];
+    std::uint64_t num_read;
+    Status status = reader->Read(4, magic, &num_read);
+    reader->Seek(0);
+    if (status.code != Status::kOkCompleted ||
+        (magic[0] == 0x1a && magic[1] == 0x45 && magic[2] == 0xdf && magic[3] == 0xa3)) {
+        return nullptr;
+    }
+
+    Sav1Demuxer *demuxer = nullptr;
+    if (std::memcmp(magic, "DKIF", 4) == 0) {
+        demuxer = new Sav1IvfDemuxer(reader);
+    }
+    else {
+        demuxer = new Sav1ObuDemuxer(reader);
+    }
+    if (!demuxer->open()) {
+        delete demuxer;
+        reader->Seek(0);
+        return nullptr;
+    }
+    return demuxer;
+}
@@ -0,0 +1,140 @@
+#ifndef PARSE_DEMUX_H
+#define PARSE_DEMUX_H
+
+#include <cstdint>
+#include <vector>
+#include <webm/status.h>
+
+#include "parse_reader.h"
+
+extern "C" {
+#include "webm_frame.h"
+}
+
+// the frame rate to time raw OBU streams by when their sequence header doesn't say
+#define PARSE_DEMUX_DEFAULT_FRAME_RATE 30.0
+
+// reads AV1 temporal units out of a container that only holds video, as a far
+// cheaper alternative to the WebM parser. every frame holds one temporal unit in the
+// low overhead bitstream format that dav1d takes
+class Sav1Demuxer {
+   public:
+    explicit Sav1Demuxer(Sav1Reader *reader) : reader(reader)
+    {
+    }
+
+    virtual ~Sav1Demuxer() = default;
+
+    Sav1Demuxer(const Sav1Demuxer &) = delete;
+    Sav1Demuxer &
+    operator=(const Sav1Demuxer &) = delete;
+
+    // read the container's header, returning false if the input isn't in this format.
+    // leaves the reader at the first frame
+    virtual bool
+    open() = 0;
+
+    // read the next temporal unit into a frame from pool, filling in its data and
+    // timecode. returns kEndOfFile once there are no frames left, and kWouldBlock if
+    // a file that's still being written ends partway through a frame
+    virtual webm::Status
+    read_frame(WebMFramePool *pool, WebMFrame **frame) = 0;
+
+    // the position of the next frame to be read, which seek can come back to
+    virtual std::uint64_t
+    get_position() const
+    {
+        return this->reader->Position();
+    }
+
+    // continue reading from a position given by get_position, where the frame has the
+    // given timecode
+    virtual webm::Status
+    seek(std::uint64_t position, std::uint64_t timecode) = 0;
+
+   protected:
+    // read exactly size bytes, returning kEndOfFile if the input ends first. partly
+    // read data is reported as kWouldBlock when following a growing file
+    webm::Status
+    read_fully(std::uint8_t *buffer, std::size_t size);
+
+    // put size bytes at position into a frame from pool, borrowing them when the input
+    // is in memory, and leave the reader after them
+    webm::Status
+    read_frame_data(WebMFramePool *pool, std::uint64_t position, std::size_t size,
+                    WebMFrame **frame);
+
+    Sav1Reader *reader;
+};
+
+// reads the AV1 frames of an IVF file, as written by most AV1 encoders
+class Sav1IvfDemuxer : public Sav1Demuxer {
+   public:
+    explicit Sav1IvfDemuxer(Sav1Reader *reader);
+
+    bool
+    open() override;
+
+    webm::Status
+    read_frame(WebMFramePool *pool, WebMFrame **frame) override;
+
+    webm::Status
+    seek(std::uint64_t position, std::uint64_t timecode) override;
+
+   private:
+    std::uint32_t timebase_numerator;
+    std::uint32_t timebase_denominator;
+};
+
+// reads a raw stream of OBUs, either in the low overhead bitstream format of section 5
+// of the AV1 spec or in the length delimited format of its Annex B. raw streams have
+// no timestamps, so frames are timed by the frame rate in the sequence header
+class Sav1ObuDemuxer : public Sav1Demuxer {
+   public:
+    explicit Sav1ObuDemuxer(Sav1Reader *reader);
+
+    bool
+    open() override;
+
+    webm::Status
+    read_frame(WebMFramePool *pool, WebMFrame **frame) override;
+
+    std::uint64_t
+    get_position() const override;
+
+    webm::Status
+    seek(std::uint64_t position, std::uint64_t timecode) override;
+
+   private:
+    // read the header and size of the next OBU, appending the header bytes to
+    // header if it isn't null
+    webm::Status
+    read_obu_header(int *obu_type, std::uint64_t *obu_size,
+                    std::vector<std::uint8_t> *header);
+
+    // read a temporal unit of the low overhead format, which runs up to the next
+    // temporal delimiter
+    webm::Status
+    read_section5_unit(WebMFramePool *pool, WebMFrame **frame);
+
+    // read a temporal unit of Annex B, giving every OBU a size field on the way
+    webm::Status
+    read_annexb_unit(WebMFramePool *pool, WebMFrame **frame);
+
+    // read an Annex B leb128 value a byte at a time
+    webm::Status
+    read_leb128(std::uint64_t *value);
+
+    bool is_annexb;
+    std::uint64_t frame_number;
+    double frame_rate;  // 0 until a sequence header has been seen
+    std::vector<std::uint8_t> unit;
+    std::vector<std::uint8_t> next_delimiter;  // read while looking for a unit's end
+};
+
+// pick a demuxer for the input by its first few bytes, or return nullptr if it isn't
+// one of theirs and should go to the WebM parser. the reader is left at the start
+Sav1Demuxer *
+parse_demux_open(Sav1Reader *reader);
+
+#endif
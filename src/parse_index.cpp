@@ -0,0 +1,230 @@
+#include <cstdio>
+#include <cstring>
+#include <sys/stat.h>
+
+#include "parse_index.h"
+
+#define PARSE_INDEX_MAGIC "SAV1IDX"
+#define PARSE_INDEX_VERSION 2
+
+// smallest possible encoded entry, used to sanity check counts before reserving
+#define PARSE_INDEX_MIN_ENTRY_SIZE 2
+
+/*
+the cache is a small binary file made up of unsigned LEB128 varints:
+  magic, version, file size, file modification time, codec target,
+  timecode scale, duration, track numbers, codec delays,
+  cue point count, all cue points flag, then each cue point,
+  key frame count, indexed timecode, then each key frame
+cue points and key frames are sorted by timecode, so timecodes are stored as the
+difference from the previous entry and locations as zigzag encoded differences
+*/
+
+bool
+parse_index_get_file_stamp(const char *file_path, int codec_target,
+                           Sav1FileStamp *stamp)
+{
+    struct stat file_stat;
+    if (stat(file_path, &file_stat)) {
+        return false;
+    }
+    stamp->size = (std::uint64_t)file_stat.st_size;
+    stamp->modified_time = (std::uint64_t)file_stat.st_mtime;
+    stamp->codec_target = (std::uint64_t)codec_target;
+    return true;
+}
+
+void
+parse_index_write_varint(std::vector<std::uint8_t> &buffer, std::uint64_t value)
+{
+    while (value >= 0x80) {
+        buffer.push_back((std::uint8_t)(value | 0x80));
+        value >>= 7;
+    }
+    buffer.push_back((std::uint8_t)value);
+}
+
+void
+parse_index_write_delta(std::vector<std::uint8_t> &buffer, std::uint64_t previous,
+                        std::uint64_t value)
+{
+    // zigzag encode so that small backwards steps stay small too
+    std::int64_t delta = (std::int64_t)(value - previous);
+    parse_index_write_varint(buffer,
+                             ((std::uint64_t)delta << 1) ^ (std::uint64_t)(delta >> 63));
+}
+
+bool
+parse_index_read_varint(const std::uint8_t **data, const std::uint8_t *end,
+                        std::uint64_t *value)
+{
+    *value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (*data == end) {
+            return false;
+        }
+        std::uint8_t byte = *((*data)++);
+        *value |= (std::uint64_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool
+parse_index_read_delta(const std::uint8_t **data, const std::uint8_t *end,
+                       std::uint64_t previous, std::uint64_t *value)
+{
+    std::uint64_t encoded;
+    if (!parse_index_read_varint(data, end, &encoded)) {
+        return false;
+    }
+    std::uint64_t delta = (encoded >> 1) ^ (~(encoded & 1) + 1);
+    *value = previous + delta;
+    return true;
+}
+
+bool
+parse_index_load(const char *cache_path, const Sav1FileStamp &stamp,
+                 Sav1ParseIndex *index)
+{
+    // read the whole cache into memory
+    FILE *file = std::fopen(cache_path, "rb");
+    if (file == NULL) {
+        return false;
+    }
+    std::vector<std::uint8_t> buffer;
+    std::uint8_t chunk[4096];
+    std::size_t num_read;
+    while ((num_read = std::fread(chunk, 1, sizeof(chunk), file)) > 0) {
+        buffer.insert(buffer.end(), chunk, chunk + num_read);
+    }
+    std::fclose(file);
+
+    const std::size_t magic_size = sizeof(PARSE_INDEX_MAGIC) - 1;
+    if (buffer.size() < magic_size ||
+        std::memcmp(buffer.data(), PARSE_INDEX_MAGIC, magic_size)) {
+        return false;
+    }
+    const std::uint8_t *data = buffer.data() + magic_size;
+    const std::uint8_t *end = buffer.data() + buffer.size();
+
+    // make sure the cache matches this version of the file and the codecs in use
+    std::uint64_t version, size, modified_time, codec_target;
+    if (!parse_index_read_varint(&data, end, &version) ||
+        version != PARSE_INDEX_VERSION || !parse_index_read_varint(&data, end, &size) ||
+        !parse_index_read_varint(&data, end, &modified_time) ||
+        !parse_index_read_varint(&data, end, &codec_target) || size != stamp.size ||
+        modified_time != stamp.modified_time || codec_target != stamp.codec_target) {
+        return false;
+    }
+
+    // read the file information
+    Sav1ParseIndex loaded;
+    std::uint64_t num_cue_points, all_cue_points;
+    if (!parse_index_read_varint(&data, end, &loaded.timecode_scale) ||
+        !parse_index_read_varint(&data, end, &loaded.duration) ||
+        !parse_index_read_varint(&data, end, &loaded.av1_track_number) ||
+        !parse_index_read_varint(&data, end, &loaded.opus_track_number) ||
+        !parse_index_read_varint(&data, end, &loaded.av1_codec_delay) ||
+        !parse_index_read_varint(&data, end, &loaded.opus_codec_delay) ||
+        !parse_index_read_varint(&data, end, &num_cue_points) ||
+        !parse_index_read_varint(&data, end, &all_cue_points) ||
+        num_cue_points > (std::uint64_t)(end - data) / PARSE_INDEX_MIN_ENTRY_SIZE) {
+        return false;
+    }
+    loaded.all_cue_points = all_cue_points != 0;
+
+    // read the cue points
+    Sav1CuePoint cue = {0, 0};
+    loaded.cue_points.reserve(num_cue_points);
+    for (std::uint64_t i = 0; i < num_cue_points; i++) {
+        std::uint64_t timecode_delta;
+        if (!parse_index_read_varint(&data, end, &timecode_delta) ||
+            !parse_index_read_delta(&data, end, cue.cluster_location,
+                                    &cue.cluster_location)) {
+            return false;
+        }
+        cue.timecode += timecode_delta;
+        loaded.cue_points.push_back(cue);
+    }
+
+    // read the key frames
+    std::uint64_t num_key_frames;
+    if (!parse_index_read_varint(&data, end, &num_key_frames) ||
+        !parse_index_read_varint(&data, end, &loaded.indexed_timecode) ||
+        num_key_frames > (std::uint64_t)(end - data) / PARSE_INDEX_MIN_ENTRY_SIZE) {
+        return false;
+    }
+    Sav1KeyFrame key_frame = {0, 0, 0};
+    loaded.key_frames.reserve(num_key_frames);
+    for (std::uint64_t i = 0; i < num_key_frames; i++) {
+        std::uint64_t timecode_delta, block_offset;
+        if (!parse_index_read_varint(&data, end, &timecode_delta) ||
+            !parse_index_read_delta(&data, end, key_frame.cluster_location,
+                                    &key_frame.cluster_location) ||
+            !parse_index_read_varint(&data, end, &block_offset)) {
+            return false;
+        }
+        key_frame.timecode += timecode_delta;
+        key_frame.block_location = key_frame.cluster_location + block_offset;
+        loaded.key_frames.push_back(key_frame);
+    }
+
+    *index = loaded;
+    return true;
+}
+
+bool
+parse_index_save(const char *cache_path, const Sav1FileStamp &stamp,
+                 const Sav1ParseIndex &index)
+{
+    std::vector<std::uint8_t> buffer(PARSE_INDEX_MAGIC,
+                                     PARSE_INDEX_MAGIC + sizeof(PARSE_INDEX_MAGIC) - 1);
+
+    // write the file information
+    parse_index_write_varint(buffer, PARSE_INDEX_VERSION);
+    parse_index_write_varint(buffer, stamp.size);
+    parse_index_write_varint(buffer, stamp.modified_time);
+    parse_index_write_varint(buffer, stamp.codec_target);
+    parse_index_write_varint(buffer, index.timecode_scale);
+    parse_index_write_varint(buffer, index.duration);
+    parse_index_write_varint(buffer, index.av1_track_number);
+    parse_index_write_varint(buffer, index.opus_track_number);
+    parse_index_write_varint(buffer, index.av1_codec_delay);
+    parse_index_write_varint(buffer, index.opus_codec_delay);
+
+    // write the cue points
+    parse_index_write_varint(buffer, index.cue_points.size());
+    parse_index_write_varint(buffer, index.all_cue_points ? 1 : 0);
+    Sav1CuePoint previous_cue = {0, 0};
+    for (const Sav1CuePoint &cue : index.cue_points) {
+        parse_index_write_varint(buffer, cue.timecode - previous_cue.timecode);
+        parse_index_write_delta(buffer, previous_cue.cluster_location,
+                                cue.cluster_location);
+        previous_cue = cue;
+    }
+
+    // write the key frames
+    parse_index_write_varint(buffer, index.key_frames.size());
+    parse_index_write_varint(buffer, index.indexed_timecode);
+    Sav1KeyFrame previous_key_frame = {0, 0, 0};
+    for (const Sav1KeyFrame &key_frame : index.key_frames) {
+        parse_index_write_varint(buffer,
+                                 key_frame.timecode - previous_key_frame.timecode);
+        parse_index_write_delta(buffer, previous_key_frame.cluster_location,
+                                key_frame.cluster_location);
+        parse_index_write_varint(buffer,
+                                 key_frame.block_location - key_frame.cluster_location);
+        previous_key_frame = key_frame;
+    }
+
+    FILE *file = std::fopen(cache_path, "wb");
+    if (file == NULL) {
+        return false;
+    }
+    bool success = std::fwrite(buffer.data(), 1, buffer.size(), file) == buffer.size();
+    success = std::fclose(file) == 0 && success;
+    return success;
+}
@@ -0,0 +1,56 @@
+#ifndef PARSE_INDEX_H
+#define PARSE_INDEX_H
+
+#include <cstdint>
+#include <vector>
+
+typedef struct Sav1CuePoint {
+    std::uint64_t timecode;
+    std::uint64_t cluster_location;
+} Sav1CuePoint;
+
+typedef struct Sav1KeyFrame {
+    std::uint64_t timecode;
+    std::uint64_t cluster_location;
+    std::uint64_t block_location;
+} Sav1KeyFrame;
+
+// everything the parser learns about a file that makes seeking and reopening faster
+typedef struct Sav1ParseIndex {
+    std::uint64_t timecode_scale;
+    std::uint64_t duration;
+    std::uint64_t av1_track_number;
+    std::uint64_t opus_track_number;
+    std::uint64_t av1_codec_delay;
+    std::uint64_t opus_codec_delay;
+    std::vector<Sav1CuePoint> cue_points;
+    bool all_cue_points;
+    std::vector<Sav1KeyFrame> key_frames;
+    std::uint64_t indexed_timecode;
+} Sav1ParseIndex;
+
+// identifies the exact version of an input file that an index was built from, and
+// which codecs its cue points and key frames were collected for
+typedef struct Sav1FileStamp {
+    std::uint64_t size;
+    std::uint64_t modified_time;
+    std::uint64_t codec_target;
+} Sav1FileStamp;
+
+// get the size and modification time of file_path, returning false on failure
+bool
+parse_index_get_file_stamp(const char *file_path, int codec_target,
+                           Sav1FileStamp *stamp);
+
+// read the index cached at cache_path, returning false if it's missing, corrupt or
+// was built from a different version of the file or for different codecs
+bool
+parse_index_load(const char *cache_path, const Sav1FileStamp &stamp,
+                 Sav1ParseIndex *index);
+
+// write the index to cache_path, returning false on failure
+bool
+parse_index_save(const char *cache_path, const Sav1FileStamp &stamp,
+                 const Sav1ParseIndex &index);
+
+#endif
@@ -0,0 +1,788 @@
+#include <cassert>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "parse_reader.h"
+
+// how much to ask the operating system to load ahead of a seek
+#define PARSE_PREFETCH_HINT_SIZE (2 * 1024 * 1024)
+
+// how long the threads wait on each other before checking again
+#define PARSE_PREFETCH_WAIT_MS 5
+
+using namespace webm;
+
+Sav1FileReader::Sav1FileReader(FILE *file) : file(file), reader(file)
+{
+}
+
+Status
+Sav1FileReader::follow_status(Status status)
+{
+    if (!this->is_following || status.code == Status::kOkCompleted) {
+        return status;
+    }
+
+    // stdio remembers hitting the end, but the end moves while the file is written
+    std::clearerr(this->file);
+    if (status.code == Status::kEndOfFile) {
+        return Status(Status::kWouldBlock);
+    }
+    return status;
+}
+
+Status
+Sav1FileReader::Read(std::size_t num_to_read, std::uint8_t *buffer,
+                     std::uint64_t *num_actually_read)
+{
+    return this->follow_status(this->reader.Read(num_to_read, buffer, num_actually_read));
+}
+
+Status
+Sav1FileReader::Skip(std::uint64_t num_to_skip, std::uint64_t *num_actually_skipped)
+{
+    return this->follow_status(this->reader.Skip(num_to_skip, num_actually_skipped));
+}
+
+Status
+Sav1FileReader::Seek(std::uint64_t seek_position)
+{
+    return this->reader.Seek(seek_position);
+}
+
+std::uint64_t
+Sav1FileReader::Position() const
+{
+    return this->reader.Position();
+}
+
+Sav1MmapReader::Sav1MmapReader()
+    : data(nullptr), size(0), position(0), is_mapped(false)
+{
+#ifdef _WIN32
+    this->file_handle = INVALID_HANDLE_VALUE;
+    this->mapping_handle = NULL;
+#endif
+}
+
+Sav1MmapReader::~Sav1MmapReader()
+{
+    this->close();
+}
+
+bool
+Sav1MmapReader::open(const char *file_path)
+{
+    this->close();
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(file_path, GENERIC_READ, FILE_SHARE_READ, NULL,
+                              OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0) {
+        CloseHandle(file);
+        return false;
+    }
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (mapping == NULL) {
+        CloseHandle(file);
+        return false;
+    }
+    void *view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (view == NULL) {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+    this->file_handle = file;
+    this->mapping_handle = mapping;
+    this->data = (const std::uint8_t *)view;
+    this->size = (std::uint64_t)file_size.QuadPart;
+#else
+    int fd = ::open(file_path, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) || !S_ISREG(file_stat.st_mode) || file_stat.st_size == 0) {
+        ::close(fd);
+        return false;
+    }
+    void *view = mmap(NULL, (size_t)file_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    // the mapping stays valid after the descriptor is closed
+    ::close(fd);
+    if (view == MAP_FAILED) {
+        return false;
+    }
+    this->data = (const std::uint8_t *)view;
+    this->size = (std::uint64_t)file_stat.st_size;
+#endif
+
+    this->position = 0;
+    this->is_mapped = true;
+    return true;
+}
+
+void
+Sav1MmapReader::open_buffer(const std::uint8_t *data, std::uint64_t size)
+{
+    this->close();
+
+    this->data = data;
+    this->size = size;
+    this->position = 0;
+    this->is_mapped = false;
+}
+
+void
+Sav1MmapReader::close()
+{
+    // buffers that weren't mapped here belong to the caller
+    if (this->data != nullptr && this->is_mapped) {
+#ifdef _WIN32
+        UnmapViewOfFile(this->data);
+        CloseHandle(this->mapping_handle);
+        CloseHandle(this->file_handle);
+        this->file_handle = INVALID_HANDLE_VALUE;
+        this->mapping_handle = NULL;
+#else
+        munmap((void *)this->data, (size_t)this->size);
+#endif
+    }
+    this->data = nullptr;
+    this->size = 0;
+    this->position = 0;
+    this->is_mapped = false;
+}
+
+Status
+Sav1MmapReader::Read(std::size_t num_to_read, std::uint8_t *buffer,
+                     std::uint64_t *num_actually_read)
+{
+    assert(num_to_read > 0);
+    assert(buffer != nullptr);
+    assert(num_actually_read != nullptr);
+
+    std::uint64_t available = this->size - this->position;
+    if (available == 0) {
+        *num_actually_read = 0;
+        return Status(Status::kEndOfFile);
+    }
+
+    std::uint64_t actual = num_to_read < available ? num_to_read : available;
+    std::memcpy(buffer, this->data + this->position, (std::size_t)actual);
+    this->position += actual;
+    *num_actually_read = actual;
+
+    return Status(actual == num_to_read ? Status::kOkCompleted : Status::kOkPartial);
+}
+
+Status
+Sav1MmapReader::Skip(std::uint64_t num_to_skip, std::uint64_t *num_actually_skipped)
+{
+    assert(num_to_skip > 0);
+    assert(num_actually_skipped != nullptr);
+
+    std::uint64_t available = this->size - this->position;
+    if (available == 0) {
+        *num_actually_skipped = 0;
+        return Status(Status::kEndOfFile);
+    }
+
+    std::uint64_t actual = num_to_skip < available ? num_to_skip : available;
+    this->position += actual;
+    *num_actually_skipped = actual;
+
+    return Status(actual == num_to_skip ? Status::kOkCompleted : Status::kOkPartial);
+}
+
+Status
+Sav1MmapReader::Seek(std::uint64_t seek_position)
+{
+    if (seek_position > this->size) {
+        return Status(Status::kSeekFailed);
+    }
+    this->position = seek_position;
+    return Status(Status::kOkCompleted);
+}
+
+std::uint64_t
+Sav1MmapReader::Position() const
+{
+    return this->position;
+}
+
+const std::uint8_t *
+Sav1MmapReader::get_data(std::uint64_t position, std::uint64_t size) const
+{
+    if (this->data == nullptr || position > this->size ||
+        size > this->size - position) {
+        return nullptr;
+    }
+    return this->data + position;
+}
+
+// where the input starts, treating a failed tell the same as one that isn't given
+std::uint64_t
+parse_reader_io_start(const Sav1IO &io)
+{
+    std::int64_t position = io.tell != NULL ? io.tell(io.cookie) : 0;
+    return position > 0 ? (std::uint64_t)position : 0;
+}
+
+Sav1IOReader::Sav1IOReader(const Sav1IO &io, std::size_t read_ahead_size)
+    : io(io),
+      buffer(read_ahead_size > 0 ? read_ahead_size : 1),
+      buffer_offset(0),
+      buffer_end(0),
+      position(parse_reader_io_start(io)),
+      size(io.get_size != NULL ? io.get_size(io.cookie) : -1),
+      reached_end(false)
+{
+}
+
+std::size_t
+Sav1IOReader::fill_buffer()
+{
+    if (this->buffer_offset < this->buffer_end) {
+        return this->buffer_end - this->buffer_offset;
+    }
+    this->buffer_offset = 0;
+    this->buffer_end = 0;
+    if (this->reached_end) {
+        return 0;
+    }
+
+    // errors are treated the same as reaching the end of the input
+    std::int64_t num_read = this->io.read(this->io.cookie, this->buffer.data(),
+                                          this->buffer.size());
+    if (num_read <= 0) {
+        this->reached_end = true;
+        return 0;
+    }
+    this->buffer_end = (std::size_t)num_read;
+    return this->buffer_end;
+}
+
+Status
+Sav1IOReader::Read(std::size_t num_to_read, std::uint8_t *buffer,
+                   std::uint64_t *num_actually_read)
+{
+    assert(num_to_read > 0);
+    assert(buffer != nullptr);
+    assert(num_actually_read != nullptr);
+
+    *num_actually_read = 0;
+    while (*num_actually_read < num_to_read) {
+        std::size_t remaining = num_to_read - (std::size_t)*num_actually_read;
+
+        // large reads go straight into the destination once the buffer is used up
+        if (this->buffer_offset == this->buffer_end && remaining >= this->buffer.size() &&
+            !this->reached_end) {
+            this->buffer_offset = 0;
+            this->buffer_end = 0;
+            std::int64_t num_read = this->io.read(
+                this->io.cookie, buffer + *num_actually_read, remaining);
+            if (num_read <= 0) {
+                this->reached_end = true;
+                break;
+            }
+            *num_actually_read += (std::uint64_t)num_read;
+            this->position += (std::uint64_t)num_read;
+            continue;
+        }
+
+        std::size_t available = this->fill_buffer();
+        if (available == 0) {
+            break;
+        }
+        std::size_t actual = remaining < available ? remaining : available;
+        std::memcpy(buffer + *num_actually_read,
+                    this->buffer.data() + this->buffer_offset, actual);
+        this->buffer_offset += actual;
+        *num_actually_read += actual;
+        this->position += actual;
+    }
+
+    if (*num_actually_read == 0) {
+        return this->end_of_input();
+    }
+    return Status(*num_actually_read == num_to_read ? Status::kOkCompleted
+                                                    : Status::kOkPartial);
+}
+
+Status
+Sav1IOReader::Skip(std::uint64_t num_to_skip, std::uint64_t *num_actually_skipped)
+{
+    assert(num_to_skip > 0);
+    assert(num_actually_skipped != nullptr);
+
+    // skip whatever is already buffered
+    std::uint64_t buffered = this->buffer_end - this->buffer_offset;
+    std::uint64_t actual = num_to_skip < buffered ? num_to_skip : buffered;
+    this->buffer_offset += (std::size_t)actual;
+    this->position += actual;
+    *num_actually_skipped = actual;
+
+    // seek over the rest if we can, rather than reading it in
+    std::uint64_t remaining = num_to_skip - actual;
+    if (remaining > 0 && this->io.seek != NULL && !this->reached_end) {
+        if (this->size >= 0 && this->position + remaining > (std::uint64_t)this->size) {
+            remaining = (std::uint64_t)this->size - this->position;
+        }
+        if (remaining > 0 &&
+            this->io.seek(this->io.cookie, this->position + remaining) == 0) {
+            this->buffer_offset = 0;
+            this->buffer_end = 0;
+            this->position += remaining;
+            *num_actually_skipped += remaining;
+            remaining = num_to_skip - *num_actually_skipped;
+        }
+    }
+
+    // otherwise read through it
+    while (remaining > 0) {
+        std::size_t available = this->fill_buffer();
+        if (available == 0) {
+            break;
+        }
+        actual = remaining < available ? remaining : available;
+        this->buffer_offset += (std::size_t)actual;
+        this->position += actual;
+        *num_actually_skipped += actual;
+        remaining -= actual;
+    }
+
+    if (*num_actually_skipped == 0) {
+        return this->end_of_input();
+    }
+    return Status(*num_actually_skipped == num_to_skip ? Status::kOkCompleted
+                                                       : Status::kOkPartial);
+}
+
+Status
+Sav1IOReader::Seek(std::uint64_t seek_position)
+{
+    // stay within the buffer if possible
+    std::uint64_t buffer_start = this->position - this->buffer_offset;
+    if (seek_position >= buffer_start &&
+        seek_position < buffer_start + this->buffer_end) {
+        this->buffer_offset = (std::size_t)(seek_position - buffer_start);
+        this->position = seek_position;
+        return Status(Status::kOkCompleted);
+    }
+
+    if (this->io.seek == NULL ||
+        (this->size >= 0 && seek_position > (std::uint64_t)this->size) ||
+        this->io.seek(this->io.cookie, seek_position)) {
+        return Status(Status::kSeekFailed);
+    }
+    this->buffer_offset = 0;
+    this->buffer_end = 0;
+    this->position = seek_position;
+    this->reached_end = false;
+    return Status(Status::kOkCompleted);
+}
+
+std::uint64_t
+Sav1IOReader::Position() const
+{
+    return this->position;
+}
+
+void
+Sav1IOReader::set_follow(bool do_follow)
+{
+    Sav1Reader::set_follow(do_follow);
+
+    // the size only tells us how much had been written when the input was opened
+    if (do_follow) {
+        this->size = -1;
+    }
+}
+
+Status
+Sav1IOReader::end_of_input()
+{
+    // keep asking for more while following, since the input may still grow
+    if (this->is_following) {
+        this->reached_end = false;
+    }
+    return this->end_of_input_status();
+}
+
+Sav1Reader *
+parse_reader_open_file(const char *file_path, Sav1FileReadMode read_mode,
+                       std::size_t prefetch_chunk_size, bool is_growing)
+{
+    if (is_growing) {
+        FILE *file = std::fopen(file_path, "rb");
+        return file != NULL ? new Sav1FileReader(file) : nullptr;
+    }
+
+#ifndef _WIN32
+    if (read_mode == SAV1_FILE_READ_PREFETCH || read_mode == SAV1_FILE_READ_SHARED) {
+        Sav1PrefetchReader *prefetch_reader = new Sav1PrefetchReader();
+        if (prefetch_reader->open(file_path, prefetch_chunk_size,
+                                  read_mode == SAV1_FILE_READ_SHARED)) {
+            return prefetch_reader;
+        }
+        delete prefetch_reader;
+    }
+#else
+    (void)read_mode;
+    (void)prefetch_chunk_size;
+#endif
+
+    // prefer mapping the file so frames can point straight into it
+    Sav1MmapReader *mmap_reader = new Sav1MmapReader();
+    if (mmap_reader->open(file_path)) {
+        return mmap_reader;
+    }
+    delete mmap_reader;
+
+    // fall back to stdio for inputs that can't be mapped, like pipes
+    FILE *file = std::fopen(file_path, "rb");
+    if (file == NULL) {
+        return nullptr;
+    }
+    return new Sav1FileReader(file);
+}
+
+void
+Sav1MmapReader::prefetch(std::uint64_t position)
+{
+#ifndef _WIN32
+    if (!this->is_mapped || position >= this->size) {
+        return;
+    }
+    std::uint64_t page_size = (std::uint64_t)sysconf(_SC_PAGESIZE);
+    std::uint64_t start = position - position % page_size;
+    std::uint64_t length = this->size - start;
+    if (length > PARSE_PREFETCH_HINT_SIZE) {
+        length = PARSE_PREFETCH_HINT_SIZE;
+    }
+    madvise((void *)(this->data + start), (size_t)length, MADV_WILLNEED);
+#else
+    (void)position;
+#endif
+}
+
+#ifndef _WIN32
+Sav1PrefetchReader::Sav1PrefetchReader()
+    : fd(-1),
+      size(0),
+      position(0),
+      chunk_size(0),
+      window_offset(0),
+      num_loading(0),
+      is_closing(false),
+      engine(nullptr),
+      is_shared_engine(false)
+{
+    for (Chunk &chunk : this->chunks) {
+        chunk.offset = 0;
+        chunk.length = 0;
+        chunk.state = CHUNK_EMPTY;
+        chunk.data = nullptr;
+        chunk.request.on_complete = Sav1PrefetchReader::on_chunk_loaded;
+        chunk.request.cookie = this;
+    }
+    thread_mutex_init(&(this->lock));
+    thread_signal_init(&(this->ready_signal));
+}
+
+Sav1PrefetchReader::~Sav1PrefetchReader()
+{
+    this->close();
+    thread_signal_term(&(this->ready_signal));
+    thread_mutex_term(&(this->lock));
+}
+
+bool
+Sav1PrefetchReader::open(const char *file_path, std::size_t chunk_size,
+                         bool use_shared_engine)
+{
+    this->close();
+
+    int file = ::open(file_path, O_RDONLY);
+    if (file < 0) {
+        return false;
+    }
+    struct stat file_stat;
+    if (fstat(file, &file_stat) || !S_ISREG(file_stat.st_mode)) {
+        ::close(file);
+        return false;
+    }
+
+    // keep the chunks page aligned so reads line up with the page cache
+    std::size_t page_size = (std::size_t)sysconf(_SC_PAGESIZE);
+    if (chunk_size < page_size) {
+        chunk_size = page_size;
+    }
+    chunk_size = (chunk_size + page_size - 1) / page_size * page_size;
+    for (Chunk &chunk : this->chunks) {
+        void *data;
+        if (posix_memalign(&data, page_size, chunk_size)) {
+            ::close(file);
+            this->close();
+            return false;
+        }
+        chunk.data = (std::uint8_t *)data;
+        chunk.state = CHUNK_EMPTY;
+    }
+
+#ifdef POSIX_FADV_SEQUENTIAL
+    posix_fadvise(file, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+    this->fd = file;
+    this->size = (std::uint64_t)file_stat.st_size;
+    this->position = 0;
+    this->chunk_size = chunk_size;
+    this->window_offset = 0;
+    this->is_closing = false;
+    this->is_shared_engine = use_shared_engine;
+    this->engine = use_shared_engine ? io_engine_acquire_shared() : io_engine_create();
+
+    // start on the beginning of the file straight away
+    thread_mutex_lock(&(this->lock));
+    this->load_window();
+    thread_mutex_unlock(&(this->lock));
+    return true;
+}
+
+void
+Sav1PrefetchReader::close()
+{
+    // the engine may still be writing into the chunks, so wait for it to finish
+    thread_mutex_lock(&(this->lock));
+    this->is_closing = true;
+    while (this->num_loading > 0) {
+        thread_mutex_unlock(&(this->lock));
+        thread_signal_wait(&(this->ready_signal), PARSE_PREFETCH_WAIT_MS);
+        thread_mutex_lock(&(this->lock));
+    }
+    thread_mutex_unlock(&(this->lock));
+
+    if (this->engine != nullptr) {
+        if (this->is_shared_engine) {
+            io_engine_release_shared(this->engine);
+        }
+        else {
+            delete this->engine;
+        }
+        this->engine = nullptr;
+    }
+    for (Chunk &chunk : this->chunks) {
+        free(chunk.data);
+        chunk.data = nullptr;
+        chunk.state = CHUNK_EMPTY;
+    }
+    if (this->fd >= 0) {
+        ::close(this->fd);
+        this->fd = -1;
+    }
+    this->size = 0;
+    this->position = 0;
+}
+
+void
+Sav1PrefetchReader::load_window()
+{
+    if (this->is_closing) {
+        return;
+    }
+
+    Sav1IORequest *requests[PARSE_PREFETCH_NUM_CHUNKS];
+    int num_requests = 0;
+    std::uint64_t offset = this->window_offset;
+    for (int i = 0; i < PARSE_PREFETCH_NUM_CHUNKS && offset < this->size; i++) {
+        Chunk *chunk =
+            &(this->chunks[(offset / this->chunk_size) % PARSE_PREFETCH_NUM_CHUNKS]);
+
+        // a chunk still loading something older is picked up again once it finishes
+        if (chunk->state != CHUNK_LOADING &&
+            (chunk->offset != offset || chunk->state == CHUNK_EMPTY)) {
+            std::uint64_t remaining = this->size - offset;
+            chunk->offset = offset;
+            chunk->state = CHUNK_LOADING;
+            chunk->request.fd = this->fd;
+            chunk->request.offset = offset;
+            chunk->request.buffer = chunk->data;
+            chunk->request.length =
+                remaining < this->chunk_size ? (std::size_t)remaining : this->chunk_size;
+            requests[num_requests++] = &(chunk->request);
+            this->num_loading++;
+        }
+        offset += this->chunk_size;
+    }
+
+    // hand the whole window over at once so the engine can batch it
+    if (num_requests > 0) {
+        this->engine->submit(requests, num_requests);
+    }
+}
+
+void
+Sav1PrefetchReader::on_chunk_loaded(Sav1IORequest *request, std::size_t num_read)
+{
+    Sav1PrefetchReader *reader = (Sav1PrefetchReader *)request->cookie;
+
+    thread_mutex_lock(&(reader->lock));
+    for (Chunk &chunk : reader->chunks) {
+        if (&(chunk.request) == request) {
+            chunk.length = num_read;
+            chunk.state = CHUNK_READY;
+        }
+    }
+    reader->num_loading--;
+
+    // keep the window full
+    reader->load_window();
+
+    // the reader can be destroyed as soon as the lock is released
+    thread_signal_raise(&(reader->ready_signal));
+    thread_mutex_unlock(&(reader->lock));
+}
+
+const std::uint8_t *
+Sav1PrefetchReader::acquire(std::uint64_t position, std::size_t *num_available)
+{
+    std::uint64_t offset = position - position % this->chunk_size;
+    std::size_t index = (offset / this->chunk_size) % PARSE_PREFETCH_NUM_CHUNKS;
+    Chunk *chunk = &(this->chunks[index]);
+
+    thread_mutex_lock(&(this->lock));
+    if (this->window_offset != offset) {
+        // move the window along so the engine loads what comes next
+        this->window_offset = offset;
+        this->load_window();
+    }
+    while (chunk->offset != offset || chunk->state != CHUNK_READY) {
+        thread_mutex_unlock(&(this->lock));
+        thread_signal_wait(&(this->ready_signal), PARSE_PREFETCH_WAIT_MS);
+        thread_mutex_lock(&(this->lock));
+    }
+    thread_mutex_unlock(&(this->lock));
+
+    // the chunk under the window can't be reused until the window moves past it
+    std::size_t chunk_position = (std::size_t)(position - offset);
+    *num_available =
+        chunk->length > chunk_position ? chunk->length - chunk_position : 0;
+    return chunk->data + chunk_position;
+}
+
+Status
+Sav1PrefetchReader::Read(std::size_t num_to_read, std::uint8_t *buffer,
+                         std::uint64_t *num_actually_read)
+{
+    assert(num_to_read > 0);
+    assert(buffer != nullptr);
+    assert(num_actually_read != nullptr);
+
+    *num_actually_read = 0;
+    while (*num_actually_read < num_to_read && this->position < this->size) {
+        std::size_t num_available;
+        const std::uint8_t *data = this->acquire(this->position, &num_available);
+        if (num_available == 0) {
+            // the file must have been truncated
+            break;
+        }
+        std::size_t remaining = num_to_read - (std::size_t)*num_actually_read;
+        std::size_t actual = remaining < num_available ? remaining : num_available;
+        std::memcpy(buffer + *num_actually_read, data, actual);
+        *num_actually_read += actual;
+        this->position += actual;
+    }
+
+    if (*num_actually_read == 0) {
+        return Status(Status::kEndOfFile);
+    }
+    return Status(*num_actually_read == num_to_read ? Status::kOkCompleted
+                                                    : Status::kOkPartial);
+}
+
+Status
+Sav1PrefetchReader::Skip(std::uint64_t num_to_skip, std::uint64_t *num_actually_skipped)
+{
+    assert(num_to_skip > 0);
+    assert(num_actually_skipped != nullptr);
+
+    std::uint64_t available = this->size - this->position;
+    if (available == 0) {
+        *num_actually_skipped = 0;
+        return Status(Status::kEndOfFile);
+    }
+
+    std::uint64_t actual = num_to_skip < available ? num_to_skip : available;
+    this->position += actual;
+    *num_actually_skipped = actual;
+
+    return Status(actual == num_to_skip ? Status::kOkCompleted : Status::kOkPartial);
+}
+
+Status
+Sav1PrefetchReader::Seek(std::uint64_t seek_position)
+{
+    if (seek_position > this->size) {
+        return Status(Status::kSeekFailed);
+    }
+    this->position = seek_position;
+    return Status(Status::kOkCompleted);
+}
+
+std::uint64_t
+Sav1PrefetchReader::Position() const
+{
+    return this->position;
+}
+
+void
+Sav1PrefetchReader::prefetch(std::uint64_t position)
+{
+#ifdef POSIX_FADV_WILLNEED
+    if (position < this->size) {
+        std::uint64_t offset = position - position % this->chunk_size;
+        posix_fadvise(this->fd, (off_t)offset, (off_t)this->chunk_size,
+                      POSIX_FADV_WILLNEED);
+    }
+#else
+    (void)position;
+#endif
+}
+#endif
+
+Sav1Reader *
+parse_reader_open_buffer(const std::uint8_t *data, std::uint64_t size)
+{
+    if (data == nullptr || size == 0) {
+        return nullptr;
+    }
+    Sav1MmapReader *reader = new Sav1MmapReader();
+    reader->open_buffer(data, size);
+    return reader;
+}
+
+Sav1Reader *
+parse_reader_open_io(const Sav1IO &io, std::size_t read_ahead_size)
+{
+    if (io.read == NULL) {
+        return nullptr;
+    }
+    return new Sav1IOReader(io, read_ahead_size);
+}
@@ -0,0 +1,268 @@
+#ifndef PARSE_READER_H
+#define PARSE_READER_H
+
+#include <cstdint>
+#include <webm/file_reader.h>
+#include <webm/reader.h>
+#include <webm/status.h>
+#include <vector>
+
+#include "io_engine.h"
+
+extern "C" {
+#include "sav1_settings.h"
+#include "thread.h"
+}
+
+#define PARSE_PREFETCH_NUM_CHUNKS 4
+
+// a webm::Reader that can also jump to an absolute position in the input
+class Sav1Reader : public webm::Reader {
+   public:
+    virtual webm::Status
+    Seek(std::uint64_t seek_position) = 0;
+
+    // returns a pointer to `size` bytes of the input starting at `position` if the
+    // input is addressable in memory, otherwise nullptr
+    virtual const std::uint8_t *
+    get_data(std::uint64_t, std::uint64_t) const
+    {
+        return nullptr;
+    }
+
+    // hint that reading will soon continue from `position`
+    virtual void
+    prefetch(std::uint64_t)
+    {
+    }
+
+    // treat the input as still being written, so that running out of it is reported as
+    // kWouldBlock and parsing can resume once there's more
+    virtual void
+    set_follow(bool do_follow)
+    {
+        this->is_following = do_follow;
+    }
+
+   protected:
+    webm::Status
+    end_of_input_status() const
+    {
+        return webm::Status(this->is_following ? webm::Status::kWouldBlock
+                                               : webm::Status::kEndOfFile);
+    }
+
+    bool is_following = false;
+};
+
+// reads the input with stdio through libwebm's FileReader
+class Sav1FileReader : public Sav1Reader {
+   public:
+    explicit Sav1FileReader(FILE *file);
+
+    webm::Status
+    Read(std::size_t num_to_read, std::uint8_t *buffer,
+         std::uint64_t *num_actually_read) override;
+
+    webm::Status
+    Skip(std::uint64_t num_to_skip, std::uint64_t *num_actually_skipped) override;
+
+    webm::Status
+    Seek(std::uint64_t seek_position) override;
+
+    std::uint64_t
+    Position() const override;
+
+   private:
+    // report the end of the file as kWouldBlock while following it
+    webm::Status
+    follow_status(webm::Status status);
+
+    FILE *file;
+    webm::FileReader reader;
+};
+
+// reads from the input held entirely in memory, either by mapping the whole file or by
+// borrowing a buffer from the caller, so that frame data never has to be copied
+class Sav1MmapReader : public Sav1Reader {
+   public:
+    Sav1MmapReader();
+    ~Sav1MmapReader() override;
+
+    Sav1MmapReader(const Sav1MmapReader &) = delete;
+    Sav1MmapReader &
+    operator=(const Sav1MmapReader &) = delete;
+
+    // map the file at file_path, returning false if it can't be mapped
+    bool
+    open(const char *file_path);
+
+    // read from size bytes at data, which must outlive the reader
+    void
+    open_buffer(const std::uint8_t *data, std::uint64_t size);
+
+    webm::Status
+    Read(std::size_t num_to_read, std::uint8_t *buffer,
+         std::uint64_t *num_actually_read) override;
+
+    webm::Status
+    Skip(std::uint64_t num_to_skip, std::uint64_t *num_actually_skipped) override;
+
+    webm::Status
+    Seek(std::uint64_t seek_position) override;
+
+    std::uint64_t
+    Position() const override;
+
+    const std::uint8_t *
+    get_data(std::uint64_t position, std::uint64_t size) const override;
+
+    void
+    prefetch(std::uint64_t position) override;
+
+   private:
+    void
+    close();
+
+    const std::uint8_t *data;
+    std::uint64_t size;
+    std::uint64_t position;
+    bool is_mapped;
+#ifdef _WIN32
+    void *file_handle;
+    void *mapping_handle;
+#endif
+};
+
+#ifndef _WIN32
+// reads large aligned chunks of the file through an I/O engine, keeping a ring of them
+// loaded ahead of the parser so that slow disks don't stall parsing
+class Sav1PrefetchReader : public Sav1Reader {
+   public:
+    Sav1PrefetchReader();
+    ~Sav1PrefetchReader() override;
+
+    Sav1PrefetchReader(const Sav1PrefetchReader &) = delete;
+    Sav1PrefetchReader &
+    operator=(const Sav1PrefetchReader &) = delete;
+
+    // open the file at file_path, returning false if it can't be opened. the reads go
+    // through the engine shared by every context if use_shared_engine is set, otherwise
+    // through one of the reader's own
+    bool
+    open(const char *file_path, std::size_t chunk_size, bool use_shared_engine);
+
+    webm::Status
+    Read(std::size_t num_to_read, std::uint8_t *buffer,
+         std::uint64_t *num_actually_read) override;
+
+    webm::Status
+    Skip(std::uint64_t num_to_skip, std::uint64_t *num_actually_skipped) override;
+
+    webm::Status
+    Seek(std::uint64_t seek_position) override;
+
+    std::uint64_t
+    Position() const override;
+
+    void
+    prefetch(std::uint64_t position) override;
+
+    // called by the engine when a chunk has been read
+    static void
+    on_chunk_loaded(Sav1IORequest *request, std::size_t num_read);
+
+   private:
+    typedef enum { CHUNK_EMPTY, CHUNK_LOADING, CHUNK_READY } ChunkState;
+
+    typedef struct Chunk {
+        std::uint64_t offset;
+        std::size_t length;
+        ChunkState state;
+        std::uint8_t *data;
+        Sav1IORequest request;
+    } Chunk;
+
+    void
+    close();
+
+    // submit reads for every chunk in the window that isn't loaded, with the lock held
+    void
+    load_window();
+
+    // wait until the chunk holding `position` is loaded, returning a pointer to the data
+    // there and setting num_available to the number of bytes that follow it
+    const std::uint8_t *
+    acquire(std::uint64_t position, std::size_t *num_available);
+
+    int fd;
+    std::uint64_t size;
+    std::uint64_t position;
+    std::size_t chunk_size;
+    Chunk chunks[PARSE_PREFETCH_NUM_CHUNKS];
+    std::uint64_t window_offset;  // offset of the chunk the parser is currently in
+    int num_loading;              // chunks the engine hasn't finished with yet
+    bool is_closing;
+    thread_mutex_t lock;
+    thread_signal_t ready_signal;
+    Sav1IOEngine *engine;
+    bool is_shared_engine;
+};
+#endif
+
+// reads through the caller's I/O functions, buffering ahead so that libwebm's many small
+// reads don't each turn into a call
+class Sav1IOReader : public Sav1Reader {
+   public:
+    Sav1IOReader(const Sav1IO &io, std::size_t read_ahead_size);
+
+    webm::Status
+    Read(std::size_t num_to_read, std::uint8_t *buffer,
+         std::uint64_t *num_actually_read) override;
+
+    webm::Status
+    Skip(std::uint64_t num_to_skip, std::uint64_t *num_actually_skipped) override;
+
+    webm::Status
+    Seek(std::uint64_t seek_position) override;
+
+    std::uint64_t
+    Position() const override;
+
+    void
+    set_follow(bool do_follow) override;
+
+   private:
+    // refill the buffer, returning the number of bytes now available
+    std::size_t
+    fill_buffer();
+
+    // the status to return when nothing could be read
+    webm::Status
+    end_of_input();
+
+    Sav1IO io;
+    std::vector<std::uint8_t> buffer;
+    std::size_t buffer_offset;  // next unread byte in the buffer
+    std::size_t buffer_end;     // end of the valid bytes in the buffer
+    std::uint64_t position;     // input position of the next unread byte
+    std::int64_t size;          // total input size, or < 0 if unknown
+    bool reached_end;
+};
+
+// open the best available reader for file_path, or return nullptr on failure. a file
+// that is still growing is always read with stdio, since mappings and prefetched
+// chunks can't follow it
+Sav1Reader *
+parse_reader_open_file(const char *file_path, Sav1FileReadMode read_mode,
+                       std::size_t prefetch_chunk_size, bool is_growing);
+
+// open a reader over a caller-owned buffer, or return nullptr on failure
+Sav1Reader *
+parse_reader_open_buffer(const std::uint8_t *data, std::uint64_t size);
+
+// open a reader over the caller's I/O functions, or return nullptr on failure
+Sav1Reader *
+parse_reader_open_io(const Sav1IO &io, std::size_t read_ahead_size);
+
+#endif
@@ -54,6 +54,7 @@ sav1_create_context(Sav1Context *context, Sav1Settings *settings)
     ctx->context = context;
     ctx->critical_error_flag = 0;
     ctx->is_playing = 0;
+    ctx->is_visible = 1;
     if ((ctx->start_time = (struct timespec *)malloc(sizeof(struct timespec))) == NULL) {
         RAISE_CRITICAL(ctx, "malloc() failed in sav1_create_context()");
     }
@@ -70,6 +71,20 @@ sav1_create_context(Sav1Context *context, Sav1Settings *settings)
         RAISE_CRITICAL(ctx, "malloc() failed in sav1_create_context()");
     }
     thread_mutex_init(ctx->seek_lock);
+    ctx->chapter_cache = NULL;
+    ctx->capture_chapter = SAV1_NO_CHAPTER;
+    ctx->chapter_prev_timecode = -1;
+    ctx->audio_track_switches = 0;
+    ctx->auto_track_frames = 0;
+    ctx->auto_track_starved_frames = 0;
+    ctx->shared_source = NULL;
+    ctx->shared_seek_generation = 0;
+    ctx->shared_join = 0;
+    ctx->shared_stalled = 0;
+    ctx->shared_timecode = -1;
+    ctx->catch_up_timecode = 0;
+    ctx->catch_up_lateness = 0;
+    ctx->catch_up_late_frames = 0;
 
     if ((ctx->settings = (Sav1Settings *)malloc(sizeof(Sav1Settings))) == NULL) {
         thread_mutex_term(ctx->seek_lock);
@@ -79,20 +94,111 @@ sav1_create_context(Sav1Context *context, Sav1Settings *settings)
     // copy over settings to prevent future modifications (except to file_path)
     memcpy(ctx->settings, settings, sizeof(Sav1Settings));
 
+    // contexts playing a shared source decode whatever the source was set up to
+    Sav1SharedSource *shared_source = settings->shared_source;
+    if (shared_source != NULL) {
+        if (shared_source->is_initialized != 1) {
+            free(ctx->settings);
+            thread_mutex_term(ctx->seek_lock);
+            RAISE_CRITICAL(ctx, "Uninitialized shared source in sav1_create_context()")
+        }
+        ctx->shared_source = (SharedSource *)shared_source->internal_state;
+        Sav1InternalContext *host_ctx =
+            (Sav1InternalContext *)ctx->shared_source->host->internal_state;
+        memcpy(ctx->settings, host_ctx->settings, sizeof(Sav1Settings));
+        ctx->settings->playback_mode = settings->playback_mode;
+        ctx->settings->playback_speed = settings->playback_speed;
+        ctx->settings->queue_size = settings->queue_size;
+        ctx->settings->chapter_frame_cache_size = settings->chapter_frame_cache_size;
+        ctx->settings->video_track_mode = SAV1_VIDEO_TRACK_MANUAL;
+        ctx->settings->shared_source = shared_source;
+    }
+
+    if (ctx->settings->decode_budget != NULL &&
+        ctx->settings->decode_budget->is_initialized != 1) {
+        free(ctx->settings);
+        thread_mutex_term(ctx->seek_lock);
+        RAISE_CRITICAL(ctx, "Uninitialized decode budget in sav1_create_context()")
+    }
+
     // clear error string
     memset(ctx->error_message, 0, SAV1_ERROR_MESSAGE_SIZE);
 
-    thread_manager_init(&(ctx->thread_manager), ctx);
-    thread_manager_start_pipeline(ctx->thread_manager);
+    // optionally keep the first frame of recent chapters around
+    if (ctx->settings->chapter_frame_cache_size > 0 &&
+        chapter_cache_init(&(ctx->chapter_cache),
+                           ctx->settings->chapter_frame_cache_size)) {
+        ctx->chapter_cache = NULL;
+        sav1_set_error(ctx, "malloc() failed in sav1_create_context()");
+        sav1_set_critical_error_flag(ctx);
+    }
+
+    if (ctx->shared_source != NULL) {
+        // frames are handed over from the shared source's pipeline into queues of our own
+        Sav1InternalContext *host_ctx =
+            (Sav1InternalContext *)ctx->shared_source->host->internal_state;
+        ctx->thread_manager = host_ctx->thread_manager;
+        size_t queue_size = ctx->settings->queue_size;
+        ctx->video_output_queue = NULL;
+        ctx->audio_output_queue = NULL;
+        if (((ctx->settings->codec_target & SAV1_CODEC_AV1) &&
+             sav1_thread_queue_init(&(ctx->video_output_queue), ctx, queue_size)) ||
+            ((ctx->settings->codec_target & SAV1_CODEC_OPUS) &&
+             sav1_thread_queue_init(&(ctx->audio_output_queue), ctx, queue_size))) {
+            if (ctx->video_output_queue != NULL) {
+                sav1_thread_queue_destroy(ctx->video_output_queue);
+            }
+            if (ctx->chapter_cache != NULL) {
+                chapter_cache_destroy(ctx->chapter_cache);
+            }
+            free(ctx->settings);
+            thread_mutex_term(ctx->seek_lock);
+            RAISE_CRITICAL(ctx, "malloc() failed in sav1_create_context()")
+        }
+        ctx->shared_join = 1;
+    }
+    else {
+        thread_manager_init(&(ctx->thread_manager), ctx);
+        thread_manager_start_pipeline(ctx->thread_manager);
+        ctx->video_output_queue = ctx->thread_manager->video_output_queue;
+        ctx->audio_output_queue = ctx->thread_manager->audio_output_queue;
+    }
 
     context->internal_state = (void *)ctx;
     context->is_initialized = 1;
 
+    // only start receiving frames once they can be destroyed through the context
+    if (ctx->shared_source != NULL && shared_source_attach(ctx->shared_source, ctx)) {
+        sav1_set_error(ctx, "malloc() failed in sav1_create_context()");
+        sav1_set_critical_error_flag(ctx);
+    }
+
     CHECK_CTX_CRITICAL_ERROR(ctx)
 
     return 0;
 }
 
+void
+drain_shared_output_queues(Sav1InternalContext *ctx)
+{
+    while (ctx->video_output_queue != NULL) {
+        Sav1VideoFrame *frame =
+            (Sav1VideoFrame *)sav1_thread_queue_pop_timeout(ctx->video_output_queue);
+        if (frame == NULL) {
+            break;
+        }
+        sav1_video_frame_destroy(ctx->context, frame);
+    }
+    while (ctx->audio_output_queue != NULL) {
+        Sav1AudioFrame *frame =
+            (Sav1AudioFrame *)sav1_thread_queue_pop_timeout(ctx->audio_output_queue);
+        if (frame == NULL) {
+            break;
+        }
+        sav1_audio_frame_destroy(ctx->context, frame);
+    }
+}
+
 int
 sav1_destroy_context(Sav1Context *context)
 {
@@ -101,8 +207,14 @@ sav1_destroy_context(Sav1Context *context)
     CHECK_CTX_VALID(ctx)
     CHECK_CTX_INITIALIZED(ctx, context)
 
-    thread_manager_kill_pipeline(ctx->thread_manager);
-    thread_manager_destroy(ctx->thread_manager);
+    if (ctx->shared_source != NULL) {
+        // the pipeline belongs to the shared source, so just stop receiving frames
+        shared_source_detach(ctx->shared_source, ctx);
+    }
+    else {
+        thread_manager_kill_pipeline(ctx->thread_manager);
+        thread_manager_destroy(ctx->thread_manager);
+    }
 
     // free time structs
     if (ctx->start_time != NULL) {
@@ -132,6 +244,23 @@ sav1_destroy_context(Sav1Context *context)
         sav1_audio_frame_destroy(context, ctx->next_audio_frame);
     }
 
+    // free the frames handed over from the shared source
+    if (ctx->shared_source != NULL) {
+        drain_shared_output_queues(ctx);
+        if (ctx->video_output_queue != NULL) {
+            sav1_thread_queue_destroy(ctx->video_output_queue);
+        }
+        if (ctx->audio_output_queue != NULL) {
+            sav1_thread_queue_destroy(ctx->audio_output_queue);
+        }
+        shared_source_release(ctx->shared_source);
+    }
+
+    // free the cached chapter frames
+    if (ctx->chapter_cache != NULL) {
+        chapter_cache_destroy(ctx->chapter_cache);
+    }
+
     // free the settings
     if (ctx->settings != NULL) {
         free(ctx->settings);
@@ -160,20 +289,13 @@ sav1_get_error(Sav1Context *context)
 }
 
 void
-seek_update_start_time(Sav1InternalContext *ctx)
+set_start_time(Sav1InternalContext *ctx, uint64_t timecode)
 {
-    thread_mutex_lock(ctx->seek_lock);
-    if (ctx->do_seek != ctx->settings->codec_target) {
-        thread_mutex_unlock(ctx->seek_lock);
-        return;
-    }
-    thread_mutex_unlock(ctx->seek_lock);
-
     struct timespec curr_time;
     clock_gettime(CLOCK_MONOTONIC, &curr_time);
-    uint64_t adjusted_seek_timecode = ctx->seek_timecode / ctx->settings->playback_speed;
-    ctx->start_time->tv_sec = curr_time.tv_sec - adjusted_seek_timecode / 1000;
-    uint64_t timecode_ns = (adjusted_seek_timecode % 1000) * 1000000;
+    uint64_t adjusted_timecode = timecode / ctx->settings->playback_speed;
+    ctx->start_time->tv_sec = curr_time.tv_sec - adjusted_timecode / 1000;
+    uint64_t timecode_ns = (adjusted_timecode % 1000) * 1000000;
     if (timecode_ns > (uint64_t)curr_time.tv_nsec) {
         ctx->start_time->tv_sec--;
         ctx->start_time->tv_nsec = curr_time.tv_nsec + 1000000000 - timecode_ns;
@@ -188,6 +310,19 @@ seek_update_start_time(Sav1InternalContext *ctx)
     }
 }
 
+void
+seek_update_start_time(Sav1InternalContext *ctx)
+{
+    thread_mutex_lock(ctx->seek_lock);
+    if (ctx->do_seek != ctx->settings->codec_target) {
+        thread_mutex_unlock(ctx->seek_lock);
+        return;
+    }
+    thread_mutex_unlock(ctx->seek_lock);
+
+    set_start_time(ctx, ctx->seek_timecode);
+}
+
 void
 file_end_update_start_time(Sav1InternalContext *ctx)
 {
@@ -226,18 +361,243 @@ file_end_update_start_time(Sav1InternalContext *ctx)
     if (ctx->curr_audio_frame != NULL) {
         ctx->curr_audio_frame->timecode = 0;
     }
+    ctx->catch_up_timecode = 0;
+    ctx->catch_up_lateness = 0;
+    ctx->catch_up_late_frames = 0;
 
     ctx->end_of_file = 0;
 }
 
+void
+cache_chapter_frame(Sav1InternalContext *ctx)
+{
+    Sav1VideoFrame *frame = ctx->curr_video_frame;
+    ParseContext *parse_context = ctx->thread_manager->parse_context;
+    int64_t prev_timecode = ctx->chapter_prev_timecode;
+    ctx->chapter_prev_timecode = (int64_t)frame->timecode;
+
+    // a frame is the entry of a chapter when the last one came before the chapter
+    // started, or when it's the first frame after seeking to the chapter
+    size_t index = ctx->capture_chapter;
+    ctx->capture_chapter = SAV1_NO_CHAPTER;
+    if (index == SAV1_NO_CHAPTER) {
+        uint64_t start_time, end_time;
+        const char *title;
+        if (parse_find_chapter(parse_context, frame->timecode, &index) ||
+            parse_get_chapter(parse_context, index, &start_time, &end_time, &title) ||
+            prev_timecode >= (int64_t)start_time) {
+            return;
+        }
+    }
+    if (chapter_cache_has(ctx->chapter_cache, index)) {
+        return;
+    }
+    if (chapter_cache_put(ctx->chapter_cache, index, frame)) {
+        sav1_set_error(ctx, "malloc() failed in cache_chapter_frame()");
+    }
+}
+
+void
+update_auto_video_track(Sav1InternalContext *ctx)
+{
+    ParseContext *parse_context = ctx->thread_manager->parse_context;
+    size_t selected = parse_get_selected_video_track(parse_context);
+
+    // wait for a switch to land before judging the new track
+    if (selected != parse_get_active_video_track(parse_context) ||
+        parse_get_status(parse_context) == PARSE_STATUS_END_OF_FILE) {
+        ctx->auto_track_frames = 0;
+        ctx->auto_track_starved_frames = 0;
+        return;
+    }
+
+    // the decoder is behind when there was nothing waiting to replace this frame
+    ctx->auto_track_frames++;
+    if (ctx->next_video_frame == NULL &&
+        sav1_thread_queue_get_size(ctx->thread_manager->video_dav1d_picture_queue) ==
+            0) {
+        ctx->auto_track_starved_frames++;
+    }
+    if (ctx->auto_track_frames < SAV1_AUTO_TRACK_WINDOW) {
+        return;
+    }
+    int is_behind = ctx->auto_track_starved_frames * 2 > ctx->auto_track_frames;
+    ctx->auto_track_frames = 0;
+    ctx->auto_track_starved_frames = 0;
+    if (!is_behind) {
+        return;
+    }
+
+    // step down to the largest track that is smaller than this one
+    size_t width, height;
+    const char *name;
+    parse_get_video_track(parse_context, selected, &width, &height, &name);
+    size_t curr_pixels = width * height;
+    size_t best_pixels = 0;
+    size_t best = selected;
+    size_t num_tracks = parse_get_num_video_tracks(parse_context);
+    for (size_t i = 0; i < num_tracks; i++) {
+        parse_get_video_track(parse_context, i, &width, &height, &name);
+        if (width * height < curr_pixels && width * height > best_pixels) {
+            best_pixels = width * height;
+            best = i;
+        }
+    }
+    if (best != selected) {
+        parse_select_video_track(parse_context, best);
+    }
+}
+
+void
+update_catch_up(Sav1InternalContext *ctx, uint64_t curr_ms)
+{
+    // a late poll takes every frame that's due at once, so only the last of them shows
+    // whether the decoder is keeping up
+    if (ctx->next_video_frame != NULL && ctx->next_video_frame->timecode <= curr_ms) {
+        return;
+    }
+
+    // frames decoded before the last jump ahead were always going to be late
+    uint64_t timecode = ctx->curr_video_frame->timecode;
+    if (timecode < ctx->catch_up_timecode) {
+        return;
+    }
+
+    // the decoder is only behind if it has nothing ready past the current time, and
+    // only falling behind if that gap isn't closing from one frame to the next
+    uint64_t lateness = 0;
+    if (ctx->next_video_frame == NULL && curr_ms > timecode) {
+        lateness = curr_ms - timecode;
+    }
+    if (lateness > SAV1_CATCH_UP_LATENESS && lateness >= ctx->catch_up_lateness) {
+        ctx->catch_up_late_frames++;
+    }
+    else {
+        ctx->catch_up_late_frames = 0;
+    }
+    ctx->catch_up_lateness = lateness;
+
+    DecodeAv1Context *decode_context = ctx->thread_manager->decode_av1_context;
+    if (ctx->catch_up_late_frames >= SAV1_CATCH_UP_LATE_FRAMES &&
+        lateness > SAV1_CATCH_UP_KEY_FRAME_LATENESS) {
+        // skipping frames wasn't enough, so stop decoding until the next keyframe
+        ctx->catch_up_timecode = curr_ms;
+        ctx->catch_up_late_frames = 0;
+        parse_skip_to_key_frame(ctx->thread_manager->parse_context, timecode);
+        decode_av1_skip_to_key_frame(decode_context, 1, timecode);
+    }
+    if (ctx->catch_up_late_frames >= SAV1_CATCH_UP_LATE_FRAMES) {
+        decode_av1_skip_non_reference_frames(decode_context, 1);
+    }
+    else if (lateness < SAV1_CATCH_UP_LATENESS / 2) {
+        decode_av1_skip_non_reference_frames(decode_context, 0);
+    }
+}
+
+void
+start_seek(Sav1InternalContext *ctx, uint64_t timecode_ms)
+{
+    // save the time that we want to seek to
+    ctx->seek_timecode = timecode_ms;
+
+    // remove all the currently queued frames
+    if (ctx->curr_video_frame != NULL && ctx->curr_video_frame->sav1_has_ownership) {
+        sav1_video_frame_destroy(ctx->context, ctx->curr_video_frame);
+        ctx->curr_video_frame = NULL;
+    }
+    if (ctx->next_video_frame != NULL && ctx->next_video_frame->sav1_has_ownership) {
+        sav1_video_frame_destroy(ctx->context, ctx->next_video_frame);
+        ctx->next_video_frame = NULL;
+    }
+    if (ctx->curr_audio_frame != NULL && ctx->curr_audio_frame->sav1_has_ownership) {
+        sav1_audio_frame_destroy(ctx->context, ctx->curr_audio_frame);
+        ctx->curr_audio_frame = NULL;
+    }
+    if (ctx->next_audio_frame != NULL && ctx->next_audio_frame->sav1_has_ownership) {
+        sav1_audio_frame_destroy(ctx->context, ctx->next_audio_frame);
+        ctx->next_audio_frame = NULL;
+    }
+
+    ctx->video_frame_ready = 0;
+    ctx->audio_frame_ready = 0;
+
+    // frames after a seek don't follow on from the ones before it
+    ctx->capture_chapter = SAV1_NO_CHAPTER;
+    ctx->chapter_prev_timecode = INT64_MAX;
+    ctx->shared_join = 0;
+    if (ctx->shared_source != NULL) {
+        shared_source_set_timecode(ctx->shared_source, ctx, -1);
+    }
+
+    // playback starts out on time again after seeking
+    ctx->catch_up_timecode = 0;
+    ctx->catch_up_lateness = 0;
+    ctx->catch_up_late_frames = 0;
+    if (ctx->shared_source == NULL && (ctx->settings->codec_target & SAV1_CODEC_AV1)) {
+        DecodeAv1Context *decode_context = ctx->thread_manager->decode_av1_context;
+        decode_av1_skip_non_reference_frames(decode_context, 0);
+        decode_av1_skip_to_key_frame(decode_context, 0, 0);
+    }
+
+    thread_mutex_lock(ctx->seek_lock);
+    ctx->do_seek = ctx->settings->codec_target;
+    ctx->end_of_file = 0;
+    thread_mutex_unlock(ctx->seek_lock);
+}
+
+int
+sync_shared_source(Sav1InternalContext *ctx)
+{
+    if (ctx->shared_source == NULL) {
+        return 0;
+    }
+
+    // an error in the shared pipeline is an error for every context playing it
+    Sav1InternalContext *host_ctx =
+        (Sav1InternalContext *)ctx->shared_source->host->internal_state;
+    if (host_ctx->critical_error_flag) {
+        sav1_set_error(ctx, host_ctx->error_message);
+        sav1_set_critical_error_flag(ctx);
+        return -1;
+    }
+
+    // follow the seeks made through the other contexts
+    uint64_t timecode;
+    int generation = shared_source_get_seek(ctx->shared_source, &timecode);
+    if (generation != ctx->shared_seek_generation) {
+        ctx->shared_seek_generation = generation;
+        start_seek(ctx, timecode);
+    }
+    return 0;
+}
+
+void
+join_shared_source(Sav1InternalContext *ctx, uint64_t timecode, uint64_t *curr_ms)
+{
+    // a context that attached after the source started playing picks up where the other
+    // contexts are, or else from the first frame it receives, once its clock has started
+    int has_clock = ctx->is_playing || ctx->pause_time != NULL;
+    if (!ctx->shared_join || ctx->do_seek || !has_clock) {
+        return;
+    }
+    shared_source_get_playback_time(ctx->shared_source, ctx, &timecode);
+    set_start_time(ctx, timecode);
+    ctx->shared_join = 0;
+    *curr_ms = timecode;
+}
+
 void
 pump_video_frames(Sav1InternalContext *ctx, uint64_t curr_ms)
 {
+    if (sync_shared_source(ctx)) {
+        return;
+    }
+
     // if we have no next frame, try to get one
     if (ctx->next_video_frame == NULL &&
-        sav1_thread_queue_get_size(ctx->thread_manager->video_output_queue) != 0) {
+        sav1_thread_queue_get_size(ctx->video_output_queue) != 0) {
         ctx->next_video_frame = (Sav1VideoFrame *)sav1_thread_queue_pop(
-            ctx->thread_manager->video_output_queue);
+            ctx->video_output_queue);
     }
 
     thread_mutex_lock(ctx->seek_lock);
@@ -260,16 +620,18 @@ pump_video_frames(Sav1InternalContext *ctx, uint64_t curr_ms)
             if (ctx->next_video_frame->sav1_has_ownership) {
                 sav1_video_frame_destroy(ctx->context, ctx->next_video_frame);
             }
-            if (sav1_thread_queue_get_size(ctx->thread_manager->video_output_queue) ==
-                0) {
+            if (sav1_thread_queue_get_size(ctx->video_output_queue) == 0) {
                 ctx->next_video_frame = NULL;
                 thread_mutex_unlock(ctx->seek_lock);
                 return;
             }
             ctx->next_video_frame = (Sav1VideoFrame *)sav1_thread_queue_pop(
-                ctx->thread_manager->video_output_queue);
+                ctx->video_output_queue);
         }
     }
+    if (ctx->next_video_frame != NULL) {
+        join_shared_source(ctx, ctx->next_video_frame->timecode, &curr_ms);
+    }
 
     // while we have a next frame, and the next frame is ahead of current time
     // alternatively, in FAST mode- when we have a next frame and the current frame
@@ -299,11 +661,26 @@ pump_video_frames(Sav1InternalContext *ctx, uint64_t curr_ms)
         ctx->curr_video_frame = ctx->next_video_frame;
         ctx->video_frame_ready = 1;
         ctx->next_video_frame = NULL;
+        if (ctx->shared_source != NULL) {
+            shared_source_set_timecode(ctx->shared_source, ctx,
+                                       (int64_t)ctx->curr_video_frame->timecode);
+        }
+        if (ctx->chapter_cache != NULL) {
+            cache_chapter_frame(ctx);
+        }
 
         // try to get new next frame from queue
-        if (sav1_thread_queue_get_size(ctx->thread_manager->video_output_queue) != 0) {
+        if (sav1_thread_queue_get_size(ctx->video_output_queue) != 0) {
             ctx->next_video_frame = (Sav1VideoFrame *)sav1_thread_queue_pop(
-                ctx->thread_manager->video_output_queue);
+                ctx->video_output_queue);
+        }
+        if (ctx->settings->video_track_mode == SAV1_VIDEO_TRACK_AUTO &&
+            ctx->settings->playback_mode == SAV1_PLAYBACK_TIMED && !ctx->do_seek) {
+            update_auto_video_track(ctx);
+        }
+        if (ctx->settings->playback_mode == SAV1_PLAYBACK_TIMED && !ctx->do_seek &&
+            ctx->shared_source == NULL) {
+            update_catch_up(ctx, curr_ms);
         }
 
         /* In fast mode, you only want to go through this loop once, since you're
@@ -315,14 +692,35 @@ pump_video_frames(Sav1InternalContext *ctx, uint64_t curr_ms)
     thread_mutex_unlock(ctx->seek_lock);
 }
 
+void
+drop_switched_audio_frames(Sav1InternalContext *ctx)
+{
+    // frames from an audio track that's been switched away from are never played
+    while (ctx->next_audio_frame != NULL &&
+           ctx->next_audio_frame->track_switches != ctx->audio_track_switches) {
+        if (ctx->next_audio_frame->sav1_has_ownership) {
+            sav1_audio_frame_destroy(ctx->context, ctx->next_audio_frame);
+        }
+        ctx->next_audio_frame = NULL;
+        if (sav1_thread_queue_get_size(ctx->audio_output_queue) != 0) {
+            ctx->next_audio_frame = (Sav1AudioFrame *)sav1_thread_queue_pop(
+                ctx->audio_output_queue);
+        }
+    }
+}
+
 void
 pump_audio_frames(Sav1InternalContext *ctx, uint64_t curr_ms)
 {
+    if (sync_shared_source(ctx)) {
+        return;
+    }
+
     // if we have no next frame, try to get one
     if (ctx->next_audio_frame == NULL &&
-        sav1_thread_queue_get_size(ctx->thread_manager->audio_output_queue) != 0) {
+        sav1_thread_queue_get_size(ctx->audio_output_queue) != 0) {
         ctx->next_audio_frame = (Sav1AudioFrame *)sav1_thread_queue_pop(
-            ctx->thread_manager->audio_output_queue);
+            ctx->audio_output_queue);
     }
 
     thread_mutex_lock(ctx->seek_lock);
@@ -344,16 +742,19 @@ pump_audio_frames(Sav1InternalContext *ctx, uint64_t curr_ms)
             if (ctx->next_audio_frame->sav1_has_ownership) {
                 sav1_audio_frame_destroy(ctx->context, ctx->next_audio_frame);
             }
-            if (sav1_thread_queue_get_size(ctx->thread_manager->audio_output_queue) ==
-                0) {
+            if (sav1_thread_queue_get_size(ctx->audio_output_queue) == 0) {
                 ctx->next_audio_frame = NULL;
                 thread_mutex_unlock(ctx->seek_lock);
                 return;
             }
             ctx->next_audio_frame = (Sav1AudioFrame *)sav1_thread_queue_pop(
-                ctx->thread_manager->audio_output_queue);
+                ctx->audio_output_queue);
         }
     }
+    drop_switched_audio_frames(ctx);
+    if (ctx->next_audio_frame != NULL) {
+        join_shared_source(ctx, ctx->next_audio_frame->timecode, &curr_ms);
+    }
 
     // while we have a next frame, and the next frame is ahead of current time
     while (ctx->next_audio_frame != NULL &&
@@ -381,12 +782,17 @@ pump_audio_frames(Sav1InternalContext *ctx, uint64_t curr_ms)
         ctx->curr_audio_frame = ctx->next_audio_frame;
         ctx->audio_frame_ready = 1;
         ctx->next_audio_frame = NULL;
+        if (ctx->shared_source != NULL) {
+            shared_source_set_timecode(ctx->shared_source, ctx,
+                                       (int64_t)ctx->curr_audio_frame->timecode);
+        }
 
         // try to get new next frame from queue
-        if (sav1_thread_queue_get_size(ctx->thread_manager->audio_output_queue) != 0) {
+        if (sav1_thread_queue_get_size(ctx->audio_output_queue) != 0) {
             ctx->next_audio_frame = (Sav1AudioFrame *)sav1_thread_queue_pop(
-                ctx->thread_manager->audio_output_queue);
+                ctx->audio_output_queue);
         }
+        drop_switched_audio_frames(ctx);
 
         /* In fast mode, you only want to go through this loop once, since you're
          * not going to skip any frames */
@@ -493,6 +899,20 @@ sav1_get_audio_frame_ready(Sav1Context *context, int *is_ready)
     return 0;
 }
 
+void
+update_decode_budget(Sav1InternalContext *ctx)
+{
+    // contexts playing a shared source leave the decoder's share to the source
+    if (ctx->shared_source != NULL || !(ctx->settings->codec_target & SAV1_CODEC_AV1)) {
+        return;
+    }
+    DecodeAv1Context *decode_context = ctx->thread_manager->decode_av1_context;
+    if (decode_context->budget != NULL) {
+        decode_budget_set_state(decode_context->budget, decode_context, ctx->is_visible,
+                                ctx->is_playing);
+    }
+}
+
 int
 sav1_start_playback(Sav1Context *context)
 {
@@ -547,6 +967,7 @@ sav1_start_playback(Sav1Context *context)
 
     // set the playback status
     ctx->is_playing = 1;
+    update_decode_budget(ctx);
 
     return 0;
 }
@@ -584,6 +1005,7 @@ sav1_stop_playback(Sav1Context *context)
 
     // set the playback status
     ctx->is_playing = 0;
+    update_decode_budget(ctx);
 
     return 0;
 }
@@ -601,6 +1023,21 @@ sav1_is_playback_paused(Sav1Context *context, int *is_paused)
     return 0;
 }
 
+int
+sav1_set_visibility(Sav1Context *context, int is_visible)
+{
+    CHECK_CONTEXT_VALID(context)
+    Sav1InternalContext *ctx = (Sav1InternalContext *)context->internal_state;
+    CHECK_CTX_VALID(ctx)
+    CHECK_CTX_INITIALIZED(ctx, context)
+    CHECK_CTX_CRITICAL_ERROR(ctx)
+
+    ctx->is_visible = is_visible ? 1 : 0;
+    update_decode_budget(ctx);
+
+    return 0;
+}
+
 int
 sav1_is_playback_at_file_end(Sav1Context *context, int *is_at_file_end)
 {
@@ -774,6 +1211,46 @@ sav1_get_playback_speed(Sav1Context *context, double *playback_speed)
     return 0;
 }
 
+int
+sav1_set_decode_profile(Sav1Context *context, const Sav1DecodeProfile *profile)
+{
+    CHECK_CONTEXT_VALID(context)
+    Sav1InternalContext *ctx = (Sav1InternalContext *)context->internal_state;
+    CHECK_CTX_VALID(ctx)
+    CHECK_CTX_INITIALIZED(ctx, context)
+    CHECK_CTX_CRITICAL_ERROR(ctx)
+
+    // the other contexts playing a shared source would change profile too
+    if (ctx->shared_source != NULL) {
+        RAISE(ctx, "sav1_set_decode_profile() called on a context with a shared source")
+    }
+    if (profile->frame_type < SAV1_DECODE_FRAMES_ALL ||
+        profile->frame_type > SAV1_DECODE_FRAMES_KEY) {
+        RAISE(ctx, "Invalid frame type in sav1_set_decode_profile()")
+    }
+
+    ctx->settings->decode_profile = *profile;
+    if (ctx->settings->codec_target & SAV1_CODEC_AV1) {
+        decode_av1_set_profile(ctx->thread_manager->decode_av1_context,
+                               &(ctx->settings->decode_profile));
+    }
+
+    return 0;
+}
+
+int
+sav1_get_decode_profile(Sav1Context *context, Sav1DecodeProfile *profile)
+{
+    CHECK_CONTEXT_VALID(context)
+    Sav1InternalContext *ctx = (Sav1InternalContext *)context->internal_state;
+    CHECK_CTX_VALID(ctx)
+    CHECK_CTX_INITIALIZED(ctx, context)
+    CHECK_CTX_CRITICAL_ERROR(ctx)
+
+    *profile = ctx->settings->decode_profile;
+    return 0;
+}
+
 int
 sav1_seek_playback(Sav1Context *context, uint64_t timecode_ms, int seek_mode)
 {
@@ -799,41 +1276,257 @@ sav1_seek_playback(Sav1Context *context, uint64_t timecode_ms, int seek_mode)
     }
     thread_mutex_unlock(ctx->seek_lock);
 
-    // update the atomic seek mode variable
-    thread_atomic_int_store(&(ctx->seek_mode), seek_mode);
+    if (ctx->shared_source != NULL) {
+        // every context playing the shared source follows the seek
+        ctx->shared_seek_generation =
+            shared_source_seek(ctx->shared_source, timecode_ms, seek_mode);
+    }
+    else {
+        // update the atomic seek mode variable
+        thread_atomic_int_store(&(ctx->seek_mode), seek_mode);
+
+        // make the thread manager do all the hard work
+        thread_manager_seek_to_time(ctx->thread_manager, timecode_ms);
+    }
 
-    // make the thread manager do all the hard work
-    thread_manager_seek_to_time(ctx->thread_manager, timecode_ms);
+    start_seek(ctx, timecode_ms);
 
-    // save the time that we want to seek to
-    ctx->seek_timecode = timecode_ms;
+    return 0;
+}
 
-    // remove all the currently queued frames
-    if (ctx->curr_video_frame != NULL && ctx->curr_video_frame->sav1_has_ownership) {
-        sav1_video_frame_destroy(context, ctx->curr_video_frame);
-        ctx->curr_video_frame = NULL;
+int
+sav1_get_chapter_count(Sav1Context *context, size_t *count)
+{
+    CHECK_CONTEXT_VALID(context)
+    Sav1InternalContext *ctx = (Sav1InternalContext *)context->internal_state;
+    CHECK_CTX_VALID(ctx)
+    CHECK_CTX_INITIALIZED(ctx, context)
+    CHECK_CTX_CRITICAL_ERROR(ctx)
+
+    *count = parse_get_num_chapters(ctx->thread_manager->parse_context);
+    return 0;
+}
+
+int
+sav1_get_chapter(Sav1Context *context, size_t index, Sav1Chapter *chapter)
+{
+    CHECK_CONTEXT_VALID(context)
+    Sav1InternalContext *ctx = (Sav1InternalContext *)context->internal_state;
+    CHECK_CTX_VALID(ctx)
+    CHECK_CTX_INITIALIZED(ctx, context)
+    CHECK_CTX_CRITICAL_ERROR(ctx)
+
+    ParseContext *parse_context = ctx->thread_manager->parse_context;
+    if (parse_get_chapter(parse_context, index, &(chapter->start_time),
+                          &(chapter->end_time), &(chapter->title))) {
+        RAISE(ctx, "Chapter index out of range in sav1_get_chapter()")
     }
-    if (ctx->next_video_frame != NULL && ctx->next_video_frame->sav1_has_ownership) {
-        sav1_video_frame_destroy(context, ctx->next_video_frame);
-        ctx->next_video_frame = NULL;
+
+    // the last chapter runs until the end of the file unless it says otherwise
+    if (chapter->end_time == 0 && index + 1 == parse_get_num_chapters(parse_context)) {
+        chapter->end_time = thread_manager_get_duration(ctx->thread_manager);
     }
-    if (ctx->curr_audio_frame != NULL && ctx->curr_audio_frame->sav1_has_ownership) {
-        sav1_audio_frame_destroy(context, ctx->curr_audio_frame);
-        ctx->curr_audio_frame = NULL;
+
+    return 0;
+}
+
+int
+sav1_seek_to_chapter(Sav1Context *context, size_t index)
+{
+    CHECK_CONTEXT_VALID(context)
+    Sav1InternalContext *ctx = (Sav1InternalContext *)context->internal_state;
+    CHECK_CTX_VALID(ctx)
+    CHECK_CTX_INITIALIZED(ctx, context)
+    CHECK_CTX_CRITICAL_ERROR(ctx)
+
+    uint64_t start_time, end_time;
+    const char *title;
+    if (parse_get_chapter(ctx->thread_manager->parse_context, index, &start_time,
+                          &end_time, &title)) {
+        RAISE(ctx, "Chapter index out of range in sav1_seek_to_chapter()")
     }
-    if (ctx->next_audio_frame != NULL && ctx->next_audio_frame->sav1_has_ownership) {
-        sav1_audio_frame_destroy(context, ctx->next_audio_frame);
-        ctx->next_audio_frame = NULL;
+    if (sav1_seek_playback(context, start_time, SAV1_SEEK_MODE_PRECISE)) {
+        return -1;
+    }
+    if (ctx->chapter_cache == NULL || !(ctx->settings->codec_target & SAV1_CODEC_AV1)) {
+        return 0;
     }
 
-    ctx->video_frame_ready = 0;
-    ctx->audio_frame_ready = 0;
+    // show the chapter's first frame right away if we've seen it before, otherwise
+    // remember it once it's decoded
+    Sav1VideoFrame *frame;
+    if (chapter_cache_copy(ctx->chapter_cache, index, &frame)) {
+        RAISE_CRITICAL(ctx, "malloc() failed in sav1_seek_to_chapter()")
+    }
+    if (frame == NULL) {
+        ctx->capture_chapter = index;
+        return 0;
+    }
+    frame->timecode = start_time;
+    ctx->curr_video_frame = frame;
+    ctx->video_frame_ready = 1;
+
+    return 0;
+}
+
+int
+sav1_get_audio_track_count(Sav1Context *context, size_t *count)
+{
+    CHECK_CONTEXT_VALID(context)
+    Sav1InternalContext *ctx = (Sav1InternalContext *)context->internal_state;
+    CHECK_CTX_VALID(ctx)
+    CHECK_CTX_INITIALIZED(ctx, context)
+    CHECK_CTX_CRITICAL_ERROR(ctx)
+
+    *count = parse_get_num_audio_tracks(ctx->thread_manager->parse_context);
+    return 0;
+}
+
+int
+sav1_get_audio_track(Sav1Context *context, size_t index, Sav1AudioTrack *track)
+{
+    CHECK_CONTEXT_VALID(context)
+    Sav1InternalContext *ctx = (Sav1InternalContext *)context->internal_state;
+    CHECK_CTX_VALID(ctx)
+    CHECK_CTX_INITIALIZED(ctx, context)
+    CHECK_CTX_CRITICAL_ERROR(ctx)
+
+    if (parse_get_audio_track(ctx->thread_manager->parse_context, index,
+                              &(track->language), &(track->name))) {
+        RAISE(ctx, "Audio track index out of range in sav1_get_audio_track()")
+    }
+    return 0;
+}
+
+int
+sav1_get_selected_audio_track(Sav1Context *context, size_t *index)
+{
+    CHECK_CONTEXT_VALID(context)
+    Sav1InternalContext *ctx = (Sav1InternalContext *)context->internal_state;
+    CHECK_CTX_VALID(ctx)
+    CHECK_CTX_INITIALIZED(ctx, context)
+    CHECK_CTX_CRITICAL_ERROR(ctx)
+
+    *index = parse_get_selected_audio_track(ctx->thread_manager->parse_context);
+    return 0;
+}
+
+int
+sav1_select_audio_track(Sav1Context *context, size_t index)
+{
+    CHECK_CONTEXT_VALID(context)
+    Sav1InternalContext *ctx = (Sav1InternalContext *)context->internal_state;
+    CHECK_CTX_VALID(ctx)
+    CHECK_CTX_INITIALIZED(ctx, context)
+    CHECK_CTX_CRITICAL_ERROR(ctx)
 
+    // the other contexts playing a shared source would switch tracks too
+    if (ctx->shared_source != NULL) {
+        RAISE(ctx, "sav1_select_audio_track() called on a context with a shared source")
+    }
+
+    // the new track starts right after the audio that's already been handed out
+    uint64_t timecode = 0;
     thread_mutex_lock(ctx->seek_lock);
-    ctx->do_seek = ctx->settings->codec_target;
-    ctx->end_of_file = 0;
+    int is_seeking = ctx->do_seek != 0;
+    if (ctx->do_seek & SAV1_CODEC_OPUS) {
+        timecode = ctx->seek_timecode;
+    }
+    else if (ctx->curr_audio_frame != NULL) {
+        timecode = ctx->curr_audio_frame->timecode + ctx->curr_audio_frame->duration;
+    }
     thread_mutex_unlock(ctx->seek_lock);
 
+    ParseContext *parse_context = ctx->thread_manager->parse_context;
+    if (parse_select_audio_track(parse_context, index, timecode,
+                                 &(ctx->audio_track_switches))) {
+        RAISE(ctx, "Audio track index out of range in sav1_select_audio_track()")
+    }
+
+    // once the whole file has been parsed, the new track can only be read again by
+    // seeking back to where playback is
+    if (!is_seeking && parse_get_status(parse_context) == PARSE_STATUS_END_OF_FILE &&
+        ctx->settings->on_file_end != SAV1_FILE_END_LOOP) {
+        return sav1_seek_playback(context, timecode, SAV1_SEEK_MODE_PRECISE);
+    }
+    return 0;
+}
+
+int
+sav1_get_video_track_count(Sav1Context *context, size_t *count)
+{
+    CHECK_CONTEXT_VALID(context)
+    Sav1InternalContext *ctx = (Sav1InternalContext *)context->internal_state;
+    CHECK_CTX_VALID(ctx)
+    CHECK_CTX_INITIALIZED(ctx, context)
+    CHECK_CTX_CRITICAL_ERROR(ctx)
+
+    *count = parse_get_num_video_tracks(ctx->thread_manager->parse_context);
+    return 0;
+}
+
+int
+sav1_get_video_track(Sav1Context *context, size_t index, Sav1VideoTrack *track)
+{
+    CHECK_CONTEXT_VALID(context)
+    Sav1InternalContext *ctx = (Sav1InternalContext *)context->internal_state;
+    CHECK_CTX_VALID(ctx)
+    CHECK_CTX_INITIALIZED(ctx, context)
+    CHECK_CTX_CRITICAL_ERROR(ctx)
+
+    if (parse_get_video_track(ctx->thread_manager->parse_context, index,
+                              &(track->width), &(track->height), &(track->name))) {
+        RAISE(ctx, "Video track index out of range in sav1_get_video_track()")
+    }
+    return 0;
+}
+
+int
+sav1_get_selected_video_track(Sav1Context *context, size_t *index)
+{
+    CHECK_CONTEXT_VALID(context)
+    Sav1InternalContext *ctx = (Sav1InternalContext *)context->internal_state;
+    CHECK_CTX_VALID(ctx)
+    CHECK_CTX_INITIALIZED(ctx, context)
+    CHECK_CTX_CRITICAL_ERROR(ctx)
+
+    *index = parse_get_selected_video_track(ctx->thread_manager->parse_context);
+    return 0;
+}
+
+int
+sav1_select_video_track(Sav1Context *context, size_t index)
+{
+    CHECK_CONTEXT_VALID(context)
+    Sav1InternalContext *ctx = (Sav1InternalContext *)context->internal_state;
+    CHECK_CTX_VALID(ctx)
+    CHECK_CTX_INITIALIZED(ctx, context)
+    CHECK_CTX_CRITICAL_ERROR(ctx)
+
+    // the other contexts playing a shared source would switch tracks too
+    if (ctx->shared_source != NULL) {
+        RAISE(ctx, "sav1_select_video_track() called on a context with a shared source")
+    }
+
+    ParseContext *parse_context = ctx->thread_manager->parse_context;
+    if (parse_select_video_track(parse_context, index)) {
+        RAISE(ctx, "Video track index out of range in sav1_select_video_track()")
+    }
+
+    // once the whole file has been parsed there are no keyframes left to switch at, so
+    // seek back to the frame that's showing
+    thread_mutex_lock(ctx->seek_lock);
+    int is_seeking = ctx->do_seek != 0;
+    uint64_t timecode = 0;
+    if (ctx->curr_video_frame != NULL) {
+        timecode = ctx->curr_video_frame->timecode;
+    }
+    thread_mutex_unlock(ctx->seek_lock);
+    if (!is_seeking && parse_get_status(parse_context) == PARSE_STATUS_END_OF_FILE &&
+        ctx->settings->on_file_end != SAV1_FILE_END_LOOP &&
+        index != parse_get_active_video_track(parse_context)) {
+        return sav1_seek_playback(context, timecode, SAV1_SEEK_MODE_PRECISE);
+    }
     return 0;
 }
 
@@ -0,0 +1,1003 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <utility>
+#include <vector>
+#include <webm/callback.h>
+#include <webm/status.h>
+#include <webm/webm_parser.h>
+
+#include "parse_index.h"
+#include "parse_reader.h"
+
+extern "C" {
+#include "av1_obu.h"
+#include "sav1_clip.h"
+#include "sav1_settings.h"
+}
+
+using namespace webm;
+
+#define CLIP_DONE_STATUS 9
+
+// the track numbers used in the clip
+#define CLIP_VIDEO_TRACK_NUMBER 1
+#define CLIP_AUDIO_TRACK_NUMBER 2
+
+// sizes that are filled in once the clip is written take up the full 8 bytes
+#define CLIP_PATCHED_SIZE_LENGTH 8
+
+// every Opus packet is a keyframe, so audio only clips start a new cluster once the
+// current one is this many milliseconds long
+#define CLIP_AUDIO_CLUSTER_DURATION 5000
+
+// move to a position that may be past what a long can hold
+static int
+clip_seek(FILE *file, std::uint64_t position)
+{
+#ifdef _WIN32
+    return _fseeki64(file, (__int64)position, SEEK_SET);
+#else
+    return fseeko(file, (off_t)position, SEEK_SET);
+#endif
+}
+
+/*
+EBML writing helpers. elements are built up in memory and then written in one go,
+apart from the segment size, the duration, and the position of the Cues, which are
+patched in at the end
+*/
+
+static void
+clip_put_id(std::vector<std::uint8_t> &buffer, Id id)
+{
+    // IDs keep their length marker, so just drop the leading zero bytes
+    std::uint32_t value = (std::uint32_t)id;
+    int shift = 24;
+    while (shift > 0 && (value >> shift) == 0) {
+        shift -= 8;
+    }
+    for (; shift >= 0; shift -= 8) {
+        buffer.push_back((std::uint8_t)(value >> shift));
+    }
+}
+
+static void
+clip_put_size(std::vector<std::uint8_t> &buffer, std::uint64_t size, int length)
+{
+    // the length marker goes in the first byte, followed by the size in big endian
+    int shift = 8 * (length - 1);
+    buffer.push_back((std::uint8_t)((0x80 >> (length - 1)) | (size >> shift)));
+    for (int i = length - 2; i >= 0; i--) {
+        buffer.push_back((std::uint8_t)(size >> (8 * i)));
+    }
+}
+
+static void
+clip_put_element_size(std::vector<std::uint8_t> &buffer, std::uint64_t size)
+{
+    // use the shortest encoding, avoiding the all ones value that means unknown
+    int length = 1;
+    while (length < 8 && size >= (1ULL << (7 * length)) - 1) {
+        length++;
+    }
+    clip_put_size(buffer, size, length);
+}
+
+static void
+clip_put_uint(std::vector<std::uint8_t> &buffer, Id id, std::uint64_t value)
+{
+    int length = 1;
+    while (length < 8 && (value >> (8 * length)) != 0) {
+        length++;
+    }
+    clip_put_id(buffer, id);
+    clip_put_element_size(buffer, length);
+    for (int i = length - 1; i >= 0; i--) {
+        buffer.push_back((std::uint8_t)(value >> (8 * i)));
+    }
+}
+
+static void
+clip_put_fixed_uint(std::vector<std::uint8_t> &buffer, Id id, std::uint64_t value)
+{
+    clip_put_id(buffer, id);
+    clip_put_element_size(buffer, 8);
+    for (int i = 7; i >= 0; i--) {
+        buffer.push_back((std::uint8_t)(value >> (8 * i)));
+    }
+}
+
+static void
+clip_put_float(std::vector<std::uint8_t> &buffer, Id id, double value)
+{
+    std::uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    clip_put_fixed_uint(buffer, id, bits);
+}
+
+static void
+clip_put_binary(std::vector<std::uint8_t> &buffer, Id id, const std::uint8_t *data,
+                std::size_t size)
+{
+    clip_put_id(buffer, id);
+    clip_put_element_size(buffer, size);
+    buffer.insert(buffer.end(), data, data + size);
+}
+
+static void
+clip_put_string(std::vector<std::uint8_t> &buffer, Id id, const std::string &value)
+{
+    clip_put_binary(buffer, id, (const std::uint8_t *)value.data(), value.size());
+}
+
+static void
+clip_put_master(std::vector<std::uint8_t> &buffer, Id id,
+                const std::vector<std::uint8_t> &body)
+{
+    clip_put_binary(buffer, id, body.data(), body.size());
+}
+
+static void
+clip_put_colour(std::vector<std::uint8_t> &buffer, const Colour &colour)
+{
+    std::vector<std::uint8_t> body;
+    if (colour.matrix_coefficients.is_present()) {
+        clip_put_uint(body, Id::kMatrixCoefficients,
+                      (std::uint64_t)colour.matrix_coefficients.value());
+    }
+    if (colour.bits_per_channel.is_present()) {
+        clip_put_uint(body, Id::kBitsPerChannel, colour.bits_per_channel.value());
+    }
+    if (colour.chroma_subsampling_x.is_present()) {
+        clip_put_uint(body, Id::kChromaSubsamplingHorz,
+                      colour.chroma_subsampling_x.value());
+    }
+    if (colour.chroma_subsampling_y.is_present()) {
+        clip_put_uint(body, Id::kChromaSubsamplingVert,
+                      colour.chroma_subsampling_y.value());
+    }
+    if (colour.chroma_siting_x.is_present()) {
+        clip_put_uint(body, Id::kChromaSitingHorz, colour.chroma_siting_x.value());
+    }
+    if (colour.chroma_siting_y.is_present()) {
+        clip_put_uint(body, Id::kChromaSitingVert, colour.chroma_siting_y.value());
+    }
+    if (colour.range.is_present()) {
+        clip_put_uint(body, Id::kRange, (std::uint64_t)colour.range.value());
+    }
+    if (colour.transfer_characteristics.is_present()) {
+        clip_put_uint(body, Id::kTransferCharacteristics,
+                      (std::uint64_t)colour.transfer_characteristics.value());
+    }
+    if (colour.primaries.is_present()) {
+        clip_put_uint(body, Id::kPrimaries, (std::uint64_t)colour.primaries.value());
+    }
+    if (colour.max_cll.is_present()) {
+        clip_put_uint(body, Id::kMaxCll, colour.max_cll.value());
+    }
+    if (colour.max_fall.is_present()) {
+        clip_put_uint(body, Id::kMaxFall, colour.max_fall.value());
+    }
+    if (colour.mastering_metadata.is_present()) {
+        const MasteringMetadata &mastering = colour.mastering_metadata.value();
+        const struct {
+            Id id;
+            const Element<double> *element;
+        } fields[] = {
+            {Id::kPrimaryRChromaticityX, &mastering.primary_r_chromaticity_x},
+            {Id::kPrimaryRChromaticityY, &mastering.primary_r_chromaticity_y},
+            {Id::kPrimaryGChromaticityX, &mastering.primary_g_chromaticity_x},
+            {Id::kPrimaryGChromaticityY, &mastering.primary_g_chromaticity_y},
+            {Id::kPrimaryBChromaticityX, &mastering.primary_b_chromaticity_x},
+            {Id::kPrimaryBChromaticityY, &mastering.primary_b_chromaticity_y},
+            {Id::kWhitePointChromaticityX, &mastering.white_point_chromaticity_x},
+            {Id::kWhitePointChromaticityY, &mastering.white_point_chromaticity_y},
+            {Id::kLuminanceMax, &mastering.luminance_max},
+            {Id::kLuminanceMin, &mastering.luminance_min}};
+        std::vector<std::uint8_t> mastering_body;
+        for (const auto &field : fields) {
+            if (field.element->is_present()) {
+                clip_put_float(mastering_body, field.id, field.element->value());
+            }
+        }
+        clip_put_master(body, Id::kMasteringMetadata, mastering_body);
+    }
+    clip_put_master(buffer, Id::kColour, body);
+}
+
+static void
+clip_put_track_entry(std::vector<std::uint8_t> &buffer, const TrackEntry &track_entry,
+                     std::uint64_t track_number)
+{
+    std::vector<std::uint8_t> body;
+    clip_put_uint(body, Id::kTrackNumber, track_number);
+    clip_put_uint(body, Id::kTrackUid, track_entry.track_uid.is_present()
+                                           ? track_entry.track_uid.value()
+                                           : track_number);
+    clip_put_uint(body, Id::kTrackType,
+                  (std::uint64_t)(track_entry.video.is_present() ? TrackType::kVideo
+                                                                 : TrackType::kAudio));
+    clip_put_uint(body, Id::kFlagLacing, 0);
+    if (track_entry.default_duration.is_present()) {
+        clip_put_uint(body, Id::kDefaultDuration, track_entry.default_duration.value());
+    }
+    if (track_entry.name.is_present()) {
+        clip_put_string(body, Id::kName, track_entry.name.value());
+    }
+    if (track_entry.language.is_present()) {
+        clip_put_string(body, Id::kLanguage, track_entry.language.value());
+    }
+    clip_put_string(body, Id::kCodecId, track_entry.codec_id.value());
+    if (track_entry.codec_private.is_present()) {
+        const std::vector<std::uint8_t> &config = track_entry.codec_private.value();
+        clip_put_binary(body, Id::kCodecPrivate, config.data(), config.size());
+    }
+    if (track_entry.codec_delay.is_present()) {
+        clip_put_uint(body, Id::kCodecDelay, track_entry.codec_delay.value());
+    }
+    if (track_entry.seek_pre_roll.is_present()) {
+        clip_put_uint(body, Id::kSeekPreRoll, track_entry.seek_pre_roll.value());
+    }
+
+    if (track_entry.video.is_present()) {
+        const Video &video = track_entry.video.value();
+        std::vector<std::uint8_t> video_body;
+        clip_put_uint(video_body, Id::kPixelWidth, video.pixel_width.value());
+        clip_put_uint(video_body, Id::kPixelHeight, video.pixel_height.value());
+        if (video.display_width.is_present()) {
+            clip_put_uint(video_body, Id::kDisplayWidth, video.display_width.value());
+        }
+        if (video.display_height.is_present()) {
+            clip_put_uint(video_body, Id::kDisplayHeight, video.display_height.value());
+        }
+        if (video.colour.is_present()) {
+            clip_put_colour(video_body, video.colour.value());
+        }
+        clip_put_master(body, Id::kVideo, video_body);
+    }
+    if (track_entry.audio.is_present()) {
+        const Audio &audio = track_entry.audio.value();
+        std::vector<std::uint8_t> audio_body;
+        clip_put_float(audio_body, Id::kSamplingFrequency,
+                       audio.sampling_frequency.value());
+        if (audio.output_frequency.is_present()) {
+            clip_put_float(audio_body, Id::kOutputSamplingFrequency,
+                           audio.output_frequency.value());
+        }
+        clip_put_uint(audio_body, Id::kChannels, audio.channels.value());
+        if (audio.bit_depth.is_present()) {
+            clip_put_uint(audio_body, Id::kBitDepth, audio.bit_depth.value());
+        }
+        clip_put_master(body, Id::kAudio, audio_body);
+    }
+    clip_put_master(buffer, Id::kTrackEntry, body);
+}
+
+// writes the clip as a WebM file, starting a new cluster at every video keyframe
+class Sav1ClipWriter {
+   public:
+    Sav1ClipWriter()
+        : file(NULL),
+          is_ok(true),
+          position(0),
+          segment_size_position(0),
+          segment_data_start(0),
+          duration_position(0),
+          cues_seek_position(0),
+          cue_track_number(0),
+          audio_cluster_duration(0),
+          cluster_timecode(0),
+          cluster_starts_with_key_frame(false),
+          end_timecode(0)
+    {
+    }
+
+    ~Sav1ClipWriter()
+    {
+        if (this->file != NULL) {
+            std::fclose(this->file);
+        }
+    }
+
+    Sav1ClipWriter(const Sav1ClipWriter &) = delete;
+    Sav1ClipWriter &
+    operator=(const Sav1ClipWriter &) = delete;
+
+    // create the file and write everything that comes before the clusters
+    bool
+    open(const char *file_path, std::uint64_t timecode_scale,
+         const TrackEntry *video_track, const TrackEntry *audio_track)
+    {
+        this->file = std::fopen(file_path, "wb");
+        if (this->file == NULL) {
+            return false;
+        }
+        this->cue_track_number =
+            video_track != nullptr ? CLIP_VIDEO_TRACK_NUMBER : CLIP_AUDIO_TRACK_NUMBER;
+        this->audio_cluster_duration =
+            (std::uint64_t)CLIP_AUDIO_CLUSTER_DURATION * 1000000 /
+            std::max(timecode_scale, (std::uint64_t)1);
+
+        std::vector<std::uint8_t> ebml_body;
+        clip_put_uint(ebml_body, Id::kEbmlVersion, 1);
+        clip_put_uint(ebml_body, Id::kEbmlReadVersion, 1);
+        clip_put_uint(ebml_body, Id::kEbmlMaxIdLength, 4);
+        clip_put_uint(ebml_body, Id::kEbmlMaxSizeLength, 8);
+        clip_put_string(ebml_body, Id::kDocType, "webm");
+        clip_put_uint(ebml_body, Id::kDocTypeVersion, 4);
+        clip_put_uint(ebml_body, Id::kDocTypeReadVersion, 2);
+        std::vector<std::uint8_t> buffer;
+        clip_put_master(buffer, Id::kEbml, ebml_body);
+
+        // the segment's size is patched in by finish()
+        clip_put_id(buffer, Id::kSegment);
+        this->segment_size_position = buffer.size();
+        clip_put_size(buffer, 0, CLIP_PATCHED_SIZE_LENGTH);
+        this->segment_data_start = buffer.size();
+
+        // build the Info and Tracks first so the SeekHead can point at them
+        std::vector<std::uint8_t> info_body;
+        clip_put_uint(info_body, Id::kTimecodeScale, timecode_scale);
+        std::size_t duration_offset = info_body.size();
+        clip_put_float(info_body, Id::kDuration, 0);
+        clip_put_string(info_body, Id::kMuxingApp, "SAV1");
+        clip_put_string(info_body, Id::kWritingApp, "SAV1");
+        std::vector<std::uint8_t> info;
+        clip_put_master(info, Id::kInfo, info_body);
+        duration_offset += info.size() - info_body.size();
+
+        std::vector<std::uint8_t> tracks_body;
+        if (video_track != nullptr) {
+            clip_put_track_entry(tracks_body, *video_track, CLIP_VIDEO_TRACK_NUMBER);
+        }
+        if (audio_track != nullptr) {
+            clip_put_track_entry(tracks_body, *audio_track, CLIP_AUDIO_TRACK_NUMBER);
+        }
+        std::vector<std::uint8_t> tracks;
+        clip_put_master(tracks, Id::kTracks, tracks_body);
+
+        // every Seek has a fixed size, so the SeekHead's size doesn't depend on the
+        // positions in it
+        std::vector<std::uint8_t> seek_head;
+        for (int pass = 0; pass < 2; pass++) {
+            std::uint64_t info_position = seek_head.size();
+            std::vector<std::uint8_t> seek_head_body;
+            this->put_seek(seek_head_body, Id::kInfo, info_position);
+            this->put_seek(seek_head_body, Id::kTracks, info_position + info.size());
+            this->put_seek(seek_head_body, Id::kCues, 0);
+            seek_head.clear();
+            clip_put_master(seek_head, Id::kSeekHead, seek_head_body);
+        }
+
+        // the values of the patched elements are their last 8 bytes, and the Cues come
+        // last in the SeekHead
+        this->cues_seek_position = buffer.size() + seek_head.size() - 8;
+        buffer.insert(buffer.end(), seek_head.begin(), seek_head.end());
+        this->duration_position = buffer.size() + duration_offset + 3;
+        buffer.insert(buffer.end(), info.begin(), info.end());
+        buffer.insert(buffer.end(), tracks.begin(), tracks.end());
+        this->write(buffer);
+        return this->is_ok;
+    }
+
+    // add a frame to the clip, where timecode is relative to the start of the clip
+    void
+    add_frame(std::uint64_t track_number, std::uint64_t timecode, bool is_key_frame,
+              const std::uint8_t *data, std::size_t size)
+    {
+        // start a new cluster for each video keyframe, or every few seconds of audio
+        // when there's no video, and whenever the timecode is too far from the
+        // cluster's to fit in a block
+        std::int64_t relative_time =
+            (std::int64_t)timecode - (std::int64_t)this->cluster_timecode;
+        bool starts_cluster =
+            is_key_frame && track_number == this->cue_track_number &&
+            (track_number == CLIP_VIDEO_TRACK_NUMBER ||
+             relative_time >= (std::int64_t)this->audio_cluster_duration);
+        if (this->cluster.empty() || starts_cluster || relative_time > INT16_MAX ||
+            relative_time < INT16_MIN) {
+            this->flush_cluster();
+            this->cluster_timecode = timecode;
+            this->cluster_starts_with_key_frame = starts_cluster;
+            clip_put_uint(this->cluster, Id::kTimecode, timecode);
+            relative_time = 0;
+        }
+
+        clip_put_id(this->cluster, Id::kSimpleBlock);
+        clip_put_element_size(this->cluster, size + 4);
+        clip_put_size(this->cluster, track_number, 1);
+        this->cluster.push_back((std::uint8_t)((std::uint16_t)relative_time >> 8));
+        this->cluster.push_back((std::uint8_t)relative_time);
+        this->cluster.push_back(is_key_frame ? 0x80 : 0x00);
+        this->cluster.insert(this->cluster.end(), data, data + size);
+        this->end_timecode = std::max(this->end_timecode, timecode);
+    }
+
+    // write the Cues and fill in the sizes and positions left blank by open()
+    bool
+    finish(std::uint64_t last_frame_duration)
+    {
+        this->flush_cluster();
+
+        std::vector<std::uint8_t> cues_body;
+        for (const Sav1CuePoint &cue : this->cue_points) {
+            std::vector<std::uint8_t> positions;
+            clip_put_uint(positions, Id::kCueTrack, this->cue_track_number);
+            clip_put_uint(positions, Id::kCueClusterPosition, cue.cluster_location);
+            std::vector<std::uint8_t> cue_point;
+            clip_put_uint(cue_point, Id::kCueTime, cue.timecode);
+            clip_put_master(cue_point, Id::kCueTrackPositions, positions);
+            clip_put_master(cues_body, Id::kCuePoint, cue_point);
+        }
+        std::uint64_t cues_position = this->position - this->segment_data_start;
+        std::vector<std::uint8_t> cues;
+        clip_put_master(cues, Id::kCues, cues_body);
+        this->write(cues);
+
+        // patch in the segment size, the duration, and where the Cues ended up
+        std::vector<std::uint8_t> patch;
+        clip_put_size(patch, this->position - this->segment_data_start,
+                      CLIP_PATCHED_SIZE_LENGTH);
+        this->patch(this->segment_size_position, patch);
+        double duration = (double)(this->end_timecode + last_frame_duration);
+        std::uint64_t duration_bits;
+        std::memcpy(&duration_bits, &duration, sizeof(duration_bits));
+        this->patch(this->duration_position, this->get_big_endian(duration_bits));
+        this->patch(this->cues_seek_position, this->get_big_endian(cues_position));
+
+        this->is_ok = std::fclose(this->file) == 0 && this->is_ok;
+        this->file = NULL;
+        return this->is_ok;
+    }
+
+   private:
+    void
+    put_seek(std::vector<std::uint8_t> &buffer, Id id, std::uint64_t seek_position)
+    {
+        std::vector<std::uint8_t> body;
+        std::vector<std::uint8_t> id_bytes;
+        clip_put_id(id_bytes, id);
+        clip_put_binary(body, Id::kSeekId, id_bytes.data(), id_bytes.size());
+        clip_put_fixed_uint(body, Id::kSeekPosition, seek_position);
+        clip_put_master(buffer, Id::kSeek, body);
+    }
+
+    void
+    flush_cluster()
+    {
+        if (this->cluster.empty()) {
+            return;
+        }
+        if (this->cluster_starts_with_key_frame || this->cue_points.empty()) {
+            Sav1CuePoint cue;
+            cue.timecode = this->cluster_timecode;
+            cue.cluster_location = this->position - this->segment_data_start;
+            this->cue_points.push_back(cue);
+        }
+        std::vector<std::uint8_t> header;
+        clip_put_id(header, Id::kCluster);
+        clip_put_element_size(header, this->cluster.size());
+        this->write(header);
+        this->write(this->cluster);
+        this->cluster.clear();
+    }
+
+    std::vector<std::uint8_t>
+    get_big_endian(std::uint64_t value) const
+    {
+        std::vector<std::uint8_t> bytes;
+        for (int i = 7; i >= 0; i--) {
+            bytes.push_back((std::uint8_t)(value >> (8 * i)));
+        }
+        return bytes;
+    }
+
+    void
+    write(const std::vector<std::uint8_t> &buffer)
+    {
+        if (this->is_ok &&
+            std::fwrite(buffer.data(), 1, buffer.size(), this->file) != buffer.size()) {
+            this->is_ok = false;
+        }
+        this->position += buffer.size();
+    }
+
+    void
+    patch(std::uint64_t patch_position, const std::vector<std::uint8_t> &bytes)
+    {
+        if (!this->is_ok || clip_seek(this->file, patch_position) ||
+            std::fwrite(bytes.data(), 1, bytes.size(), this->file) != bytes.size() ||
+            std::fseek(this->file, 0, SEEK_END)) {
+            this->is_ok = false;
+        }
+    }
+
+    FILE *file;
+    bool is_ok;
+    std::uint64_t position;
+    std::uint64_t segment_size_position;
+    std::uint64_t segment_data_start;
+    std::uint64_t duration_position;
+    std::uint64_t cues_seek_position;
+    std::uint64_t cue_track_number;
+    std::uint64_t audio_cluster_duration;
+    std::vector<std::uint8_t> cluster;
+    std::uint64_t cluster_timecode;
+    bool cluster_starts_with_key_frame;
+    std::uint64_t end_timecode;
+    std::vector<Sav1CuePoint> cue_points;  // with locations relative to the segment
+};
+
+// reads everything before the first cluster, and the Cues wherever they are
+class Sav1ClipHeaderCallback : public Callback {
+   public:
+    Sav1ClipHeaderCallback()
+        : segment_data_start(0),
+          cues_position(0),
+          found_cues_position(false),
+          found_cues(false),
+          first_cluster_location(0),
+          timecode_scale(1000000),
+          has_video(false),
+          has_audio(false)
+    {
+    }
+
+    bool
+    should_seek_to_cues() const
+    {
+        return this->found_cues_position && !this->found_cues;
+    }
+
+    std::uint64_t
+    get_cues_location() const
+    {
+        return this->segment_data_start + this->cues_position;
+    }
+
+    Status
+    OnSegmentBegin(const ElementMetadata &metadata, Action *action) override
+    {
+        this->segment_data_start = metadata.position + metadata.header_size;
+        *action = Action::kRead;
+        return Status(Status::kOkCompleted);
+    }
+
+    Status
+    OnSeek(const ElementMetadata &, const Seek &seek) override
+    {
+        if (seek.id.is_present() && seek.id.value() == Id::kCues &&
+            seek.position.is_present()) {
+            this->cues_position = seek.position.value();
+            this->found_cues_position = true;
+        }
+        return Status(Status::kOkCompleted);
+    }
+
+    Status
+    OnInfo(const ElementMetadata &, const Info &info) override
+    {
+        if (info.timecode_scale.is_present()) {
+            this->timecode_scale = info.timecode_scale.value();
+        }
+        return Status(Status::kOkCompleted);
+    }
+
+    Status
+    OnTrackEntry(const ElementMetadata &, const TrackEntry &track_entry) override
+    {
+        // only the first AV1 and Opus tracks make it into the clip
+        if (!track_entry.codec_id.is_present() ||
+            !track_entry.track_number.is_present()) {
+            return Status(Status::kOkCompleted);
+        }
+        if (track_entry.codec_id.value() == "V_AV1" && !this->has_video &&
+            track_entry.video.is_present()) {
+            this->video_track = track_entry;
+            this->has_video = true;
+        }
+        else if (track_entry.codec_id.value() == "A_OPUS" && !this->has_audio &&
+                 track_entry.audio.is_present()) {
+            this->audio_track = track_entry;
+            this->has_audio = true;
+        }
+        return Status(Status::kOkCompleted);
+    }
+
+    Status
+    OnCuePoint(const ElementMetadata &, const CuePoint &cue_point) override
+    {
+        this->found_cues = true;
+        if (!cue_point.time.is_present()) {
+            return Status(Status::kOkCompleted);
+        }
+        for (const Element<CueTrackPositions> &positions :
+             cue_point.cue_track_positions) {
+            if (positions.value().cluster_position.is_present()) {
+                RawCue raw_cue;
+                raw_cue.time = cue_point.time.value();
+                raw_cue.track = positions.value().track.value();
+                raw_cue.cluster_position = positions.value().cluster_position.value();
+                this->cues.push_back(raw_cue);
+            }
+        }
+        return Status(Status::kOkCompleted);
+    }
+
+    Status
+    OnClusterBegin(const ElementMetadata &metadata, const Cluster &,
+                   Action *action) override
+    {
+        if (this->first_cluster_location == 0) {
+            this->first_cluster_location = metadata.position;
+        }
+        *action = Action::kSkip;
+        return Status(CLIP_DONE_STATUS);
+    }
+
+    // find the cluster to start reading from to reach the keyframe at or before
+    // start_time, going by the cues of the clip's first track
+    std::uint64_t
+    find_cluster(std::uint64_t start_time) const
+    {
+        const TrackEntry &track = this->has_video ? this->video_track : this->audio_track;
+        std::uint64_t cue_track = track.track_number.value();
+        std::uint64_t best_time = 0;
+        std::uint64_t cluster_location = this->first_cluster_location;
+        for (const RawCue &raw_cue : this->cues) {
+            std::uint64_t time = (raw_cue.time * this->timecode_scale) / 1000000;
+            if (raw_cue.track == cue_track && time <= start_time && time >= best_time) {
+                best_time = time;
+                cluster_location = this->segment_data_start + raw_cue.cluster_position;
+            }
+        }
+        return cluster_location;
+    }
+
+    std::uint64_t segment_data_start;
+    std::uint64_t cues_position;
+    bool found_cues_position;
+    bool found_cues;
+    std::uint64_t first_cluster_location;
+    std::uint64_t timecode_scale;
+    bool has_video;
+    bool has_audio;
+    TrackEntry video_track;
+    TrackEntry audio_track;
+
+   private:
+    typedef struct RawCue {
+        std::uint64_t time;
+        std::uint64_t track;
+        std::uint64_t cluster_position;
+    } RawCue;
+
+    std::vector<RawCue> cues;
+};
+
+// copies the blocks between the keyframe at or before the start time and the end time
+class Sav1ClipCallback : public Callback {
+   public:
+    Sav1ClipCallback(Sav1ClipWriter *writer, const Sav1ClipHeaderCallback &header,
+                     std::uint64_t start_time, std::uint64_t end_time)
+        : writer(writer),
+          timecode_scale(header.timecode_scale),
+          video_track_number(header.has_video ? header.video_track.track_number.value()
+                                              : 0),
+          audio_track_number(header.has_audio ? header.audio_track.track_number.value()
+                                              : 0),
+          has_video(header.has_video),
+          start_time(start_time),
+          end_time(end_time),
+          cluster_timecode(0),
+          block_track_number(0),
+          block_timecode(0),
+          block_is_key_frame(false),
+          is_in_block_group(false),
+          found_start(false),
+          is_started(false),
+          start_timecode(0)
+    {
+    }
+
+    // whether any frames made it into the clip
+    bool
+    has_frames() const
+    {
+        return this->is_started || !this->pending.empty();
+    }
+
+    // the timecode in the input of the first frame of the clip
+    std::uint64_t
+    get_start_timecode() const
+    {
+        return this->start_timecode;
+    }
+
+    // write out the frames held back in case a later keyframe was a better start
+    void
+    flush_pending()
+    {
+        for (const ClipFrame &frame : this->pending) {
+            this->write_frame(frame.track_number, frame.timecode, frame.is_key_frame,
+                              frame.data.data(), frame.data.size());
+        }
+        this->pending.clear();
+        if (this->found_start) {
+            this->is_started = true;
+        }
+    }
+
+    Status
+    OnClusterBegin(const ElementMetadata &, const Cluster &cluster,
+                   Action *action) override
+    {
+        this->cluster_timecode = cluster.timecode.value();
+        if (this->get_milliseconds(this->cluster_timecode) >= this->end_time) {
+            *action = Action::kSkip;
+            return Status(CLIP_DONE_STATUS);
+        }
+        *action = Action::kRead;
+        return Status(Status::kOkCompleted);
+    }
+
+    Status
+    OnSimpleBlockBegin(const ElementMetadata &, const SimpleBlock &simple_block,
+                       Action *action) override
+    {
+        this->is_in_block_group = false;
+        this->begin_block(simple_block.track_number, simple_block.timecode,
+                          simple_block.is_key_frame, action);
+        return Status(Status::kOkCompleted);
+    }
+
+    Status
+    OnBlockBegin(const ElementMetadata &, const Block &block, Action *action) override
+    {
+        // a Block's keyframe status comes from its frame header
+        this->is_in_block_group = true;
+        this->begin_block(block.track_number, block.timecode, false, action);
+        return Status(Status::kOkCompleted);
+    }
+
+    Status
+    OnFrame(const FrameMetadata &, Reader *reader,
+            std::uint64_t *bytes_remaining) override
+    {
+        this->frame_data.resize((std::size_t)*bytes_remaining);
+        std::uint8_t *data = this->frame_data.data();
+        while (*bytes_remaining > 0) {
+            std::uint64_t num_read;
+            Status status = reader->Read((std::size_t)*bytes_remaining, data, &num_read);
+            data += num_read;
+            *bytes_remaining -= num_read;
+            if (status.code != Status::kOkPartial && !status.completed_ok()) {
+                return status;
+            }
+        }
+
+        bool is_key_frame = this->block_is_key_frame;
+        if (this->block_track_number == this->audio_track_number) {
+            is_key_frame = true;
+        }
+        else if (this->is_in_block_group) {
+            is_key_frame = av1_obu_is_key_frame(this->frame_data.data(),
+                                                this->frame_data.size()) == 1;
+        }
+        this->add_frame(is_key_frame);
+        return Status(Status::kOkCompleted);
+    }
+
+   private:
+    typedef struct ClipFrame {
+        std::uint64_t track_number;
+        std::uint64_t timecode;
+        bool is_key_frame;
+        std::vector<std::uint8_t> data;
+    } ClipFrame;
+
+    std::uint64_t
+    get_milliseconds(std::uint64_t timecode) const
+    {
+        return (timecode * this->timecode_scale) / 1000000;
+    }
+
+    void
+    begin_block(std::uint64_t track_number, std::int16_t relative_time, bool is_key_frame,
+                Action *action)
+    {
+        std::int64_t timecode = (std::int64_t)this->cluster_timecode + relative_time;
+        if ((track_number != this->video_track_number &&
+             track_number != this->audio_track_number) ||
+            timecode < 0 || this->get_milliseconds(timecode) >= this->end_time) {
+            *action = Action::kSkip;
+            return;
+        }
+        this->block_track_number = track_number;
+        this->block_timecode = (std::uint64_t)timecode;
+        this->block_is_key_frame = is_key_frame;
+        *action = Action::kRead;
+    }
+
+    void
+    add_frame(bool is_key_frame)
+    {
+        std::uint64_t track_number = this->block_track_number;
+        std::uint64_t timecode = this->block_timecode;
+        if (this->is_started) {
+            this->write_frame(track_number, timecode, is_key_frame,
+                              this->frame_data.data(), this->frame_data.size());
+            return;
+        }
+
+        // the clip starts at the last keyframe at or before the start time, or at the
+        // first one after it if there's none before
+        bool can_start = is_key_frame && (track_number == this->video_track_number ||
+                                          !this->has_video);
+        bool is_before_start = this->get_milliseconds(timecode) <= this->start_time;
+        if (can_start && (is_before_start || !this->found_start)) {
+            this->pending.clear();
+            this->found_start = true;
+            this->start_timecode = timecode;
+        }
+        if (!this->found_start || timecode < this->start_timecode) {
+            return;
+        }
+
+        ClipFrame frame;
+        frame.track_number = track_number;
+        frame.timecode = timecode;
+        frame.is_key_frame = is_key_frame;
+        frame.data.swap(this->frame_data);
+        this->pending.push_back(std::move(frame));
+
+        // once past the start time no later keyframe can replace this one
+        if (!is_before_start) {
+            this->flush_pending();
+        }
+    }
+
+    void
+    write_frame(std::uint64_t track_number, std::uint64_t timecode, bool is_key_frame,
+                const std::uint8_t *data, std::size_t size)
+    {
+        // interleaved audio can come from just before the first keyframe
+        if (timecode < this->start_timecode) {
+            return;
+        }
+        std::uint64_t clip_track_number = track_number == this->video_track_number
+                                              ? CLIP_VIDEO_TRACK_NUMBER
+                                              : CLIP_AUDIO_TRACK_NUMBER;
+        this->writer->add_frame(clip_track_number, timecode - this->start_timecode,
+                                is_key_frame, data, size);
+    }
+
+    Sav1ClipWriter *writer;
+    std::uint64_t timecode_scale;
+    std::uint64_t video_track_number;
+    std::uint64_t audio_track_number;
+    bool has_video;
+    std::uint64_t start_time;
+    std::uint64_t end_time;
+    std::uint64_t cluster_timecode;
+    std::uint64_t block_track_number;
+    std::uint64_t block_timecode;
+    bool block_is_key_frame;
+    bool is_in_block_group;
+    std::vector<std::uint8_t> frame_data;
+    bool found_start;
+    bool is_started;
+    std::uint64_t start_timecode;
+    std::vector<ClipFrame> pending;
+};
+
+// find the cluster holding the keyframe at or before start_time in the cached seek
+// index, returning false if there's no usable cache
+static bool
+sav1_clip_find_cached_cluster(const char *input_path, const char *index_cache_path,
+                              std::uint64_t video_track_number, std::uint64_t start_time,
+                              std::uint64_t *cluster_location)
+{
+    // only an index built with AV1 targeted records video keyframes
+    Sav1FileStamp stamp;
+    Sav1ParseIndex index;
+    if (index_cache_path == NULL) {
+        return false;
+    }
+    bool is_loaded = false;
+    const int codec_targets[] = {SAV1_CODEC_AV1 | SAV1_CODEC_OPUS, SAV1_CODEC_AV1};
+    for (int codec_target : codec_targets) {
+        if (parse_index_get_file_stamp(input_path, codec_target, &stamp) &&
+            parse_index_load(index_cache_path, stamp, &index)) {
+            is_loaded = true;
+            break;
+        }
+    }
+    if (!is_loaded || index.av1_track_number != video_track_number ||
+        index.key_frames.empty() ||
+        index.key_frames.front().timecode > start_time) {
+        return false;
+    }
+    auto key_frame = std::upper_bound(
+        index.key_frames.begin(), index.key_frames.end(), start_time,
+        [](std::uint64_t timecode, const Sav1KeyFrame &key_frame) {
+            return timecode < key_frame.timecode;
+        });
+    *cluster_location = (key_frame - 1)->cluster_location;
+    return true;
+}
+
+int
+sav1_extract_clip(const char *input_path, const char *output_path, uint64_t start_time,
+                  uint64_t end_time, const char *index_cache_path,
+                  uint64_t *clip_start_time)
+{
+    if (input_path == NULL || output_path == NULL || start_time >= end_time) {
+        return -1;
+    }
+    Sav1Reader *reader =
+        parse_reader_open_file(input_path, SAV1_FILE_READ_MAPPED, 0, false);
+    if (reader == nullptr) {
+        return -1;
+    }
+
+    // read the tracks, and the Cues if they're listed in the SeekHead but come after
+    // the clusters
+    Sav1ClipHeaderCallback header;
+    WebmParser parser;
+    parser.Feed(&header, reader);
+    if (header.should_seek_to_cues() &&
+        reader->Seek(header.get_cues_location()).completed_ok()) {
+        parser.DidSeek();
+        parser.Feed(&header, reader);
+    }
+    if ((!header.has_video && !header.has_audio) || header.first_cluster_location == 0) {
+        delete reader;
+        return -1;
+    }
+
+    // jump straight to the cluster with the first keyframe of the clip
+    std::uint64_t cluster_location;
+    if (!header.has_video ||
+        !sav1_clip_find_cached_cluster(input_path, index_cache_path,
+                                       header.video_track.track_number.value(),
+                                       start_time, &cluster_location)) {
+        cluster_location = header.find_cluster(start_time);
+    }
+
+    Sav1ClipWriter writer;
+    if (!writer.open(output_path, header.timecode_scale,
+                     header.has_video ? &header.video_track : nullptr,
+                     header.has_audio ? &header.audio_track : nullptr) ||
+        !reader->Seek(cluster_location).completed_ok()) {
+        delete reader;
+        return -1;
+    }
+    parser.DidSeek();
+    Sav1ClipCallback callback(&writer, header, start_time, end_time);
+    Status status = parser.Feed(&callback, reader);
+    callback.flush_pending();
+    delete reader;
+
+    // the last video frame lasts for the track's default duration
+    std::uint64_t last_frame_duration = 0;
+    if (header.has_video && header.video_track.default_duration.is_present()) {
+        last_frame_duration =
+            header.video_track.default_duration.value() / header.timecode_scale;
+    }
+    bool is_ok = writer.finish(last_frame_duration);
+    if (!is_ok || !callback.has_frames() ||
+        (status.code != CLIP_DONE_STATUS && status.code != Status::kEndOfFile &&
+         !status.completed_ok())) {
+        std::remove(output_path);
+        return -1;
+    }
+
+    if (clip_start_time != NULL) {
+        *clip_start_time =
+            (callback.get_start_timecode() * header.timecode_scale) / 1000000;
+    }
+    return 0;
+}
@@ -0,0 +1,38 @@
+#include "sav1_decode_budget.h"
+#include "decode_budget.h"
+#include "decode_av1.h"
+
+int
+sav1_create_decode_budget(Sav1DecodeBudget *budget, int num_threads)
+{
+    if (budget == NULL || num_threads < 0) {
+        return -1;
+    }
+    if (num_threads == 0) {
+        num_threads = decode_av1_get_num_cores();
+    }
+
+    DecodeBudget *decode_budget;
+    if (decode_budget_init(&decode_budget, num_threads)) {
+        return -1;
+    }
+    budget->internal_state = (void *)decode_budget;
+    budget->is_initialized = 1;
+
+    return 0;
+}
+
+int
+sav1_destroy_decode_budget(Sav1DecodeBudget *budget)
+{
+    if (budget == NULL || budget->is_initialized != 1) {
+        return -1;
+    }
+
+    // the attached contexts each hold on to the budget until they're destroyed
+    decode_budget_release((DecodeBudget *)budget->internal_state);
+    budget->internal_state = NULL;
+    budget->is_initialized = 0;
+
+    return 0;
+}
@@ -4,17 +4,35 @@
 #include <stddef.h>
 
 #include "sav1.h"
+#include "chapter_cache.h"
 #include "thread_manager.h"
+#include "shared_source.h"
 
 #define SAV1_ERROR_MESSAGE_SIZE 128
 
+#define SAV1_NO_CHAPTER ((size_t)-1)
+
+// how many frames to watch before deciding whether to switch to a smaller video track
+#define SAV1_AUTO_TRACK_WINDOW 32
+
+// how many milliseconds late timed playback can show a frame before the decoder starts
+// leaving out frames that no others depend on, and how late before it gives up on
+// everything up to the next keyframe. it has to stay that late, with nothing decoded
+// ahead, for a run of frames first, so a single late poll doesn't count
+#define SAV1_CATCH_UP_LATENESS 100
+#define SAV1_CATCH_UP_KEY_FRAME_LATENESS 1000
+#define SAV1_CATCH_UP_LATE_FRAMES 8
+
 typedef struct Sav1InternalContext {
     Sav1Settings *settings;
     Sav1Context *context;
     ThreadManager *thread_manager;
+    Sav1ThreadQueue *video_output_queue;
+    Sav1ThreadQueue *audio_output_queue;
     char error_message[SAV1_ERROR_MESSAGE_SIZE];
     uint8_t critical_error_flag;
     uint8_t is_playing;
+    uint8_t is_visible;  // only used to weigh the context in its decode budget
     struct timespec *start_time;
     struct timespec *pause_time;
     Sav1VideoFrame *curr_video_frame;
@@ -28,6 +46,20 @@ typedef struct Sav1InternalContext {
     uint8_t do_seek;
     thread_mutex_t *seek_lock;
     thread_atomic_int_t seek_mode;
+    ChapterCache *chapter_cache;
+    size_t capture_chapter;         // the chapter whose entry frame is still to be cached
+    int64_t chapter_prev_timecode;  // the last frame shown, or -1 at the start
+    int audio_track_switches;       // audio from before the last switch is dropped
+    size_t auto_track_frames;       // frames shown since the decoder was last checked
+    size_t auto_track_starved_frames;  // of those, how many had nothing decoded behind
+    SharedSource *shared_source;       // where frames come from when not decoded here
+    int shared_seek_generation;        // the last seek of the shared source followed
+    uint8_t shared_join;  // whether the clock still has to catch up to the source
+    int shared_stalled;   // codecs whose frames aren't being taken, under the source lock
+    int64_t shared_timecode;  // the last frame shown or -1, under the source lock
+    uint64_t catch_up_timecode;  // frames before this were decoded before the last jump
+    uint64_t catch_up_lateness;   // how late the last frame shown was
+    size_t catch_up_late_frames;  // frames in a row that were late and not catching up
 } Sav1InternalContext;
 
 void
@@ -39,4 +71,8 @@ sav1_set_error_with_code(Sav1InternalContext *ctx, const char *message, int code
 void
 sav1_set_critical_error_flag(Sav1InternalContext *ctx);
 
+// destroy every frame waiting in the queues of a context playing a shared source
+void
+drain_shared_output_queues(Sav1InternalContext *ctx);
+
 #endif
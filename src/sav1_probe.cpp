@@ -0,0 +1,310 @@
+#include <algorithm>
+#include <cstring>
+#include <vector>
+#include <webm/callback.h>
+#include <webm/status.h>
+#include <webm/webm_parser.h>
+
+#include "parse_reader.h"
+
+extern "C" {
+#include "sav1_probe.h"
+}
+
+using namespace webm;
+
+// how many video frames from the first cluster to estimate the frame rate from
+#define PROBE_NUM_FRAME_RATE_SAMPLES 16
+
+#define PROBE_DONE_STATUS 8
+
+// reads just the parts of the file that describe it
+class Sav1ProbeCallback : public Callback {
+   public:
+    explicit Sav1ProbeCallback(Sav1ProbeInfo *info)
+        : info(info),
+          found_segment(false),
+          segment_data_start(0),
+          cues_position(0),
+          found_cues_position(false),
+          found_cues(false),
+          timecode_scale(1000000),
+          av1_track_number(0),
+          cluster_timecode(0),
+          is_sampling_cluster(false),
+          has_sampled_cluster(false)
+    {
+    }
+
+    bool
+    is_webm() const
+    {
+        return this->found_segment;
+    }
+
+    bool
+    should_seek_to_cues() const
+    {
+        return this->found_cues_position && !this->found_cues;
+    }
+
+    std::uint64_t
+    get_cues_location() const
+    {
+        return this->segment_data_start + this->cues_position;
+    }
+
+    // work out the frame rate from the first frames if the file didn't list it
+    void
+    estimate_frame_rate()
+    {
+        if (this->info->frame_rate != 0 || this->frame_timecodes.size() < 2) {
+            return;
+        }
+        std::sort(this->frame_timecodes.begin(), this->frame_timecodes.end());
+        std::int64_t span = this->frame_timecodes.back() - this->frame_timecodes.front();
+        if (span > 0) {
+            this->info->frame_rate = (this->frame_timecodes.size() - 1) * 1000000000.0 /
+                                     ((double)span * this->timecode_scale);
+        }
+    }
+
+    Status
+    OnSegmentBegin(const ElementMetadata &metadata, Action *action) override
+    {
+        this->found_segment = true;
+        this->segment_data_start = metadata.position + metadata.header_size;
+        *action = Action::kRead;
+        return Status(Status::kOkCompleted);
+    }
+
+    Status
+    OnSeek(const ElementMetadata &, const Seek &seek) override
+    {
+        if (seek.id.is_present() && seek.id.value() == Id::kCues &&
+            seek.position.is_present()) {
+            this->cues_position = seek.position.value();
+            this->found_cues_position = true;
+        }
+        return Status(Status::kOkCompleted);
+    }
+
+    Status
+    OnInfo(const ElementMetadata &, const Info &info) override
+    {
+        if (info.timecode_scale.is_present()) {
+            this->timecode_scale = info.timecode_scale.value();
+        }
+        if (info.duration.is_present()) {
+            this->info->duration = (std::uint64_t)(
+                (info.duration.value() * this->timecode_scale) / 1000000.0);
+        }
+        return Status(Status::kOkCompleted);
+    }
+
+    Status
+    OnTrackEntry(const ElementMetadata &, const TrackEntry &track_entry) override
+    {
+        if (!track_entry.codec_id.is_present() ||
+            !track_entry.track_number.is_present()) {
+            return Status(Status::kOkCompleted);
+        }
+        if (track_entry.codec_id.value() == "V_AV1" && !this->info->has_video) {
+            this->info->has_video = 1;
+            this->av1_track_number = track_entry.track_number.value();
+            this->read_video(track_entry);
+        }
+        else if (track_entry.codec_id.value() == "A_OPUS" && !this->info->has_audio) {
+            this->info->has_audio = 1;
+            const Audio &audio = track_entry.audio.value();
+            this->info->audio_channels = (size_t)audio.channels.value();
+            this->info->audio_sample_rate = audio.sampling_frequency.value();
+        }
+        return Status(Status::kOkCompleted);
+    }
+
+    Status
+    OnCuePoint(const ElementMetadata &, const CuePoint &cue_point) override
+    {
+        // video cue points mark keyframes
+        this->found_cues = true;
+        for (const Element<CueTrackPositions> &positions :
+             cue_point.cue_track_positions) {
+            if (positions.value().track.value() == this->av1_track_number) {
+                this->info->num_key_frames++;
+                break;
+            }
+        }
+        return Status(Status::kOkCompleted);
+    }
+
+    Status
+    OnClusterBegin(const ElementMetadata &, const Cluster &cluster,
+                   Action *action) override
+    {
+        // only look inside the first cluster, and only to estimate the frame rate
+        if (this->has_sampled_cluster || !this->info->has_video ||
+            this->info->frame_rate != 0) {
+            *action = Action::kSkip;
+            return Status(PROBE_DONE_STATUS);
+        }
+        this->has_sampled_cluster = true;
+        this->is_sampling_cluster = true;
+        this->cluster_timecode = cluster.timecode.value();
+        *action = Action::kRead;
+        return Status(Status::kOkCompleted);
+    }
+
+    Status
+    OnClusterEnd(const ElementMetadata &, const Cluster &) override
+    {
+        this->is_sampling_cluster = false;
+        return Status(PROBE_DONE_STATUS);
+    }
+
+    Status
+    OnSimpleBlockBegin(const ElementMetadata &, const SimpleBlock &simple_block,
+                       Action *action) override
+    {
+        *action = Action::kSkip;
+        return this->sample_block(simple_block.track_number, simple_block.timecode);
+    }
+
+    Status
+    OnBlockBegin(const ElementMetadata &, const Block &block, Action *action) override
+    {
+        *action = Action::kSkip;
+        return this->sample_block(block.track_number, block.timecode);
+    }
+
+   private:
+    void
+    read_video(const TrackEntry &track_entry)
+    {
+        const Video &video = track_entry.video.value();
+        this->info->width = (size_t)video.pixel_width.value();
+        this->info->height = (size_t)video.pixel_height.value();
+        if (track_entry.default_duration.is_present() &&
+            track_entry.default_duration.value() > 0) {
+            this->info->frame_rate = 1000000000.0 / track_entry.default_duration.value();
+        }
+        else if (video.frame_rate.is_present()) {
+            this->info->frame_rate = video.frame_rate.value();
+        }
+
+        // the AV1CodecConfigurationRecord has the color setup right at the start
+        const std::vector<std::uint8_t> &config = track_entry.codec_private.value();
+        if (config.size() >= 4 && config[0] == 0x81) {
+            bool high_bitdepth = (config[2] >> 6) & 1;
+            bool twelve_bit = (config[2] >> 5) & 1;
+            this->info->bit_depth = high_bitdepth ? (twelve_bit ? 12 : 10) : 8;
+            this->info->chroma_layout =
+                (config[2] >> 4) & 1
+                    ? SAV1_CHROMA_LAYOUT_MONOCHROME
+                    : this->get_chroma_layout((config[2] >> 3) & 1, (config[2] >> 2) & 1);
+            return;
+        }
+
+        // otherwise fall back to the Colour element
+        if (!video.colour.is_present()) {
+            return;
+        }
+        const Colour &colour = video.colour.value();
+        this->info->bit_depth = (std::uint8_t)colour.bits_per_channel.value();
+        if (colour.chroma_subsampling_x.is_present() &&
+            colour.chroma_subsampling_y.is_present()) {
+            this->info->chroma_layout =
+                this->get_chroma_layout(colour.chroma_subsampling_x.value() > 0,
+                                        colour.chroma_subsampling_y.value() > 0);
+        }
+    }
+
+    Sav1ChromaLayout
+    get_chroma_layout(bool subsampling_x, bool subsampling_y) const
+    {
+        if (subsampling_x) {
+            return subsampling_y ? SAV1_CHROMA_LAYOUT_420 : SAV1_CHROMA_LAYOUT_422;
+        }
+        return subsampling_y ? SAV1_CHROMA_LAYOUT_UNKNOWN : SAV1_CHROMA_LAYOUT_444;
+    }
+
+    Status
+    sample_block(std::uint64_t track_number, std::int16_t timecode)
+    {
+        if (!this->is_sampling_cluster || track_number != this->av1_track_number) {
+            return Status(Status::kOkCompleted);
+        }
+        this->frame_timecodes.push_back((std::int64_t)this->cluster_timecode + timecode);
+        if (this->frame_timecodes.size() >= PROBE_NUM_FRAME_RATE_SAMPLES) {
+            return Status(PROBE_DONE_STATUS);
+        }
+        return Status(Status::kOkCompleted);
+    }
+
+    Sav1ProbeInfo *info;
+    bool found_segment;
+    std::uint64_t segment_data_start;
+    std::uint64_t cues_position;
+    bool found_cues_position;
+    bool found_cues;
+    std::uint64_t timecode_scale;
+    std::uint64_t av1_track_number;
+    std::uint64_t cluster_timecode;
+    bool is_sampling_cluster;
+    bool has_sampled_cluster;
+    std::vector<std::int64_t> frame_timecodes;
+};
+
+static int
+sav1_probe_reader(Sav1Reader *reader, Sav1ProbeInfo *info)
+{
+    std::memset(info, 0, sizeof(Sav1ProbeInfo));
+    if (reader == nullptr) {
+        return -1;
+    }
+
+    // read the headers and the start of the first cluster, then jump to the Cues if
+    // they're listed in the SeekHead but come after the clusters
+    Sav1ProbeCallback callback(info);
+    WebmParser parser;
+    parser.Feed(&callback, reader);
+    if (callback.should_seek_to_cues() &&
+        reader->Seek(callback.get_cues_location()).completed_ok()) {
+        parser.DidSeek();
+        parser.Feed(&callback, reader);
+    }
+    callback.estimate_frame_rate();
+    delete reader;
+
+    return callback.is_webm() ? 0 : -1;
+}
+
+int
+sav1_probe_file(const char *file_path, Sav1ProbeInfo *info)
+{
+    if (file_path == NULL || info == NULL) {
+        return -1;
+    }
+    return sav1_probe_reader(
+        parse_reader_open_file(file_path, SAV1_FILE_READ_MAPPED, 0, false), info);
+}
+
+int
+sav1_probe_buffer(const uint8_t *buffer, size_t size, Sav1ProbeInfo *info)
+{
+    if (buffer == NULL || info == NULL) {
+        return -1;
+    }
+    return sav1_probe_reader(parse_reader_open_buffer(buffer, size), info);
+}
+
+int
+sav1_probe_io(const Sav1IO *io, Sav1ProbeInfo *info)
+{
+    if (io == NULL || io->read == NULL || info == NULL) {
+        return -1;
+    }
+
+    // the headers are small, so there's no point reading far ahead
+    return sav1_probe_reader(parse_reader_open_io(*io, 4096), info);
+}
@@ -21,6 +21,54 @@ sav1_default_settings(Sav1Settings *settings, char *file_path)
     settings->playback_mode = SAV1_PLAYBACK_TIMED;
     settings->playback_speed = 1.0;
     settings->on_file_end = SAV1_FILE_END_WAIT;
+    settings->index_cache_path = NULL;
+    settings->use_background_indexing = 0;
+    settings->file_buffer = NULL;
+    settings->file_buffer_size = 0;
+    settings->io.read = NULL;
+    settings->io.seek = NULL;
+    settings->io.tell = NULL;
+    settings->io.get_size = NULL;
+    settings->io.cookie = NULL;
+    settings->read_ahead_size = 65536;
+    settings->file_read_mode = SAV1_FILE_READ_MAPPED;
+    settings->prefetch_chunk_size = 2 * 1024 * 1024;
+    settings->chapter_frame_cache_size = 0;
+    settings->video_track_mode = SAV1_VIDEO_TRACK_MANUAL;
+    settings->shared_source = NULL;
+    settings->decode_preset = SAV1_DECODE_PRESET_AUTO;
+    settings->decode_threads = 0;
+    settings->decode_frame_delay = 0;
+    settings->decode_profile.apply_grain = 1;
+    settings->decode_profile.frame_type = SAV1_DECODE_FRAMES_ALL;
+    settings->decode_profile.frame_size_limit = 0;
+    settings->decode_profile.strict_std_compliance = 0;
+    settings->decode_budget = NULL;
+}
+
+void
+sav1_settings_use_file_buffer(Sav1Settings *settings, const uint8_t *buffer, size_t size)
+{
+    settings->file_buffer = buffer;
+    settings->file_buffer_size = size;
+}
+
+void
+sav1_settings_use_io(Sav1Settings *settings, const Sav1IO *io)
+{
+    settings->io = *io;
+}
+
+void
+sav1_settings_use_shared_source(Sav1Settings *settings, Sav1SharedSource *source)
+{
+    settings->shared_source = source;
+}
+
+void
+sav1_settings_use_decode_budget(Sav1Settings *settings, Sav1DecodeBudget *budget)
+{
+    settings->decode_budget = budget;
 }
 
 void
@@ -0,0 +1,37 @@
+#include "sav1_shared_source.h"
+#include "shared_source.h"
+
+int
+sav1_create_shared_source(Sav1SharedSource *source, Sav1Settings *settings)
+{
+    if (source == NULL || settings == NULL) {
+        return -1;
+    }
+    if (settings->shared_source != NULL) {
+        return -1;  // a shared source can't play another shared source
+    }
+
+    SharedSource *shared_source;
+    if (shared_source_init(&shared_source, settings)) {
+        return -1;
+    }
+    source->internal_state = (void *)shared_source;
+    source->is_initialized = 1;
+
+    return 0;
+}
+
+int
+sav1_destroy_shared_source(Sav1SharedSource *source)
+{
+    if (source == NULL || source->is_initialized != 1) {
+        return -1;
+    }
+
+    // the attached contexts each hold on to the source until they're destroyed
+    shared_source_release((SharedSource *)source->internal_state);
+    source->internal_state = NULL;
+    source->is_initialized = 0;
+
+    return 0;
+}
@@ -21,6 +21,13 @@ sav1_video_frame_destroy(Sav1Context *context, Sav1VideoFrame *frame)
         return -1;
     }
 
+    // a frame from a shared source only gives up its reference to the data
+    if (frame->shared_frame != NULL) {
+        shared_frame_release((SharedFrame *)frame->shared_frame);
+        free(frame);
+        return 0;
+    }
+
     // free the custom video frame data if applicable
     if (ctx->settings->use_custom_processing & SAV1_USE_CUSTOM_PROCESSING_VIDEO &&
         ctx->settings->custom_video_frame_destroy != NULL && frame->custom_data != NULL) {
@@ -107,6 +114,9 @@ sav1_video_frame_clone(Sav1Context *context, Sav1VideoFrame *src_frame,
     // copy over the pixel data
     memcpy(frame->data, src_frame->data, src_frame->size);
 
+    // the clone owns its data even when the source frame is shared
+    frame->shared_frame = NULL;
+
     *dst_frame = frame;
 
     return 0;
@@ -0,0 +1,473 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "shared_source.h"
+#include "sav1_internal.h"
+
+void
+shared_frame_release(SharedFrame *shared)
+{
+    // thread_atomic_int_dec returns the previous value
+    if (thread_atomic_int_dec(&(shared->num_refs)) != 1) {
+        return;
+    }
+
+    if (shared->codec == SAV1_CODEC_AV1) {
+        sav1_video_frame_destroy(shared->host, (Sav1VideoFrame *)shared->frame);
+    }
+    else {
+        sav1_audio_frame_destroy(shared->host, (Sav1AudioFrame *)shared->frame);
+    }
+    free(shared);
+}
+
+void *
+shared_source_copy_frame(SharedFrame *shared)
+{
+    // every consumer gets its own frame struct pointing at the same data
+    void *copy;
+    if (shared->codec == SAV1_CODEC_AV1) {
+        Sav1VideoFrame *frame;
+        if ((frame = (Sav1VideoFrame *)malloc(sizeof(Sav1VideoFrame))) == NULL) {
+            return NULL;
+        }
+        memcpy(frame, shared->frame, sizeof(Sav1VideoFrame));
+        frame->sav1_has_ownership = 1;
+        frame->shared_frame = shared;
+        copy = frame;
+    }
+    else {
+        Sav1AudioFrame *frame;
+        if ((frame = (Sav1AudioFrame *)malloc(sizeof(Sav1AudioFrame))) == NULL) {
+            return NULL;
+        }
+        memcpy(frame, shared->frame, sizeof(Sav1AudioFrame));
+        frame->sav1_has_ownership = 1;
+        frame->shared_frame = shared;
+        copy = frame;
+    }
+    thread_atomic_int_inc(&(shared->num_refs));
+
+    return copy;
+}
+
+Sav1ThreadQueue *
+shared_source_get_queue(Sav1InternalContext *consumer, int codec)
+{
+    if (codec == SAV1_CODEC_AV1) {
+        return consumer->video_output_queue;
+    }
+    return consumer->audio_output_queue;
+}
+
+void
+shared_source_push_frame(Sav1InternalContext *consumer, int codec, void *copy)
+{
+    Sav1ThreadQueue *queue = shared_source_get_queue(consumer, codec);
+
+    // a consumer that has stopped taking frames loses its oldest one instead of holding
+    // up the others, but it still has to see where a seek landed
+    while (!sav1_thread_queue_try_push(queue, copy)) {
+        void *oldest = sav1_thread_queue_pop_timeout(queue);
+        if (oldest == NULL) {
+            continue;
+        }
+        if (codec == SAV1_CODEC_AV1) {
+            Sav1VideoFrame *frame = (Sav1VideoFrame *)oldest;
+            ((Sav1VideoFrame *)copy)->sentinel |= frame->sentinel;
+            sav1_video_frame_destroy(consumer->context, frame);
+        }
+        else {
+            Sav1AudioFrame *frame = (Sav1AudioFrame *)oldest;
+            ((Sav1AudioFrame *)copy)->sentinel |= frame->sentinel;
+            sav1_audio_frame_destroy(consumer->context, frame);
+        }
+    }
+}
+
+void
+shared_source_deliver(SharedSource *source, int codec, void *frame, int generation,
+                      thread_timer_t *timer)
+{
+    Sav1InternalContext *host_ctx = (Sav1InternalContext *)source->host->internal_state;
+
+    SharedFrame *shared;
+    if ((shared = (SharedFrame *)malloc(sizeof(SharedFrame))) == NULL) {
+        if (codec == SAV1_CODEC_AV1) {
+            sav1_video_frame_destroy(source->host, (Sav1VideoFrame *)frame);
+        }
+        else {
+            sav1_audio_frame_destroy(source->host, (Sav1AudioFrame *)frame);
+        }
+        sav1_set_error(host_ctx, "malloc() failed in shared_source_deliver()");
+        sav1_set_critical_error_flag(host_ctx);
+        return;
+    }
+    shared->frame = frame;
+    shared->codec = codec;
+    shared->host = source->host;
+    thread_atomic_int_store(&(shared->num_refs), 1);
+
+    // wait until every consumer has room for the frame, except for the ones that have
+    // stopped taking frames altogether, so the pipeline keeps pace with the consumers
+    uint64_t wait_time = 0;
+    while (thread_atomic_int_load(&(source->do_fan_out))) {
+        thread_mutex_lock(source->lock);
+
+        // a frame from before a seek was drained from the pipeline with the rest
+        if (generation != source->seek_generation) {
+            thread_mutex_unlock(source->lock);
+            break;
+        }
+
+        int has_room = 0;
+        int is_blocked = 0;
+        for (size_t i = 0; i < source->num_consumers; i++) {
+            Sav1InternalContext *consumer = source->consumers[i];
+            Sav1ThreadQueue *queue = shared_source_get_queue(consumer, codec);
+            if ((size_t)sav1_thread_queue_get_size(queue) < queue->capacity) {
+                consumer->shared_stalled &= ~codec;
+                has_room = 1;
+            }
+            else if (!(consumer->shared_stalled & codec)) {
+                is_blocked = 1;
+            }
+        }
+        // only the time spent waiting on full consumers while others have room counts,
+        // so consumers that all fill up together, as when paused, aren't left behind
+        if (!has_room) {
+            wait_time = 0;
+        }
+        if (has_room && is_blocked && wait_time >= SHARED_SOURCE_STALL_TIME) {
+            for (size_t i = 0; i < source->num_consumers; i++) {
+                Sav1InternalContext *consumer = source->consumers[i];
+                Sav1ThreadQueue *queue = shared_source_get_queue(consumer, codec);
+                if ((size_t)sav1_thread_queue_get_size(queue) >= queue->capacity) {
+                    consumer->shared_stalled |= codec;
+                }
+            }
+            is_blocked = 0;
+        }
+        if (has_room && !is_blocked) {
+            for (size_t i = 0; i < source->num_consumers; i++) {
+                void *copy = shared_source_copy_frame(shared);
+                if (copy == NULL) {
+                    sav1_set_error(source->consumers[i],
+                                   "malloc() failed in shared_source_deliver()");
+                    sav1_set_critical_error_flag(source->consumers[i]);
+                    continue;
+                }
+                shared_source_push_frame(source->consumers[i], codec, copy);
+            }
+            thread_mutex_unlock(source->lock);
+            break;
+        }
+        thread_mutex_unlock(source->lock);
+        thread_timer_wait(timer, SHARED_SOURCE_POLL_INTERVAL);
+        wait_time += SHARED_SOURCE_POLL_INTERVAL;
+    }
+
+    // the frame is destroyed here if no consumer took it
+    shared_frame_release(shared);
+}
+
+int
+shared_source_fan_out(SharedSource *source, int codec)
+{
+    Sav1InternalContext *host_ctx = (Sav1InternalContext *)source->host->internal_state;
+    Sav1ThreadQueue *input_queue = shared_source_get_queue(host_ctx, codec);
+
+    thread_timer_t timer;
+    thread_timer_init(&timer);
+    while (thread_atomic_int_load(&(source->do_fan_out))) {
+        // nothing the pipeline puts out belongs to a seek until the host thread has
+        // finished it
+        thread_mutex_lock(source->lock);
+        int generation = source->seek_generation;
+        int is_seeking = source->host_generation != generation;
+        thread_mutex_unlock(source->lock);
+        if (is_seeking) {
+            thread_timer_wait(&timer, SHARED_SOURCE_POLL_INTERVAL);
+            continue;
+        }
+
+        void *frame = sav1_thread_queue_pop_timeout(input_queue);
+        if (frame == NULL) {
+            thread_timer_wait(&timer, SHARED_SOURCE_POLL_INTERVAL);
+            continue;
+        }
+        shared_source_deliver(source, codec, frame, generation, &timer);
+    }
+    thread_timer_term(&timer);
+
+    return 0;
+}
+
+int
+shared_source_fan_out_video(void *context)
+{
+    return shared_source_fan_out((SharedSource *)context, SAV1_CODEC_AV1);
+}
+
+int
+shared_source_fan_out_audio(void *context)
+{
+    return shared_source_fan_out((SharedSource *)context, SAV1_CODEC_OPUS);
+}
+
+int
+shared_source_run_host(void *context)
+{
+    SharedSource *source = (SharedSource *)context;
+
+    // the pipeline's mutexes are locked by the thread that creates the context and can
+    // only be unlocked by it, so the host is created, seeked and destroyed here
+    Sav1Context *host = source->host;
+    host->is_initialized = 0;
+    if (sav1_create_context(host, source->host_settings)) {
+        if (host->is_initialized) {
+            sav1_destroy_context(host);
+        }
+        thread_atomic_int_store(&(source->host_status), -1);
+        thread_signal_raise(&(source->host_signal));
+        return -1;
+    }
+    thread_atomic_int_store(&(source->host_status), 1);
+    thread_signal_raise(&(source->host_signal));
+
+    Sav1InternalContext *host_ctx = (Sav1InternalContext *)host->internal_state;
+    while (thread_atomic_int_load(&(source->do_host))) {
+        thread_mutex_lock(source->lock);
+        if (source->host_generation == source->seek_generation) {
+            thread_mutex_unlock(source->lock);
+            thread_signal_wait(&(source->host_signal), SHARED_SOURCE_HOST_WAIT_MS);
+            continue;
+        }
+        int generation = source->seek_generation;
+        uint64_t timecode = source->seek_timecode;
+        thread_atomic_int_store(&(host_ctx->seek_mode), source->seek_mode);
+        thread_mutex_unlock(source->lock);
+
+        // the consumers keep going while the pipeline seeks, and any seek made in the
+        // meantime is picked up on the next time around
+        thread_manager_seek_to_time(host_ctx->thread_manager, timecode);
+
+        thread_mutex_lock(source->lock);
+        source->host_generation = generation;
+        thread_mutex_unlock(source->lock);
+    }
+
+    sav1_destroy_context(host);
+    return 0;
+}
+
+int
+shared_source_init(SharedSource **source, Sav1Settings *settings)
+{
+    SharedSource *shared_source;
+    if ((shared_source = (SharedSource *)malloc(sizeof(SharedSource))) == NULL) {
+        return -1;
+    }
+    if ((shared_source->lock = (thread_mutex_t *)malloc(sizeof(thread_mutex_t))) ==
+        NULL) {
+        free(shared_source);
+        return -1;
+    }
+    if ((shared_source->host = (Sav1Context *)malloc(sizeof(Sav1Context))) == NULL) {
+        free(shared_source->lock);
+        free(shared_source);
+        return -1;
+    }
+
+    thread_mutex_init(shared_source->lock);
+    thread_signal_init(&(shared_source->host_signal));
+    shared_source->consumers = NULL;
+    shared_source->num_consumers = 0;
+    shared_source->consumers_capacity = 0;
+    shared_source->seek_generation = 0;
+    shared_source->host_generation = 0;
+    shared_source->seek_timecode = 0;
+    shared_source->seek_mode = SAV1_SEEK_MODE_FAST;
+    thread_atomic_int_store(&(shared_source->num_refs), 1);
+    thread_atomic_int_store(&(shared_source->do_fan_out), 1);
+    thread_atomic_int_store(&(shared_source->do_host), 1);
+    thread_atomic_int_store(&(shared_source->host_status), 0);
+
+    // the pipeline belongs to a context of its own that is never played directly, and
+    // to a thread of its own that does everything with it
+    Sav1Settings host_settings;
+    memcpy(&host_settings, settings, sizeof(Sav1Settings));
+    host_settings.shared_source = NULL;
+    host_settings.video_track_mode = SAV1_VIDEO_TRACK_MANUAL;
+    shared_source->host_settings = &host_settings;
+    shared_source->host_thread = thread_create(shared_source_run_host, shared_source,
+                                               THREAD_STACK_SIZE_DEFAULT);
+    while (thread_atomic_int_load(&(shared_source->host_status)) == 0) {
+        thread_signal_wait(&(shared_source->host_signal), SHARED_SOURCE_HOST_WAIT_MS);
+    }
+    shared_source->host_settings = NULL;
+    if (thread_atomic_int_load(&(shared_source->host_status)) != 1) {
+        thread_join(shared_source->host_thread);
+        thread_destroy(shared_source->host_thread);
+        thread_signal_term(&(shared_source->host_signal));
+        thread_mutex_term(shared_source->lock);
+        free(shared_source->host);
+        free(shared_source->lock);
+        free(shared_source);
+        return -1;
+    }
+
+    // hand out the frames of each codec from a thread of its own
+    shared_source->video_thread = NULL;
+    shared_source->audio_thread = NULL;
+    if (settings->codec_target & SAV1_CODEC_AV1) {
+        shared_source->video_thread = thread_create(
+            shared_source_fan_out_video, shared_source, THREAD_STACK_SIZE_DEFAULT);
+    }
+    if (settings->codec_target & SAV1_CODEC_OPUS) {
+        shared_source->audio_thread = thread_create(
+            shared_source_fan_out_audio, shared_source, THREAD_STACK_SIZE_DEFAULT);
+    }
+
+    *source = shared_source;
+    return 0;
+}
+
+void
+shared_source_release(SharedSource *source)
+{
+    // thread_atomic_int_dec returns the previous value
+    if (thread_atomic_int_dec(&(source->num_refs)) != 1) {
+        return;
+    }
+
+    // stop handing out frames before the pipeline goes away
+    thread_atomic_int_store(&(source->do_fan_out), 0);
+    if (source->video_thread != NULL) {
+        thread_join(source->video_thread);
+        thread_destroy(source->video_thread);
+    }
+    if (source->audio_thread != NULL) {
+        thread_join(source->audio_thread);
+        thread_destroy(source->audio_thread);
+    }
+    thread_atomic_int_store(&(source->do_host), 0);
+    thread_signal_raise(&(source->host_signal));
+    thread_join(source->host_thread);
+    thread_destroy(source->host_thread);
+
+    free(source->host);
+    thread_signal_term(&(source->host_signal));
+    thread_mutex_term(source->lock);
+    free(source->lock);
+    free(source->consumers);
+    free(source);
+}
+
+int
+shared_source_attach(SharedSource *source, Sav1InternalContext *ctx)
+{
+    // the context holds a reference even if attaching fails, since destroying it
+    // always releases one
+    thread_atomic_int_inc(&(source->num_refs));
+
+    thread_mutex_lock(source->lock);
+    if (source->num_consumers == source->consumers_capacity) {
+        size_t capacity = source->consumers_capacity ? source->consumers_capacity * 2 : 4;
+        Sav1InternalContext **consumers = (Sav1InternalContext **)realloc(
+            source->consumers, capacity * sizeof(Sav1InternalContext *));
+        if (consumers == NULL) {
+            thread_mutex_unlock(source->lock);
+            return -1;
+        }
+        source->consumers = consumers;
+        source->consumers_capacity = capacity;
+    }
+    source->consumers[source->num_consumers++] = ctx;
+
+    // seeks from before the context attached don't apply to it
+    ctx->shared_seek_generation = source->seek_generation;
+    thread_mutex_unlock(source->lock);
+
+    return 0;
+}
+
+void
+shared_source_detach(SharedSource *source, Sav1InternalContext *ctx)
+{
+    thread_mutex_lock(source->lock);
+    for (size_t i = 0; i < source->num_consumers; i++) {
+        if (source->consumers[i] == ctx) {
+            source->consumers[i] = source->consumers[source->num_consumers - 1];
+            source->num_consumers--;
+            break;
+        }
+    }
+    thread_mutex_unlock(source->lock);
+}
+
+int
+shared_source_seek(SharedSource *source, uint64_t timecode, int seek_mode)
+{
+    // nothing already handed out follows on from the seek, and nothing that's still
+    // being handed out gets through once the generation has moved on
+    thread_mutex_lock(source->lock);
+    source->seek_generation++;
+    source->seek_timecode = timecode;
+    source->seek_mode = seek_mode;
+    int generation = source->seek_generation;
+    for (size_t i = 0; i < source->num_consumers; i++) {
+        drain_shared_output_queues(source->consumers[i]);
+    }
+    thread_mutex_unlock(source->lock);
+
+    // the pipeline itself seeks on the host thread
+    thread_signal_raise(&(source->host_signal));
+
+    return generation;
+}
+
+int
+shared_source_get_seek(SharedSource *source, uint64_t *timecode)
+{
+    thread_mutex_lock(source->lock);
+    int generation = source->seek_generation;
+    *timecode = source->seek_timecode;
+    thread_mutex_unlock(source->lock);
+
+    return generation;
+}
+
+void
+shared_source_set_timecode(SharedSource *source, Sav1InternalContext *ctx,
+                           int64_t timecode)
+{
+    thread_mutex_lock(source->lock);
+    ctx->shared_timecode = timecode;
+    thread_mutex_unlock(source->lock);
+}
+
+int
+shared_source_get_playback_time(SharedSource *source, Sav1InternalContext *ctx,
+                                uint64_t *timecode)
+{
+    // go by the furthest along of the frames the other consumers are showing
+    int status = -1;
+    thread_mutex_lock(source->lock);
+    for (size_t i = 0; i < source->num_consumers; i++) {
+        if (source->consumers[i] == ctx) {
+            continue;
+        }
+        int64_t consumer_timecode = source->consumers[i]->shared_timecode;
+        if (consumer_timecode < 0) {
+            continue;
+        }
+        if (status || (uint64_t)consumer_timecode > *timecode) {
+            *timecode = (uint64_t)consumer_timecode;
+            status = 0;
+        }
+    }
+    thread_mutex_unlock(source->lock);
+
+    return status;
+}
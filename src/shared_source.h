@@ -0,0 +1,76 @@
+#ifndef SHARED_SOURCE_H
+#define SHARED_SOURCE_H
+
+#include "sav1.h"
+#include "thread.h"
+
+// how long the fan-out threads sleep when there is nothing they can do
+#define SHARED_SOURCE_POLL_INTERVAL (2 * 1000000ULL)
+
+// how long the host thread waits for a seek before checking whether it should stop
+#define SHARED_SOURCE_HOST_WAIT_MS 100
+
+// how long a consumer can go without taking frames before it stops holding up the others
+#define SHARED_SOURCE_STALL_TIME (500 * 1000000ULL)
+
+typedef struct Sav1InternalContext Sav1InternalContext;
+
+typedef struct SharedFrame {
+    thread_atomic_int_t num_refs;
+    void *frame;  // the frame from the pipeline, destroyed with the last reference
+    int codec;
+    Sav1Context *host;
+} SharedFrame;
+
+typedef struct SharedSource {
+    Sav1Context *host;  // the context that runs the pipeline, never played directly
+    Sav1Settings *host_settings;  // only until the host thread has created the host
+    Sav1InternalContext **consumers;
+    size_t num_consumers;
+    size_t consumers_capacity;
+    thread_mutex_t *lock;  // guards the consumers and the seek state
+    int seek_generation;   // bumped every time one of the consumers seeks
+    int host_generation;   // the last seek the pipeline has finished
+    uint64_t seek_timecode;
+    int seek_mode;
+    thread_atomic_int_t num_refs;  // the user's handle plus every attached context
+    thread_atomic_int_t do_fan_out;
+    thread_atomic_int_t do_host;
+    thread_atomic_int_t host_status;  // 0 until the host is created, then 1, or -1
+    thread_signal_t host_signal;      // wakes the host thread, or init once it's ready
+    thread_ptr_t host_thread;
+    thread_ptr_t video_thread;
+    thread_ptr_t audio_thread;
+} SharedSource;
+
+int
+shared_source_init(SharedSource **source, Sav1Settings *settings);
+
+void
+shared_source_release(SharedSource *source);
+
+int
+shared_source_attach(SharedSource *source, Sav1InternalContext *ctx);
+
+void
+shared_source_detach(SharedSource *source, Sav1InternalContext *ctx);
+
+int
+shared_source_seek(SharedSource *source, uint64_t timecode, int seek_mode);
+
+int
+shared_source_get_seek(SharedSource *source, uint64_t *timecode);
+
+// record the timecode of the last frame ctx showed, or -1 if it hasn't shown one
+void
+shared_source_set_timecode(SharedSource *source, Sav1InternalContext *ctx,
+                           int64_t timecode);
+
+int
+shared_source_get_playback_time(SharedSource *source, Sav1InternalContext *ctx,
+                                uint64_t *timecode);
+
+void
+shared_frame_release(SharedFrame *shared);
+
+#endif
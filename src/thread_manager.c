@@ -102,6 +102,7 @@ thread_manager_init(ThreadManager **manager, Sav1InternalContext *ctx)
     // populate the thread manager struct
     thread_manager->ctx = ctx;
     thread_manager->parse_thread = NULL;
+    thread_manager->index_thread = NULL;
     thread_manager->decode_av1_thread = NULL;
     thread_manager->convert_av1_thread = NULL;
     thread_manager->decode_opus_thread = NULL;
@@ -115,9 +116,6 @@ thread_manager_destroy(ThreadManager *manager)
     // stop the child threads if they are still running
     thread_manager_kill_pipeline(manager);
 
-    // destroy the parse context
-    parse_destroy(manager->parse_context);
-
     // destroy the thread queues
     sav1_thread_queue_destroy(manager->video_output_queue);
     sav1_thread_queue_destroy(manager->audio_output_queue);
@@ -156,16 +154,29 @@ thread_manager_destroy(ThreadManager *manager)
         }
     }
 
+    // destroy the parse context last since the decoders can still reference its input
+    parse_destroy(manager->parse_context);
+
     free(manager);
 }
 
 void
 thread_manager_start_pipeline(ThreadManager *manager)
 {
+    // decide on indexing before the parsing thread can change what's been indexed
+    int do_index = manager->ctx->settings->use_background_indexing &&
+                   parse_prepare_indexing(manager->parse_context);
+
     // create the webm parsing thread
     manager->parse_thread =
         thread_create(parse_start, manager->parse_context, THREAD_STACK_SIZE_DEFAULT);
 
+    // optionally create the background indexing thread, unless the index is complete
+    if (do_index) {
+        manager->index_thread = thread_create(
+            parse_start_indexing, manager->parse_context, THREAD_STACK_SIZE_DEFAULT);
+    }
+
     // create video-specific resources
     if (manager->ctx->settings->codec_target & SAV1_CODEC_AV1) {
         // create the av1 decoding thread
@@ -213,6 +224,13 @@ thread_manager_kill_pipeline(ThreadManager *manager)
         manager->parse_thread = NULL;
     }
 
+    if (manager->index_thread != NULL) {
+        parse_stop_indexing(manager->parse_context);
+        thread_join(manager->index_thread);
+        thread_destroy(manager->index_thread);
+        manager->index_thread = NULL;
+    }
+
     if (manager->decode_opus_thread != NULL) {
         decode_opus_stop(manager->decode_opus_context);
         thread_join(manager->decode_opus_thread);
@@ -281,12 +299,12 @@ thread_manager_seek_to_time(ThreadManager *manager, uint64_t timecode)
     // make sure the parsing waits after stopping
     thread_mutex_lock(manager->parse_context->wait_before_seek);
 
-    // let parsing escape its wait if it finished the file
-    thread_mutex_unlock(manager->parse_context->wait_after_parse);
-
     // stop parsing for now
     parse_seek_to_time(manager->parse_context, timecode);
 
+    // let parsing escape its wait if it finished the file, now that it knows to seek
+    thread_mutex_unlock(manager->parse_context->wait_after_parse);
+
     // drain video queues
     if (manager->ctx->settings->codec_target & SAV1_CODEC_AV1) {
         decode_av1_drain_output_queue(manager->decode_av1_context);
@@ -27,6 +27,7 @@ typedef struct ThreadManager {
     Sav1ThreadQueue *video_output_queue;
     Sav1ThreadQueue *audio_output_queue;
     thread_ptr_t parse_thread;
+    thread_ptr_t index_thread;
     thread_ptr_t decode_av1_thread;
     thread_ptr_t convert_av1_thread;
     thread_ptr_t custom_processing_video_thread;
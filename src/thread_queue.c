@@ -3,21 +3,23 @@
 #include "thread_queue.h"
 #include "sav1_internal.h"
 
-void
+int
 sav1_thread_queue_init(Sav1ThreadQueue **sav1_queue, Sav1InternalContext *ctx,
                        size_t capacity)
 {
     if (((*sav1_queue) = (Sav1ThreadQueue *)malloc(sizeof(Sav1ThreadQueue))) == NULL) {
         sav1_set_error(ctx, "malloc() failed in sav1_thread_queue_init()");
         sav1_set_critical_error_flag(ctx);
-        return;
+        *sav1_queue = NULL;
+        return -1;
     }
 
     if (((*sav1_queue)->data = (void **)malloc(capacity * sizeof(void *))) == NULL) {
         free(*sav1_queue);
         sav1_set_error(ctx, "malloc() failed in sav1_thread_queue_init()");
         sav1_set_critical_error_flag(ctx);
-        return;
+        *sav1_queue = NULL;
+        return -1;
     }
     (*sav1_queue)->capacity = capacity;
     if (((*sav1_queue)->queue = (thread_queue_t *)malloc(sizeof(thread_queue_t))) ==
@@ -26,7 +28,8 @@ sav1_thread_queue_init(Sav1ThreadQueue **sav1_queue, Sav1InternalContext *ctx,
         free(*sav1_queue);
         sav1_set_error(ctx, "malloc() failed in sav1_thread_queue_init()");
         sav1_set_critical_error_flag(ctx);
-        return;
+        *sav1_queue = NULL;
+        return -1;
     }
     if (((*sav1_queue)->push_lock = (thread_mutex_t *)malloc(sizeof(thread_mutex_t))) ==
         NULL) {
@@ -35,7 +38,8 @@ sav1_thread_queue_init(Sav1ThreadQueue **sav1_queue, Sav1InternalContext *ctx,
         free((*sav1_queue));
         sav1_set_error(ctx, "malloc() failed in sav1_thread_queue_init()");
         sav1_set_critical_error_flag(ctx);
-        return;
+        *sav1_queue = NULL;
+        return -1;
     }
     if (((*sav1_queue)->pop_lock = (thread_mutex_t *)malloc(sizeof(thread_mutex_t))) ==
         NULL) {
@@ -45,12 +49,15 @@ sav1_thread_queue_init(Sav1ThreadQueue **sav1_queue, Sav1InternalContext *ctx,
         free((*sav1_queue));
         sav1_set_error(ctx, "malloc() failed in sav1_thread_queue_init()");
         sav1_set_critical_error_flag(ctx);
-        return;
+        *sav1_queue = NULL;
+        return -1;
     }
     (*sav1_queue)->ctx = ctx;
     thread_queue_init((*sav1_queue)->queue, capacity, (*sav1_queue)->data, 0);
     thread_mutex_init((*sav1_queue)->push_lock);
     thread_mutex_init((*sav1_queue)->pop_lock);
+
+    return 0;
 }
 
 void
@@ -123,10 +130,20 @@ sav1_thread_queue_pop_timeout(Sav1ThreadQueue *sav1_queue)
     return item;
 }
 
-void
+int
 sav1_thread_queue_push_timeout(Sav1ThreadQueue *sav1_queue, void *item)
 {
     thread_mutex_lock(sav1_queue->push_lock);
-    thread_queue_produce(sav1_queue->queue, item, 5);
+    int pushed = thread_queue_produce(sav1_queue->queue, item, 5);
+    thread_mutex_unlock(sav1_queue->push_lock);
+    return pushed;
+}
+
+int
+sav1_thread_queue_try_push(Sav1ThreadQueue *sav1_queue, void *item)
+{
+    thread_mutex_lock(sav1_queue->push_lock);
+    int pushed = thread_queue_produce(sav1_queue->queue, item, 0);
     thread_mutex_unlock(sav1_queue->push_lock);
+    return pushed;
 }
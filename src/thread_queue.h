@@ -16,7 +16,7 @@ typedef struct Sav1ThreadQueue {
     Sav1InternalContext *ctx;
 } Sav1ThreadQueue;
 
-void
+int
 sav1_thread_queue_init(Sav1ThreadQueue **sav1_queue, Sav1InternalContext *ctx,
                        size_t capacity);
 
@@ -41,7 +41,10 @@ sav1_thread_queue_get_size(Sav1ThreadQueue *sav1_queue);
 void *
 sav1_thread_queue_pop_timeout(Sav1ThreadQueue *sav1_queue);
 
-void
+int
 sav1_thread_queue_push_timeout(Sav1ThreadQueue *sav1_queue, void *item);
 
+int
+sav1_thread_queue_try_push(Sav1ThreadQueue *sav1_queue, void *item);
+
 #endif
@@ -1,8 +1,46 @@
 #include <assert.h>
 #include <stdlib.h>
 
+#include "thread.h"
 #include "webm_frame.h"
 
+// how many unused buffers a pool keeps around instead of freeing
+#define WEBM_FRAME_POOL_MAX_FREE_BUFFERS 4
+
+struct WebMFrameBuffer {
+    uint8_t *data;
+    size_t capacity;
+    size_t used;
+    thread_atomic_int_t num_refs;  // one for each frame using it, plus one while current
+    WebMFramePool *pool;
+    struct WebMFrameBuffer *next;  // the next unused buffer in the pool
+};
+
+struct WebMFramePool {
+    thread_mutex_t lock;
+    WebMFrame *free_frames;
+    WebMFrameBuffer *free_buffers;
+    int num_free_buffers;
+    WebMFrameBuffer *current_buffer;  // the buffer new frames are carved out of
+    size_t buffer_size;
+    int num_refs;  // one for the owner plus one for each frame handed out
+};
+
+void
+webm_frame_set_defaults(WebMFrame *frame)
+{
+    frame->timecode = 0;
+    frame->codec = 0;
+    frame->do_discard = 0;
+    frame->sentinel = 0;
+    frame->track_switches = 0;
+    frame->is_key_frame = 0;
+    frame->is_borrowed = 0;
+    frame->buffer = NULL;
+    frame->pool = NULL;
+    frame->next = NULL;
+}
+
 int
 webm_frame_init(WebMFrame **frame, size_t size)
 {
@@ -15,21 +53,233 @@ webm_frame_init(WebMFrame **frame, size_t size)
         return -1;
     }
 
+    webm_frame_set_defaults(*frame);
     (*frame)->size = size;
-    (*frame)->timecode = 0;
-    (*frame)->codec = 0;
-    (*frame)->do_discard = 0;
-    (*frame)->sentinel = 0;
-    (*frame)->is_key_frame = 0;
 
     return 0;
 }
 
+int
+webm_frame_init_borrowed(WebMFrame **frame, const uint8_t *data, size_t size)
+{
+    if ((*frame = (WebMFrame *)malloc(sizeof(WebMFrame))) == NULL) {
+        return -1;
+    }
+
+    // borrowed data is only ever read from, never written or freed
+    webm_frame_set_defaults(*frame);
+    (*frame)->data = (uint8_t *)data;
+    (*frame)->size = size;
+    (*frame)->is_borrowed = 1;
+
+    return 0;
+}
+
+void
+webm_frame_pool_free(WebMFramePool *pool)
+{
+    while (pool->free_frames != NULL) {
+        WebMFrame *frame = pool->free_frames;
+        pool->free_frames = frame->next;
+        free(frame);
+    }
+    while (pool->free_buffers != NULL) {
+        WebMFrameBuffer *buffer = pool->free_buffers;
+        pool->free_buffers = buffer->next;
+        free(buffer->data);
+        free(buffer);
+    }
+    thread_mutex_term(&(pool->lock));
+    free(pool);
+}
+
+void
+webm_frame_pool_unref_locked(WebMFramePool *pool)
+{
+    // the lock is released here so that the pool can be freed afterwards
+    int num_refs = --(pool->num_refs);
+    thread_mutex_unlock(&(pool->lock));
+    if (num_refs == 0) {
+        webm_frame_pool_free(pool);
+    }
+}
+
+void
+webm_frame_buffer_release(WebMFrameBuffer *buffer)
+{
+    if (thread_atomic_int_dec(&(buffer->num_refs)) != 1) {
+        return;
+    }
+
+    // keep regular sized buffers for reuse, but don't hold on to too many
+    WebMFramePool *pool = buffer->pool;
+    thread_mutex_lock(&(pool->lock));
+    if (buffer->capacity == pool->buffer_size &&
+        pool->num_free_buffers < WEBM_FRAME_POOL_MAX_FREE_BUFFERS) {
+        buffer->next = pool->free_buffers;
+        pool->free_buffers = buffer;
+        pool->num_free_buffers++;
+        thread_mutex_unlock(&(pool->lock));
+        return;
+    }
+    thread_mutex_unlock(&(pool->lock));
+    free(buffer->data);
+    free(buffer);
+}
+
 void
 webm_frame_destroy(WebMFrame *frame)
 {
     assert(frame != NULL);
     assert(frame->data != NULL);
-    free(frame->data);
+    if (frame->buffer != NULL) {
+        webm_frame_buffer_release(frame->buffer);
+    }
+    else if (!frame->is_borrowed) {
+        free(frame->data);
+    }
+
+    // hand pooled frames back for reuse
+    if (frame->pool != NULL) {
+        WebMFramePool *pool = frame->pool;
+        thread_mutex_lock(&(pool->lock));
+        frame->next = pool->free_frames;
+        pool->free_frames = frame;
+        webm_frame_pool_unref_locked(pool);
+        return;
+    }
     free(frame);
 }
+
+int
+webm_frame_pool_init(WebMFramePool **pool, size_t buffer_size)
+{
+    if ((*pool = (WebMFramePool *)malloc(sizeof(WebMFramePool))) == NULL) {
+        return -1;
+    }
+
+    thread_mutex_init(&((*pool)->lock));
+    (*pool)->free_frames = NULL;
+    (*pool)->free_buffers = NULL;
+    (*pool)->num_free_buffers = 0;
+    (*pool)->current_buffer = NULL;
+    (*pool)->buffer_size = buffer_size;
+    (*pool)->num_refs = 1;
+
+    return 0;
+}
+
+void
+webm_frame_pool_destroy(WebMFramePool *pool)
+{
+    if (pool->current_buffer != NULL) {
+        webm_frame_buffer_release(pool->current_buffer);
+        pool->current_buffer = NULL;
+    }
+    thread_mutex_lock(&(pool->lock));
+    webm_frame_pool_unref_locked(pool);
+}
+
+WebMFrameBuffer *
+webm_frame_pool_get_buffer(WebMFramePool *pool, size_t size)
+{
+    WebMFrameBuffer *buffer = NULL;
+    if (size <= pool->buffer_size) {
+        thread_mutex_lock(&(pool->lock));
+        if (pool->free_buffers != NULL) {
+            buffer = pool->free_buffers;
+            pool->free_buffers = buffer->next;
+            pool->num_free_buffers--;
+        }
+        thread_mutex_unlock(&(pool->lock));
+    }
+
+    // frames bigger than the usual buffer get one to themselves
+    if (buffer == NULL) {
+        size_t capacity = size > pool->buffer_size ? size : pool->buffer_size;
+        if ((buffer = (WebMFrameBuffer *)malloc(sizeof(WebMFrameBuffer))) == NULL) {
+            return NULL;
+        }
+        if ((buffer->data = (uint8_t *)malloc(capacity)) == NULL) {
+            free(buffer);
+            return NULL;
+        }
+        buffer->capacity = capacity;
+        buffer->pool = pool;
+    }
+
+    buffer->used = 0;
+    buffer->next = NULL;
+    thread_atomic_int_store(&(buffer->num_refs), 1);
+    return buffer;
+}
+
+int
+webm_frame_pool_get_frame(WebMFramePool *pool, WebMFrame **frame)
+{
+    thread_mutex_lock(&(pool->lock));
+    *frame = pool->free_frames;
+    if (*frame != NULL) {
+        pool->free_frames = (*frame)->next;
+        pool->num_refs++;
+    }
+    thread_mutex_unlock(&(pool->lock));
+
+    // only allocate when there are no frames to reuse
+    if (*frame == NULL) {
+        if ((*frame = (WebMFrame *)malloc(sizeof(WebMFrame))) == NULL) {
+            return -1;
+        }
+        thread_mutex_lock(&(pool->lock));
+        pool->num_refs++;
+        thread_mutex_unlock(&(pool->lock));
+    }
+
+    webm_frame_set_defaults(*frame);
+    (*frame)->pool = pool;
+    return 0;
+}
+
+int
+webm_frame_pool_get(WebMFramePool *pool, WebMFrame **frame, size_t size)
+{
+    // move on to a new buffer once the current one is full
+    WebMFrameBuffer *buffer = pool->current_buffer;
+    if (buffer == NULL || buffer->capacity - buffer->used < size) {
+        WebMFrameBuffer *new_buffer = webm_frame_pool_get_buffer(pool, size);
+        if (new_buffer == NULL) {
+            return -1;
+        }
+        if (buffer != NULL) {
+            webm_frame_buffer_release(buffer);
+        }
+        pool->current_buffer = buffer = new_buffer;
+    }
+
+    if (webm_frame_pool_get_frame(pool, frame)) {
+        return -1;
+    }
+    (*frame)->data = buffer->data + buffer->used;
+    (*frame)->size = size;
+    (*frame)->buffer = buffer;
+    buffer->used += size;
+    thread_atomic_int_inc(&(buffer->num_refs));
+
+    return 0;
+}
+
+int
+webm_frame_pool_get_borrowed(WebMFramePool *pool, WebMFrame **frame, const uint8_t *data,
+                             size_t size)
+{
+    if (webm_frame_pool_get_frame(pool, frame)) {
+        return -1;
+    }
+
+    // borrowed data is only ever read from, never written or freed
+    (*frame)->data = (uint8_t *)data;
+    (*frame)->size = size;
+    (*frame)->is_borrowed = 1;
+
+    return 0;
+}
@@ -4,6 +4,9 @@
 #include <stdint.h>
 #include <stddef.h>
 
+typedef struct WebMFrameBuffer WebMFrameBuffer;
+typedef struct WebMFramePool WebMFramePool;
+
 typedef struct WebMFrame {
     uint8_t *data;      // the frame data bytes
     size_t size;        // the number of bytes in the frame
@@ -11,13 +14,40 @@ typedef struct WebMFrame {
     int codec;
     int do_discard;
     int sentinel;
+    int track_switches;  // how many times the audio track had changed when parsed
     int is_key_frame;
+    int is_borrowed;    // whether data points into memory that the frame doesn't own
+    WebMFrameBuffer *buffer;  // the shared buffer that data was carved out of, if any
+    WebMFramePool *pool;      // the pool the frame goes back to when destroyed, if any
+    struct WebMFrame *next;   // the next unused frame in the pool
 } WebMFrame;
 
 int
 webm_frame_init(WebMFrame **frame, size_t size);
 
+int
+webm_frame_init_borrowed(WebMFrame **frame, const uint8_t *data, size_t size);
+
 void
 webm_frame_destroy(WebMFrame *frame);
 
+// create a pool that hands out frames carved from shared buffers of buffer_size bytes,
+// reusing frames and buffers once they're destroyed
+int
+webm_frame_pool_init(WebMFramePool **pool, size_t buffer_size);
+
+// give up the owner's hold on the pool. frames from it stay valid, and the pool is only
+// freed once the last of them is destroyed
+void
+webm_frame_pool_destroy(WebMFramePool *pool);
+
+// get a frame with room for size bytes. must only be called from one thread at a time
+int
+webm_frame_pool_get(WebMFramePool *pool, WebMFrame **frame, size_t size);
+
+// get a frame pointing at memory that the frame doesn't own
+int
+webm_frame_pool_get_borrowed(WebMFramePool *pool, WebMFrame **frame, const uint8_t *data,
+                             size_t size);
+
 #endif